@@ -0,0 +1,282 @@
+/**
+ *****************************************************************************
+ *
+ * @file bulk_bench.c
+ *      Bulk Transfer Benchmark.
+ *
+ * @par Project
+ *      TMT Primary Mirror Control System (M1CS) \n
+ *      Jet Propulsion Laboratory, Pasadena, CA
+ *
+ * Copyright (c) 2015-2023, California Institute of Technology
+ *
+ *****************************************************************************/
+
+/* bulk_bench.c -- Bulk Transfer Benchmark
+ *
+ * Sends RawDataMsg-sized messages with net_send(), net_send_zc() and
+ * net_sendfile() and reports the sender's CPU time per gigabyte for each.
+ *
+ *   bulk_bench [-m copy|zc|file] [-l msglen] [-g gbytes] [-f file]
+ *              [-s server] [-h host] [-r]
+ *
+ * With neither -r nor -h, a receiver thread in the same process sinks the
+ * data over the loopback interface.  -r runs only the receiver, and -h
+ * sends to a receiver on another host.  Without -m, all three methods are
+ * run in turn.
+ *
+ *   gcc -DLINUX -I../../include -o bulk_bench bulk_bench.c \
+ *       -L../../lib -lnet -lpthread
+ */
+
+#define _GNU_SOURCE		// for RUSAGE_THREAD
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "net_appl.h"
+#include "net.h"
+#include "GlcMsg.h"
+
+#define BULK_DATA_SRV	(APP_SRV18)	// Bulk data sink
+
+typedef enum { M_COPY, M_ZC, M_FILE, M_ALL } method;
+
+static const char *mname[] = {"copy", "zc", "file"};
+
+char   server[128] = BULK_DATA_SRV;
+char   hostname[128] = "localhost";
+long   msglen = sizeof (RawDataMsg);
+double gbytes = 4.0;
+char   *fname = NULL;
+
+int  sink (int listenfd);
+void *sink_thread (void *arg);
+int  bench (method m, char *msg, int filefd);
+double secs (struct timeval *tv);
+
+
+int main (int argc, char **argv)
+{
+    method    m = M_ALL;
+    bool      recv_only = false;
+    bool      remote = false;
+    char      *msg;
+    char      tmpname[] = "/tmp/bulk_benchXXXXXX";
+    int       filefd;
+    int       listenfd;
+    pthread_t tid;
+    int       i;
+
+    for (i = 1; i < argc; i++) {
+	if (!strcmp (argv[i], "-m")) {
+	    i++;
+	    for (m = M_COPY; m < M_ALL && strcmp (argv[i], mname[m]); m++)
+		;
+	}
+	else if (!strcmp (argv[i], "-l"))
+	    msglen = atol (argv[++i]);
+
+	else if (!strcmp (argv[i], "-g"))
+	    gbytes = atof (argv[++i]);
+
+	else if (!strcmp (argv[i], "-f"))
+	    fname = argv[++i];
+
+	else if (!strcmp (argv[i], "-s"))
+	    (void) strncpy (server, argv[++i], sizeof server - 1);
+
+	else if (!strcmp (argv[i], "-h")) {
+	    (void) strncpy (hostname, argv[++i], sizeof hostname - 1);
+	    remote = true;
+	}
+	else if (!strcmp (argv[i], "-r"))
+	    recv_only = true;
+    }
+
+    if (msglen < NET_MIN_MSG_LEN || msglen > NET_MAX_MSG_LEN) {
+	(void) fprintf (stderr, "bulk_bench: message length must be %ld..%ld\n",
+				(long) NET_MIN_MSG_LEN, (long) NET_MAX_MSG_LEN);
+	exit (1);
+    }
+
+    /* start the receiver */
+
+    if (!remote) {
+	if ((listenfd = net_init (server)) < 0) {
+	    (void) fprintf (stderr, "bulk_bench: net_init() error: %s: %s\n",
+				    NET_ERRSTR (listenfd), strerror (errno));
+	    exit (listenfd);
+	}
+
+	if (recv_only)
+	    exit (sink (listenfd));
+
+	(void) pthread_create (&tid, NULL, sink_thread, &listenfd);
+    }
+
+    /* the payload, from memory and from a file */
+
+    if ((msg = malloc (msglen)) == NULL) {
+	perror ("bulk_bench: malloc");
+	exit (1);
+    }
+    for (i = 0; i < msglen; i++)
+	msg[i] = (char) i;
+
+    if (fname != NULL)
+	filefd = open (fname, O_RDONLY);
+
+    else if ((filefd = mkstemp (tmpname)) != ERROR) {
+	(void) unlink (tmpname);
+	if (write (filefd, msg, msglen) != msglen) {
+	    perror ("bulk_bench: write");
+	    exit (1);
+	}
+    }
+    if (filefd == ERROR) {
+	perror ("bulk_bench: open");
+	exit (1);
+    }
+
+    if (m != M_ALL)
+	exit (bench (m, msg, filefd));
+
+    for (m = M_COPY; m < M_ALL; m++)
+	if (bench (m, msg, filefd) != 0)
+	    exit (1);
+
+    exit (0);
+}
+
+
+/*
+ *  Send gbytes of msglen-byte messages with method m over a new connection,
+ *  and report throughput and the CPU time of the sending thread per GB.
+ */
+int bench (method m, char *msg, int filefd)
+{
+    struct timespec t0, t1;
+    struct rusage   ru0, ru1;
+    long   nmsgs, i;
+    int    ncopied = 0;
+    int    msgfd;
+    int    status = 0;
+    double wall, usr, sys, gb;
+
+    msgfd = net_connect (server, hostname, ANY_TASK, BLOCKING);
+    if (msgfd < 0) {
+	(void) fprintf (stderr, "bulk_bench: net_connect() error: %s: %s\n",
+				NET_ERRSTR (msgfd), strerror (errno));
+	return msgfd;
+    }
+
+    nmsgs = (long) (gbytes * 1e9 / msglen) + 1;
+
+    (void) clock_gettime (CLOCK_MONOTONIC, &t0);
+    (void) getrusage (RUSAGE_THREAD, &ru0);
+
+    for (i = 0; i < nmsgs && status >= 0; i++) {
+	switch (m) {
+	case M_COPY:
+	    status = net_send (msgfd, msg, msglen, BLOCKING);
+	    break;
+
+	case M_ZC:
+	    /* msg is never modified, so completions need not be awaited
+	     * before the next send; collect them to keep the queue short */
+	    status = net_send_zc (msgfd, msg, msglen, BLOCKING);
+	    if (status > 0)
+		status = net_zc_wait (msgfd, NON_BLOCKING, &ncopied);
+	    break;
+
+	default:
+	    status = net_sendfile (msgfd, filefd, 0, msglen, BLOCKING);
+	    break;
+	}
+    }
+    if (m == M_ZC && status >= 0)
+	status = net_zc_wait (msgfd, BLOCKING, &ncopied);
+
+    (void) getrusage (RUSAGE_THREAD, &ru1);
+    (void) clock_gettime (CLOCK_MONOTONIC, &t1);
+
+    (void) net_close (msgfd);
+
+    if (status < 0) {
+	(void) fprintf (stderr, "bulk_bench: %s: send error: %s: %s\n",
+				mname[m], NET_ERRSTR (status), strerror (errno));
+	return 1;
+    }
+
+    wall = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    usr  = secs (&ru1.ru_utime) - secs (&ru0.ru_utime);
+    sys  = secs (&ru1.ru_stime) - secs (&ru0.ru_stime);
+    gb   = (double) nmsgs * msglen / 1e9;
+
+    (void) printf ("%-4s  %ld x %ld bytes  %.3f s  %.2f GB/s  "
+		   "cpu %.3f s (usr %.3f sys %.3f)  %.3f cpu-s/GB\n",
+		   mname[m], nmsgs, msglen, wall, gb / wall,
+		   usr + sys, usr, sys, (usr + sys) / gb);
+
+    if (m == M_ZC && ncopied > 0)
+	(void) printf ("      %d of %ld zero-copy sends were copied by the kernel\n",
+		       ncopied, nmsgs);
+
+    return 0;
+}
+
+
+/*
+ *  Accept connections and discard their messages until each closes.
+ */
+int sink (int listenfd)
+{
+    char *buff;
+    int  msgfd;
+    int  status;
+
+    if ((buff = malloc (NET_MAX_MSG_LEN)) == NULL) {
+	perror ("bulk_bench: malloc");
+	return 1;
+    }
+
+    for (;;) {
+	if ((msgfd = net_accept (listenfd, BLOCKING)) < 0) {
+	    (void) fprintf (stderr, "bulk_bench: net_accept() error: %s\n",
+				    NET_ERRSTR (msgfd));
+	    return 1;
+	}
+
+	while ((status = net_recv (msgfd, buff, NET_MAX_MSG_LEN,
+						    BLOCKING)) > 0)
+	    ;
+
+	if (status < 0)
+	    (void) fprintf (stderr, "bulk_bench: net_recv() error: %s\n",
+				    NET_ERRSTR (status));
+	(void) net_close (msgfd);
+    }
+}
+
+
+void *sink_thread (void *arg)
+{
+    (void) sink (*(int *) arg);
+
+    return NULL;
+}
+
+
+double secs (struct timeval *tv)
+{
+    return tv->tv_sec + tv->tv_usec / 1e6;
+}
@@ -17,6 +17,8 @@
 
 /* lscs_tstsrv.c -- LSCS Test Server */
 
+#define _GNU_SOURCE		// for pthread_setaffinity_np()
+
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -24,33 +26,169 @@
 #include <unistd.h>
 #include <errno.h>
 #include <netdb.h>
+#include <stdint.h>
+#include <stddef.h>
 #include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
 
 #include "net_ts.h"
 #include "net_glc.h"
 #include "timer.h"
+#include "histo.h"
+#include "rtprof.h"
+#include "segsim.h"
 #include "GlcMsg.h"
 
 #include "GlcLscsIf.h"
 
 #define MAXCLIENTS	492		// Up to 492 client connections.
 #define MAXMSGLEN	1024
+#define MAXSHARDS	64		// Up to 64 sender threads, if -t.
+#define MAXSTEPS	32		// Up to 32 rates and 32 sizes, if -r, -size.
+#define MAXRATE		10000		// Up to 10 kHz ticks.
 
 int  listenfd = ERROR;
 int  cli_fd[MAXCLIENTS];
 int  tmfd = ERROR;
 bool debug = false;
+net_evloop *ev;				// dispatches ready descriptors
+
+int  udpfd = ERROR;			// UDP endpoint, if -u
+int  n_udp = 0;				// number of UDP subscribers
+net_udpmsg udp_cli[MAXCLIENTS];		// one datagram per UDP subscriber
+int  mcastfd = ERROR;			// multicast publisher, if -mc
+bool fanout = false;			// one io_uring fan-out per tick, if -ur
+int  hdrver = NET_HDR_AUTO;		// NET_HDR_V2 to clients, if -v2
+bool tstamp = false;			// kernel transmit timestamps, if -ts
+bool multi = false;			// three messages per tick, if -m
+bool tick_tag = false;			// one time tag per tick, if -tt
+int  q_depth = 0;			// outbound queue of each client, if -q
+int  q_policy = NET_Q_DROP_OLDEST;	// its overflow policy, -qp
+char *rt_spec = NULL;			// real-time profile, if -rt
+bool simulate = false;			// synthetic segment data, if -sim
+char rt_desc[RT_DESC_LEN];		// the profile applied
+
+/* message types the tick can send, if -type */
+
+typedef struct TickType {
+    char *name, *msg;			// -type name, and the message's
+    int  id;				// its msgId
+    int  len;				// its default length
+    bool tagged;			// starts with a time-tagged DataHdr
+} TickType;
+
+TickType tick_types[] = {
+    {"seg",    "SegRtDataMsg",      SEG_REALTIME_DATA, sizeof (SegRtDataMsg),      true},
+    {"wh",     "WarpHarnStrainMsg", WH_STRAIN_DATA,    sizeof (WarpHarnStrainMsg), true},
+    {"status", "SegmentStatusMsg",  SEG_STATUS_DATA,   sizeof (SegmentStatusMsg),  true},
+    {"cfg",    "SensConfigMsg",     SENS_CFG_DATA,     sizeof (SensConfigMsg),     true},
+    {"raw",    "RawDataMsg",        RAW_DATA,          MAXMSGLEN,                  false},
+};
+TickType *tick_type = &tick_types[0];
+
+/* the operating points, if -r or -size: with several, the server sweeps
+   sizes within rates, dwell seconds each, then exits */
+
+int  rates[MAXSTEPS] = {50}, nrates = 1;
+int  sizes[MAXSTEPS] = {0}, nsizes = 1;	// 0: the message type's length
+int  dwell = 5;
+int  step = 0, nsteps = 1;
+int  tick_rate;				// of the step, Hz
+
+/* the tick's messages, built once and shared by every send: only their
+   time tags change, before the tick's sends start */
+
+char		  *tick_buf = NULL;	// the -type message, of tick_len bytes
+int		  tick_len;
+long		  tick_bytes;		// sent to each client per tick
+SegmentStatusMsg  tick_stat;
+WarpHarnStrainMsg tick_wh;
+net_msgvec	  tick_msgv[3];
+
+/* each client's segment, if -sim: its model and its own message, filled
+   in by whichever thread sends it, from the frame number of the tick */
+
+segsim	     sim[MAXCLIENTS];
+SegRtDataMsg sim_msg[MAXCLIENTS];
+unsigned long sim_frame = 0;
+
+/* user space to kernel transmit time per client, if -ts */
+long tx_n[MAXCLIENTS], tx_sum[MAXCLIENTS], tx_min[MAXCLIENTS], tx_max[MAXCLIENTS];
 
+/* sender threads, if -t: shard k sends the tick to clients k, k+nshards...
+   while the main thread waits, so cli_fd[] only changes between ticks */
 
-void event_loop ();
+typedef struct Shard {
+    pthread_t tid;
+    int       cpu;			// core the thread is pinned to
+    long      done;			// tick start to its last send, ns
+    long      n, sum, max;		// done statistics since the last report
+} Shard;
+
+int  nshards = 0;
+Shard shard[MAXSHARDS];
+int  cli_status[MAXCLIENTS];		// send status of the last tick
+pthread_mutex_t tick_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t  tick_start = PTHREAD_COND_INITIALIZER;	// tick_no advanced
+pthread_cond_t  tick_done = PTHREAD_COND_INITIALIZER;	// tick_busy reached 0
+unsigned tick_no = 0;			// ticks started
+int  tick_busy = 0;			// shards still sending the tick
+struct timespec tick_time;		// start of the tick, CLOCK_MONOTONIC
+long last_n, last_sum, last_max;	// tick start to the last client's send
+
+struct timeval tm_tick = {0, 20*1000};	// {0s, 20ms} at 50 Hz
+
+/* the tick's schedule: lateness of its start, start to the last send done,
+   and the expirations missed, over the last 5 s and the whole run */
+
+struct timespec tick_sched;		// oldest expiration not yet read
+histo late_h, busy_h, miss_h;
+histo late_run, busy_run, miss_run;
+
+/* and over the step, with what the clients were sent */
+
+histo late_step, busy_step;
+unsigned long step_ticks, step_missed, step_msgs;
+double step_bytes;
+
+
+void on_accept (net_evloop *ev, int fd, int events, void *arg);
+void on_client (net_evloop *ev, int fd, int events, void *arg);
+void on_udp (net_evloop *ev, int fd, int events, void *arg);
+void on_timer (net_evloop *ev, int fd, int events, void *arg);
+void on_signal (int sig);
+void close_client (int indx);
+int  set_queue (int indx, int depth, char *policy);
 int  process_msg (int sockfd);
-int  process_timer (int tfd);
+int  process_udp (int ufd);
+int  process_timer ();
+long read_timer (int tfd);
+void account_tick (struct timespec *start, struct timespec *end, long exp);
+void report_ticks (bool final);
+int  parse_list (char *arg, int *v, int min, int max);
+void set_step ();
+void report_step ();
+void build_tick ();
+int  process_txstamps (int indx);
+int  send_client (int indx);
+SegRtDataMsg *sim_fill (int indx);
+void check_send (int indx, int status);
+int  start_shards (int n, char *cpus);
+void *shard_main (void *arg);
+void report_shards ();
+void start_timer ();
 
 
 int main (int argc, char **argv)
 {
-    char server[128] = LSCS_50HZ_DATA_SRV;
-    int  i;
+    char server[128] = "";
+    char *ifname = NULL;
+    bool udp = false;
+    bool mcast = false;
+    char *cpus = NULL;
+    int  i, n, min, max;
 
     for (i = 1; i < argc; i++) {
 	if (!strcmp (argv[i], "-s"))
@@ -59,131 +197,487 @@ int main (int argc, char **argv)
 	else if (!strcmp (argv[i], "-d"))
 	    debug = true;
 
+	else if (!strcmp (argv[i], "-u"))
+	    udp = true;
+
+	else if (!strcmp (argv[i], "-mc"))
+	    mcast = true;
+
+	else if (!strcmp (argv[i], "-i"))
+	    ifname = argv[++i];
+
+	else if (!strcmp (argv[i], "-ur"))
+	    fanout = true;
+
+	else if (!strcmp (argv[i], "-v2"))
+	    hdrver = NET_HDR_V2;
+
+	else if (!strcmp (argv[i], "-ts"))
+	    tstamp = true;
+
+	else if (!strcmp (argv[i], "-m"))
+	    multi = true;
+
+	else if (!strcmp (argv[i], "-tt"))
+	    tick_tag = true;
+
+	else if (!strcmp (argv[i], "-q") && i + 1 < argc)
+	    q_depth = atoi (argv[++i]);
+
+	else if (!strcmp (argv[i], "-qp") && i + 1 < argc) {
+	    if ((q_policy = set_queue (ERROR, 0, argv[++i])) < 0) {
+		(void)fprintf (stderr, "lscs_tstsrv: -qp takes oldest, newest or disconnect.\n");
+		exit (1);
+	    }
+	}
+
+	else if (!strcmp (argv[i], "-t") && i + 1 < argc)
+	    nshards = atoi (argv[++i]);
+
+	else if (!strcmp (argv[i], "-cpus") && i + 1 < argc)
+	    cpus = argv[++i];
+
+	else if (!strcmp (argv[i], "-rt") && i + 1 < argc)
+	    rt_spec = argv[++i];
+
+	else if (!strcmp (argv[i], "-r") && i + 1 < argc) {
+	    if ((nrates = parse_list (argv[++i], rates, 1, MAXRATE)) < 0) {
+		(void)fprintf (stderr, "lscs_tstsrv: -r takes up to %d rates of 1 to %d Hz.\n",
+					MAXSTEPS, MAXRATE);
+		exit (1);
+	    }
+	}
+
+	else if (!strcmp (argv[i], "-size") && i + 1 < argc) {
+	    if ((nsizes = parse_list (argv[++i], sizes, 1, NET_MAX_MSG_LEN)) < 0) {
+		(void)fprintf (stderr, "lscs_tstsrv: -size takes up to %d sizes in bytes.\n",
+					MAXSTEPS);
+		exit (1);
+	    }
+	}
+
+	else if (!strcmp (argv[i], "-type") && i + 1 < argc) {
+	    for (n = 0; n < sizeof tick_types / sizeof tick_types[0]; n++)
+		if (!strcmp (argv[i+1], tick_types[n].name) ||
+		    !strcmp (argv[i+1], tick_types[n].msg))
+		    break;
+	    if (n == sizeof tick_types / sizeof tick_types[0]) {
+		(void)fprintf (stderr, "lscs_tstsrv: -type takes seg, wh, status, cfg or raw.\n");
+		exit (1);
+	    }
+	    tick_type = &tick_types[n];
+	    i++;
+	}
+
+	else if (!strcmp (argv[i], "-dwell") && i + 1 < argc)
+	    dwell = atoi (argv[++i]);
+
+	else if (!strcmp (argv[i], "-sim"))
+	    simulate = true;
+
 	else if (!strcmp (argv[i], "-help")) {
-	    printf ("Usage: lscs_tstsrv [-d] [-s server]\n");
+	    printf ("Usage: lscs_tstsrv [-d] [-u | -mc [-i ifname] | -ur | -t nthreads [-cpus list]]\n"
+		    "                   [-v2] [-ts] [-m] [-tt] [-q depth [-qp policy]]\n"
+		    "                   [-r rate[,rate...]] [-type name] [-size bytes[,bytes...]]\n"
+		    "                   [-dwell secs] [-sim] [-rt prio[@cpus]] [-s server]\n");
 	    exit (1);
 	}
 	else {
-	    printf ("Usage: lscs_tstsrv [-d] [-s server]\n");
+	    printf ("Usage: lscs_tstsrv [-d] [-u | -mc [-i ifname] | -ur | -t nthreads [-cpus list]]\n"
+		    "                   [-v2] [-ts] [-m] [-tt] [-q depth [-qp policy]]\n"
+		    "                   [-r rate[,rate...]] [-type name] [-size bytes[,bytes...]]\n"
+		    "                   [-dwell secs] [-sim] [-rt prio[@cpus]] [-s server]\n");
+	    exit (1);
+	}
+    }
+
+    if (nshards < 0 || nshards > MAXSHARDS || (nshards > 0 && fanout)) {
+	(void)fprintf (stderr, "lscs_tstsrv: -t takes 1 to %d threads, without -ur.\n",
+				MAXSHARDS);
+	exit (1);
+    }
+
+    /* every operating point must fit the message type and the transport */
+
+    min = tick_type->tagged ? sizeof (DataHdr) : offsetof (RawDataMsg, rawData);
+    max = (udp || mcast) ? NET_MAX_UDP_LEN : NET_MAX_MSG_LEN;
+    for (n = 0; n < nsizes; n++)
+	if (sizes[n] != 0 && (sizes[n] < min || sizes[n] > max)) {
+	    (void)fprintf (stderr, "lscs_tstsrv: -size takes %d to %d bytes for %s.\n",
+				    min, max, tick_type->msg);
+	    exit (1);
+	}
+    if (simulate && (fanout || tick_type != &tick_types[0] || sizes[0] != 0)) {
+	(void)fprintf (stderr, "lscs_tstsrv: -sim sends each client its own SegRtDataMsg: "
+			       "not with -ur, -type or -size.\n");
+	exit (1);
+    }
+    for (n = 0; simulate && n < nrates; n++)
+	if (rates[n] != SEGSIM_RATE / SMPL_PER_MSG) {
+	    /* each tick carries SMPL_PER_MSG of the SEGSIM_RATE frames/s */
+	    (void)fprintf (stderr, "lscs_tstsrv: -sim ticks at %d Hz only.\n",
+				    SEGSIM_RATE / SMPL_PER_MSG);
 	    exit (1);
 	}
+    if (dwell < 1) {
+	(void)fprintf (stderr, "lscs_tstsrv: -dwell takes 1 second or more.\n");
+	exit (1);
+    }
+    nsteps = nrates * nsizes;
+
+    /* real-time profile first: the sender threads inherit it */
+
+    if (rt_profile (rt_spec, rt_desc, sizeof rt_desc) < 0) {
+	(void)fprintf (stderr, "lscs_tstsrv: -rt takes prio[@cpus], e.g. 80@2,3.\n");
+	exit (1);
     }
+    printf ("lscs_tstsrv: Profile %s.\n", rt_desc);
 
     for (i = 0; i < MAXCLIENTS; i++)
     	cli_fd[i] = ERROR;
 
     /* initialize server's network connection */
 
-    if ((listenfd = net_init (server)) < 0 ) {
-	(void)fprintf (stderr, "lscs_tstsrv: net_init() error: %s, errno=%d\n",
-				NET_ERRSTR(listenfd), errno);
-	exit (listenfd);
+    if (mcast) {
+	if (server[0] == '\0')
+	    (void) strncpy (server, LSCS_50HZ_MCAST_GRP, sizeof server);
+
+	if ((mcastfd = net_mcast_open (server, ifname, BLOCKING)) < 0) {
+	    (void)fprintf (stderr, "lscs_tstsrv: net_mcast_open() error: %s, errno=%d\n",
+				    NET_ERRSTR(mcastfd), errno);
+	    exit (mcastfd);
+	}
+	else
+	    printf ("lscs_tstsrv: Publishing to multicast group %s on socket %d...\n",
+							server, mcastfd);
+    }
+    else if (udp) {
+	if (server[0] == '\0')
+	    (void) strncpy (server, LSCS_50HZ_UDP_SRV, sizeof server);
+
+	if ((udpfd = net_udp_open (server, NULL, NON_BLOCKING)) < 0) {
+	    (void)fprintf (stderr, "lscs_tstsrv: net_udp_open() error: %s, errno=%d\n",
+				    NET_ERRSTR(udpfd), errno);
+	    exit (udpfd);
+	}
+	else
+	    printf ("lscs_tstsrv: Waiting for UDP subscribers on socket %d...\n", udpfd);
+    }
+    else {
+	if (server[0] == '\0')
+	    (void) strncpy (server, LSCS_50HZ_DATA_SRV, sizeof server);
+
+	if ((listenfd = net_init (server)) < 0 ) {
+	    (void)fprintf (stderr, "lscs_tstsrv: net_init() error: %s, errno=%d\n",
+				    NET_ERRSTR(listenfd), errno);
+	    exit (listenfd);
+	}
+	else
+	    printf ("lscs_tstsrv: Listening on socket %d...\n", listenfd);
     }
-    else
-        printf ("lscs_tstsrv: Listening on socket %d...\n", listenfd);
 
     if (timerCreate (&tmfd) == -1) {
     	(void)fprintf (stderr, "lscs_tstsrv: Error creating timer.\n");
 	exit (tmfd);
     }
 
-    /* Main event loop */
+    set_step ();
+
+    /* fault in the tick's buffers now, should memory not be locked */
+
+    if (rt_spec != NULL) {
+	rt_prefault (&tick_stat, sizeof tick_stat);
+	rt_prefault (&tick_wh, sizeof tick_wh);
+	rt_prefault (udp_cli, sizeof udp_cli);
+	rt_prefault (cli_status, sizeof cli_status);
+	if (simulate) {
+	    rt_prefault (sim, sizeof sim);
+	    rt_prefault (sim_msg, sizeof sim_msg);
+	}
+    }
+
+    /* the multicast group gets segment 1 */
+
+    if (simulate && mcastfd != ERROR)
+	segsim_init (&sim[0], 1);
+
+    /* sender threads, pinned to their cores */
+
+    if (nshards > 0 && start_shards (nshards, cpus) < 0)
+	exit (1);
+
+    /* register the descriptors with the event loop */
 
-    event_loop ();
+    if ((ev = net_evloop_create ()) == NULL) {
+	perror ("lscs_tstsrv: net_evloop_create");
+	exit (1);
+    }
 
     if (listenfd != ERROR)
-        net_close (listenfd);
+	(void) net_evloop_add (ev, listenfd, NET_EV_IN, on_accept, NULL);
+    if (udpfd != ERROR)
+	(void) net_evloop_add (ev, udpfd, NET_EV_IN, on_udp, NULL);
+    (void) net_evloop_add (ev, tmfd, NET_EV_IN, on_timer, NULL);
+
+    /* Ctrl-C ends the loop, for the final tick report */
+
+    (void) signal (SIGINT, on_signal);
+    (void) signal (SIGTERM, on_signal);
+
+    /* publishers don't know their subscribers; tick from the start */
+
+    if (mcastfd != ERROR)
+	start_timer ();
+
+    /* Main event loop */
+
+    if (net_evloop_run (ev) < 0) {
+	perror ("lscs_tstsrv: net_evloop_run");
+	exit (-1);
+    }
+
+    /* report every client's queue, then unregister it from the loop */
 
     for (i = 0; i < MAXCLIENTS; i++)
 	if (cli_fd[i] != ERROR)
-	    net_close (cli_fd[i]);
+	    close_client (i);
+    net_evloop_destroy (ev);
+
+    if (step < nsteps)
+	report_step ();
+    report_ticks (true);
+
+    if (listenfd != ERROR)
+        net_close (listenfd);
+
+    if (mcastfd != ERROR)
+        net_close (mcastfd);
+
+    if (udpfd != ERROR)
+        net_close (udpfd);
 
     return 0;
 }
 
 
-void event_loop ()
+/*
+ *  Accept every pending connection: the listener only signals new ones.
+ */
+void on_accept (net_evloop *ev, int fd, int events, void *arg)
+{
+    int sockfd, n;
+
+    while ((sockfd = net_accept (listenfd, NON_BLOCKING)) != NWOULDBLOCK) {
+
+	if (sockfd < 0) {
+	    (void)fprintf (stderr, "lscs_tstsrv: net_accept() error: %s, errno=%d\n",
+				    NET_ERRSTR(sockfd), errno);
+	    if (errno == EMFILE || errno == ENFILE)
+		return;
+	    net_close (listenfd);
+	    exit (sockfd);
+	}
+	(void)printf ("lscs_tstsrv: Connection accepted.\n");
+
+	/* sequence-number and timestamp every message, if -v2 */
+	(void) net_sethdrver (sockfd, hdrver);
+
+	n = 0;
+
+	while (n < MAXCLIENTS && cli_fd[n] != ERROR)
+	    n++;
+
+	if (n < MAXCLIENTS) {
+	    cli_fd[n] = sockfd;
+	    if (simulate)
+		segsim_init (&sim[n], n + 1);
+	    tx_n[n] = tx_sum[n] = tx_max[n] = 0;
+	    if (tstamp && net_settstamp (sockfd, NET_TS_TX) < 0)
+		(void)fprintf (stderr, "lscs_tstsrv: net_settstamp() error: %s\n",
+					strerror (errno));
+
+	    /* a slow client's ticks wait in its queue, up to -q of them */
+	    if (q_depth > 0)
+		(void) net_setqueue (sockfd, q_depth, q_policy);
+
+	    /* writable again wakes a slow client's partial message */
+	    (void) net_evloop_add (ev, sockfd, NET_EV_IN | NET_EV_OUT, on_client,
+				   (void *) (intptr_t) n);
+	    start_timer ();
+	}
+	else {
+	    (void)fprintf (stderr, "lscs_tstsrv: Max client connections exceeded.\n");
+	    net_close (sockfd);
+	}
+    }
+}
+
+
+void on_client (net_evloop *ev, int fd, int events, void *arg)
+{
+    int i = (int) (intptr_t) arg;
+
+    if ((events & NET_EV_OUT) && net_pending (fd) > 0) {
+
+	/* send the rest of a message to a slow client */
+	if (net_flush (fd, NON_BLOCKING) < 0) {
+	    (void)fprintf (stderr, "lscs_tstsrv: net_flush() error: %s\n",
+				    strerror (errno));
+	    close_client (i);
+	    return;
+	}
+    }
+
+    if (events & (NET_EV_IN | NET_EV_ERR)) {
+
+	/* service every request received */
+	while (process_msg (i) > 0)
+	    ;
+    }
+}
+
+
+void on_udp (net_evloop *ev, int fd, int events, void *arg)
+{
+    (void) process_udp (fd);
+}
+
+
+void on_timer (net_evloop *ev, int fd, int events, void *arg)
+{
+    struct timespec end;
+    long exp;
+
+    clock_gettime (CLOCK_MONOTONIC, &tick_time);
+
+    /* send first: the expiration count can wait until the tick is out */
+
+    (void) process_timer ();
+    clock_gettime (CLOCK_MONOTONIC, &end);
+
+    exp = read_timer (fd);
+    account_tick (&tick_time, &end, exp);
+
+    /* the frames of missed ticks are lost, as a real segment's would be */
+
+    sim_frame += SMPL_PER_MSG * exp;
+}
+
+
+void on_signal (int sig)
+{
+    net_evloop_stop (ev);
+}
+
+
+void close_client (int indx)
+{
+    net_txqinfo q;
+
+    if (net_getqueue (cli_fd[indx], &q) == SUCCESS && q.hiwat > 0)
+	(void)printf ("lscs_tstsrv: Client %d queue high-water %d, %u dropped.\n",
+		      indx, q.hiwat, q.ndropped);
+
+    (void) net_evloop_del (ev, cli_fd[indx]);
+    net_close (cli_fd[indx]);
+    cli_fd[indx] = ERROR;
+}
+
+
+void start_timer ()
 {
-    fd_set read_fds;       /* file descriptors to be polled */
-    int  nfds;
-    int  sockfd, i;
     struct timeval tm1, tm2, tm_start;
-    struct timeval tm_50hz = {0, 20*1000};	// {0s, 20ms}
 
-    while (1) {
+    /* (re)start the tick on the next whole second */
 
-        FD_ZERO (&read_fds);
-        FD_SET (listenfd, &read_fds);
+    if (debug) fprintf (stderr, "tm_tick.(tv_sec, tv_usec) = (%ld, %ld)\n",
+					    tm_tick.tv_sec, tm_tick.tv_usec);
+    gettimeofday (&tm1, NULL);
+    tm2 = (struct timeval){tm1.tv_sec+1, 0};
+    timersub(&tm2, &tm1, &tm_start);
 
-	for (i = 0; i < MAXCLIENTS; i++)
-	    if (cli_fd[i] != ERROR) FD_SET (cli_fd[i], &read_fds);
-
-	if (tmfd != ERROR) FD_SET (tmfd, &read_fds);
-
-        nfds = select (FD_SETSIZE, &read_fds, (fd_set *) 0, (fd_set *) 0,
-                       (struct timeval *) 0);
-
-        if (nfds <= 0)  {
-            if (errno == EINTR)  {
-                continue;
-            }
-            // error on select
-            (void)fprintf (stderr, "lscs_tstsrv: select() error: %s.", strerror (errno));
-            exit (-1);
-        }
-        else {
-            if (FD_ISSET (listenfd, &read_fds)) {
-
-		/* accept new client connection */
-		if ((sockfd = net_accept (listenfd, BLOCKING)) < 0) {
-		    (void)fprintf (stderr, "lscs_tstsrv: net_accept() error: %s, errno=%d\n",
-					    NET_ERRSTR(sockfd), errno);
-		    net_close (listenfd);
-		    exit (sockfd);
-		}
-		(void)printf ("lscs_tstsrv: Connection accepted.\n");
+    /* the first expiration, on the timer's clock */
 
-		int n = 0;
+    /* simulated frames count from the same second in every server, as
+       the LSEBs' from their common clock */
 
-		while (n < MAXCLIENTS && cli_fd[n] != ERROR)
-		    n++;
+    sim_frame = (unsigned long) tm2.tv_sec * SEGSIM_RATE;
 
-		if (n < MAXCLIENTS) {
-		    cli_fd[n] = sockfd;
-		    if (debug) fprintf (stderr, "tm_50hz.(tv_sec, tv_usec) = (%ld, %ld)\n",
-							    tm_50hz.tv_sec, tm_50hz.tv_usec);
-		    gettimeofday (&tm1, NULL);
-		    tm2 = (struct timeval){tm1.tv_sec+1, 0};
-		    timersub(&tm2, &tm1, &tm_start);
+    clock_gettime (CLOCK_MONOTONIC, &tick_sched);
+    tick_sched.tv_sec  += tm_start.tv_sec;
+    tick_sched.tv_nsec += tm_start.tv_usec * 1000;
+    if (tick_sched.tv_nsec >= 1000000000L) {
+	tick_sched.tv_sec++;
+	tick_sched.tv_nsec -= 1000000000L;
+    }
+
+    if (tmfd != ERROR) setTimer (tmfd, &tm_start, &tm_tick);
+}
 
-		    if (tmfd != ERROR) setTimer (tmfd, &tm_start, &tm_50hz);
-		}
-		else {
-		    (void)fprintf (stderr, "lscs_tstsrv: Max client connections exceeded.\n");
-		    net_close (sockfd);
-		}
 
-                if (--nfds <= 0)
-                    continue;
-            }
+int process_udp (int ufd)
+{
+    static char msg[MAXCLIENTS][MAXMSGLEN];
+    net_udpmsg	msgv[MAXCLIENTS];
+    int		n, i, j, k, seg;
+    char	*cmd;
+
+    for (i = 0; i < MAXCLIENTS; i++) {
+	msgv[i].buf    = msg[i];
+	msgv[i].maxlen = sizeof msg[i];
+    }
 
-	    if (tmfd != ERROR && FD_ISSET (tmfd, &read_fds)) {
-	    	(void) process_timer (tmfd);
+    /* drain queued subscription requests */
 
-                if (--nfds <= 0)
-                    continue;
+    while ((n = net_udp_recvmmsg (ufd, msgv, MAXCLIENTS, NON_BLOCKING)) > 0) {
+
+	for (i = 0; i < n; i++) {
+
+	    if (msgv[i].len < sizeof (MsgHdr) ||
+			((MsgHdr *) msgv[i].buf)->msgId != CMD_TYPE) {
+		(void)fprintf (stderr, "lscs_tstsrv: Invalid datagram received.\n");
+		continue;
 	    }
+	    ((CmdMsg *) msgv[i].buf)->cmd[MAX_CMD_LEN - 1] = '\0';
+	    cmd = ((CmdMsg *) msgv[i].buf)->cmd;
 
-	    for (i = 0; i < MAXCLIENTS; i++)
-		if (cli_fd[i] != ERROR && FD_ISSET (cli_fd[i], &read_fds)) {
+	    for (j = 0; j < n_udp; j++)
+		if (!memcmp (&udp_cli[j].addr, &msgv[i].addr, sizeof msgv[i].addr))
+		    break;
 
-		    /* service client's request */
-		    (void) process_msg (i);
-		    if (--nfds <= 0)
-			break;
+	    if (!strcmp (cmd, "subscribe") && j == n_udp) {
+		if (n_udp >= MAXCLIENTS) {
+		    (void)fprintf (stderr, "lscs_tstsrv: Max UDP subscribers exceeded.\n");
+		    continue;
+		}
+		udp_cli[n_udp++].addr = msgv[i].addr;
+		if (simulate) {
+		    /* the lowest segment number no subscriber has */
+		    for (seg = 1; ; seg++) {
+			for (k = 0; k < n_udp - 1 && sim[k].segno != seg; k++)
+			    ;
+			if (k == n_udp - 1)
+			    break;
+		    }
+		    segsim_init (&sim[n_udp - 1], seg);
 		}
-        }
+		(void)printf ("lscs_tstsrv: UDP subscriber added.\n");
+		if (n_udp == 1)
+		    start_timer ();
+	    }
+	    else if (!strcmp (cmd, "unsubscribe") && j < n_udp) {
+		udp_cli[j] = udp_cli[--n_udp];
+		if (simulate)
+		    sim[j] = sim[n_udp];	/* its segment goes with it */
+		(void)printf ("lscs_tstsrv: UDP subscriber removed.\n");
+	    }
+	}
     }
+
+    if (n != NWOULDBLOCK)
+	(void)fprintf (stderr, "lscs_tstsrv: net_udp_recvmmsg() error: %s, errno=%d\n",
+				NET_ERRSTR(n), errno);
+    return n;
 }
 
 
@@ -191,29 +685,53 @@ int process_msg (int indx)
 {
     char msg[MAXMSGLEN];
     int  len;
+    struct timespec recvd;
 
     int  send_rsp (int sockfd, char *cmdstr);
+    int  send_clk (int sockfd, ClkMsg *clk, struct timespec *recvd);
 
     (void) memset (msg, 0, sizeof msg);
 
-    if ((len = net_recv (cli_fd[indx], msg, MAXMSGLEN, BLOCKING)) < 0) {
+    /* queued transmit timestamps also make the socket readable */
+
+    if (tstamp)
+	(void) process_txstamps (indx);
+
+    /* a partial request is kept by net_recv() until the rest arrives */
+
+    if ((len = net_recv (cli_fd[indx], msg, MAXMSGLEN, NON_BLOCKING)) == NWOULDBLOCK)
+	return len;
+
+    clock_gettime (CLOCK_REALTIME, &recvd);
+
+    if (len < 0) {
 	(void)fprintf (stderr, "lscs_tstsrv: net_recv() error: %s, errno=%d\n",
 				NET_ERRSTR(len), errno);
+	close_client (indx);
 	return len;
     }
     else if (len == NEOF) {
 	(void)printf ("lscs_tstsrv: Closing broken connection...\n");
-	net_close (cli_fd[indx]);
-	cli_fd[indx] = ERROR;
+	close_client (indx);
 	return len;
     }
 
     if (((MsgHdr *) msg)->msgId == CMD_TYPE) {
+	char policy[16];
+	int  depth;
 
 	((CmdMsg *) msg)->cmd[MAX_CMD_LEN - 1] = '\0';
     	(void)printf ("%s\n", ((CmdMsg *) msg)->cmd);
+
+	/* "queue <depth> <policy>" sets the client's own queue */
+	if (sscanf (((CmdMsg *) msg)->cmd, "queue %d %15s", &depth, policy) == 2 &&
+				set_queue (indx, depth, policy) < 0)
+	    (void)fprintf (stderr, "lscs_tstsrv: Invalid queue command.\n");
+
 	send_rsp (cli_fd[indx], ((CmdMsg *) msg)->cmd);
     }
+    else if (((MsgHdr *) msg)->msgId == CLK_TYPE && len == sizeof (ClkMsg))
+	send_clk (cli_fd[indx], (ClkMsg *) msg, &recvd);
     else
     	(void)fprintf (stderr, "lscs_tstsrv: Invalid message received.\n");
 
@@ -238,36 +756,636 @@ int send_rsp (int sockfd, char *cmdstr)
 }
 
 
-int process_timer (int tfd)
+/*
+ *  Echo a client's clock probe, with the time it was received and, as late
+ *  as possible, the time the reply is sent.
+ */
+int send_clk (int sockfd, ClkMsg *clk, struct timespec *recvd)
 {
-    uint64_t	   exp;
-    ssize_t	   s;
-    int		   i, status;
-    struct timeval tm;
-    SegRtDataMsg seg_msg;
+    struct timespec now;
+    int		    status;
+
+    clk->t2 = *recvd;
+    clock_gettime (CLOCK_REALTIME, &now);
+    clk->t3 = now;
+
+    if ((status = net_send (sockfd, (char *) clk, sizeof *clk, BLOCKING)) <= 0)
+        (void)fprintf (stderr, "lscs_tstsrv: net_send() error: %s, errno=%d\n",
+                                NET_ERRSTR(status), errno);
+    return status;
+}
+
+
+/*
+ *  Build the tick's messages, the -type one tick_len bytes long: past its
+ *  header, a synthetic payload.
+ */
+void build_tick ()
+{
+    RawDataMsg *raw;
+
+    if ((tick_buf = realloc (tick_buf, tick_len)) == NULL) {
+	perror ("lscs_tstsrv: realloc");
+	exit (1);
+    }
+
+    (void) memset (tick_buf, 0, tick_len);
+    (void) memset (&tick_stat, 0, sizeof tick_stat);
+    (void) memset (&tick_wh, 0, sizeof tick_wh);
+
+    ((MsgHdr *) tick_buf)->msgId = tick_type->id;
+    tick_stat.hdr.hdr.msgId = SEG_STATUS_DATA;
+    tick_wh.hdr.hdr.msgId   = WH_STRAIN_DATA;
+
+    if (tick_type->id == RAW_DATA) {
+	raw = (RawDataMsg *) tick_buf;
+	raw->dataLen = tick_len - offsetof (RawDataMsg, rawData);
+    }
+
+    tick_msgv[0] = (net_msgvec) {tick_buf, 0, tick_len};
+    tick_msgv[1] = (net_msgvec) {(char *) &tick_stat, 0, sizeof tick_stat};
+    tick_msgv[2] = (net_msgvec) {(char *) &tick_wh, 0, sizeof tick_wh};
+
+    tick_bytes = multi ? tick_len + sizeof tick_stat + sizeof tick_wh : tick_len;
+
+    if (rt_spec != NULL)
+	rt_prefault (tick_buf, tick_len);
+}
+
+
+/*
+ *  Set the tick rate and message size of the current step, and build its
+ *  messages.  The timer takes the new rate when (re)started.
+ */
+void set_step ()
+{
+    tick_rate = rates[step / nsizes];
+    tick_len  = sizes[step % nsizes] ? sizes[step % nsizes] : tick_type->len;
+
+    tm_tick.tv_sec  = 0;
+    tm_tick.tv_usec = 1000000 / tick_rate;
+    if (tick_rate == 1)
+	tm_tick = (struct timeval) {1, 0};
+
+    build_tick ();
+
+    (void)printf ("lscs_tstsrv: %s%d Hz, %s of %d bytes.\n",
+		  nsteps > 1 ? "Sweep step: " : "", tick_rate, tick_type->msg,
+		  tick_len);
+}
+
+
+/*
+ *  Parse a list of up to MAXSTEPS values from min to max, "100,200,500".
+ */
+int parse_list (char *arg, int *v, int min, int max)
+{
+    char *p = arg;
+    int  n = 0;
+
+    while (*p != '\0') {
+	if (n == MAXSTEPS)
+	    return ERROR;
+	v[n] = (int) strtol (arg = p, &p, 10);
+	if (p == arg || v[n] < min || v[n] > max || (*p != ',' && *p != '\0'))
+	    return ERROR;
+	n++;
+	if (*p == ',')
+	    p++;
+    }
+
+    return (n > 0) ? n : ERROR;
+}
+
+
+/*
+ *  Return the timer's expirations since the last read, 1 unless ticks
+ *  were missed.
+ */
+long read_timer (int tfd)
+{
+    uint64_t exp;
+    ssize_t  s;
 
     s = read (tfd, &exp, sizeof(uint64_t));
-    if (s != sizeof(uint64_t))
+    if (s != sizeof(uint64_t)) {
     	perror ("read");
+	return 0;
+    }
     else if (debug)
     	(void)fprintf (stderr, "read: timer exp = %lu\n", exp);
 
-    for (i = 0; i < MAXCLIENTS; i++)
-    	if (cli_fd[i] != ERROR) {
-    	    if (debug) NET_TIMESTAMP ("lscs_tstsrv: Sending SegRtDataMsg (%lu bytes)...\n",
-									sizeof(seg_msg));
-	    gettimeofday (&tm, NULL);
-	    seg_msg.hdr.time = tm;
-
-	    if ((status = net_send (cli_fd[i], (char *) &seg_msg, sizeof seg_msg,
-								  BLOCKING)) <= 0) {
-	    	(void)fprintf (stderr, "lscs_tstsrv: net_send() error: %s, errno=%d\n",
-					NET_ERRSTR(status), errno);
-	    	net_close (cli_fd[i]);
-		cli_fd[i] = ERROR;
+    return (long) exp;
+}
+
+
+/*
+ *  Record a tick started at start, its last send done at end, that read
+ *  exp expirations.  The tick served the oldest of them: the others were
+ *  missed, and the next tick is due after the newest.
+ */
+void account_tick (struct timespec *start, struct timespec *end, long exp)
+{
+    long period = tm_tick.tv_sec * 1000000000L + tm_tick.tv_usec * 1000L;
+    long late, busy, ns;
+
+    if (exp <= 0)
+	return;
+
+    late = (start->tv_sec - tick_sched.tv_sec) * 1000000000L +
+	   (start->tv_nsec - tick_sched.tv_nsec);
+    busy = (end->tv_sec - start->tv_sec) * 1000000000L +
+	   (end->tv_nsec - start->tv_nsec);
+    histo_add (&late_h, late);
+    histo_add (&busy_h, busy);
+    histo_add (&miss_h, exp - 1);
+
+    histo_add (&late_step, late);
+    histo_add (&busy_step, busy);
+    step_ticks  += exp;
+    step_missed += exp - 1;
+
+    if (debug && exp > 1)
+	(void)fprintf (stderr, "lscs_tstsrv: Tick %ld us late, %ld missed.\n",
+				late / 1000, exp - 1);
+
+    ns = tick_sched.tv_nsec + exp * period;
+    tick_sched.tv_sec += ns / 1000000000L;
+    tick_sched.tv_nsec = ns % 1000000000L;
+
+    /* summarize every 5 s of ticks */
+
+    if (late_h.count >= 5 * tick_rate)
+	report_ticks (false);
+
+    /* sweeping: on to the next operating point, or done */
+
+    if (nsteps > 1 && step_ticks >= (unsigned long) dwell * tick_rate) {
+	report_ticks (false);
+	report_step ();
+	if (++step == nsteps) {
+	    net_evloop_stop (ev);
+	    return;
+	}
+	set_step ();
+	start_timer ();
+    }
+}
+
+
+/*
+ *  Summarize the step, an operating point, on one line: how its ticks
+ *  kept to their schedule, and what the clients were sent.
+ */
+void report_step ()
+{
+    double secs = (double) step_ticks / tick_rate;
+
+    if (step_ticks == 0)
+	return;
+
+    (void)printf ("lscs_tstsrv: Step %d: %d Hz, %d bytes: %lu ticks, %lu missed, "
+		  "late p50/p99 %ld/%ld us, busy p50/p99 %ld/%ld us, "
+		  "%.0f msgs/s, %.2f MB/s\n", step, tick_rate, tick_len,
+		  step_ticks, step_missed,
+		  histo_pct (&late_step, 50) / 1000, histo_pct (&late_step, 99) / 1000,
+		  histo_pct (&busy_step, 50) / 1000, histo_pct (&busy_step, 99) / 1000,
+		  step_msgs / secs, step_bytes / secs / 1e6);
+
+    histo_reset (&late_step);
+    histo_reset (&busy_step);
+    step_ticks = step_missed = step_msgs = 0;
+    step_bytes = 0;
+}
+
+
+/*
+ *  Print the tick statistics of the last 5 s on one line, and add them to
+ *  those of the run; or print the run's, with their percentiles.
+ */
+void report_ticks (bool final)
+{
+    histo_merge (&late_run, &late_h);
+    histo_merge (&busy_run, &busy_h);
+    histo_merge (&miss_run, &miss_h);
+
+    if (!final && late_h.count > 0)
+	(void)printf ("lscs_tstsrv: Tick late p50/p99/max %ld/%ld/%ld us, "
+		      "busy p50/p99/max %ld/%ld/%ld us, %.0f missed\n",
+		      histo_pct (&late_h, 50) / 1000,
+		      histo_pct (&late_h, 99) / 1000, late_h.max / 1000,
+		      histo_pct (&busy_h, 50) / 1000,
+		      histo_pct (&busy_h, 99) / 1000, busy_h.max / 1000,
+		      miss_h.sum);
+
+    histo_reset (&late_h);
+    histo_reset (&busy_h);
+    histo_reset (&miss_h);
+
+    if (!final || late_run.count == 0)
+	return;
+
+    (void)printf ("lscs_tstsrv: Profile %s.\n", rt_desc);
+    histo_print (stdout, "lscs_tstsrv: Tick lateness", &late_run, 1000, "us");
+    histo_print (stdout, "lscs_tstsrv: Tick start to last send", &busy_run,
+		 1000, "us");
+    histo_print (stdout, "lscs_tstsrv: Missed expirations per tick", &miss_run,
+		 1, "ticks");
+    (void)printf ("lscs_tstsrv: %.0f ticks missed of %.0f scheduled.\n",
+		  miss_run.sum, miss_run.sum + miss_run.count);
+}
+
+
+int process_timer ()
+{
+    int		   i, n, status;
+    struct timeval tm;
+    int		   fan_fd[MAXCLIENTS];
+    int		   fan_status[MAXCLIENTS];
+
+    /* time-tag the tick once; clients are sent the same messages */
+
+    gettimeofday (&tm, NULL);
+    if (tick_type->tagged)
+	((DataHdr *) tick_buf)->time = tm;
+    tick_stat.hdr.time = tm;
+    tick_wh.hdr.time   = tm;
+
+    if (mcastfd != ERROR) {
+
+	/* one datagram for the whole group */
+
+	if (simulate)
+	    status = net_send (mcastfd, (char *) sim_fill (0), sizeof (SegRtDataMsg),
+			       BLOCKING);
+	else
+	    status = net_send (mcastfd, tick_buf, tick_len, BLOCKING);
+
+	if (status <= 0)
+	    (void)fprintf (stderr, "lscs_tstsrv: net_send() error: %s, errno=%d\n",
+				    NET_ERRSTR(status), errno);
+	else {
+	    step_msgs++;
+	    step_bytes += tick_len;
+	}
+    }
+
+    if (udpfd != ERROR && n_udp > 0) {
+
+	/* one datagram per subscriber, all sent with a single system call */
+
+	for (i = 0; i < n_udp; i++) {
+	    udp_cli[i].buf = simulate ? (char *) sim_fill (i) : tick_buf;
+	    udp_cli[i].len = tick_len;
+	}
+
+	if ((status = net_udp_sendmmsg (udpfd, udp_cli, n_udp, BLOCKING)) < 0)
+	    (void)fprintf (stderr, "lscs_tstsrv: net_udp_sendmmsg() error: %s, errno=%d\n",
+				    NET_ERRSTR(status), errno);
+	else {
+	    step_msgs += status;
+	    step_bytes += (double) status * tick_len;
+	}
+    }
+
+    if (fanout) {
+
+	/* the same message to every client, all sent with a single system call */
+
+	for (n = 0, i = 0; i < MAXCLIENTS; i++)
+	    if (cli_fd[i] != ERROR)
+		fan_fd[n++] = cli_fd[i];
+
+	if (n == 0)
+	    return 0;
+
+	if ((status = net_send_fanout (fan_fd, n, tick_buf, tick_len,
+				       NON_BLOCKING, fan_status)) < 0) {
+	    (void)fprintf (stderr, "lscs_tstsrv: net_send_fanout() error: %s, errno=%d\n",
+				    NET_ERRSTR(status), errno);
+	    return 0;
+	}
+
+	for (n = 0, i = 0; i < MAXCLIENTS; i++)
+	    if (cli_fd[i] != ERROR) {
+		status = fan_status[n++];
+		if (status == NWOULDBLOCK) {
+		    if (debug) (void)fprintf (stderr, "lscs_tstsrv: Client %d is behind, "
+						      "tick skipped.\n", i);
+		}
+		else if (status <= 0) {
+		    (void)fprintf (stderr, "lscs_tstsrv: net_send_fanout() error: %s\n",
+					    NET_ERRSTR(status));
+		    close_client (i);
+		}
+		else {
+		    step_msgs++;
+		    step_bytes += tick_len;
+		}
 	    }
-    	}
+
+	return 0;
+    }
+
+    if (nshards > 0) {
+
+	/* wake the sender threads and wait for the last of them */
+
+	pthread_mutex_lock (&tick_lock);
+	tick_busy = nshards;
+	tick_no++;
+	pthread_cond_broadcast (&tick_start);
+
+	while (tick_busy > 0)
+	    pthread_cond_wait (&tick_done, &tick_lock);
+	pthread_mutex_unlock (&tick_lock);
+
+	for (i = 0; i < MAXCLIENTS; i++)
+	    if (cli_fd[i] != ERROR)
+		check_send (i, cli_status[i]);
+
+	report_shards ();
+	return 0;
+    }
+
+    for (i = 0; i < MAXCLIENTS; i++)
+    	if (cli_fd[i] != ERROR)
+	    check_send (i, send_client (i));
 
     return 0;
 }
 
+
+/*
+ *  Send the tick to one client, from the main thread or its shard.
+ */
+int send_client (int indx)
+{
+    struct timeval tm;
+    DataHdr	   hdr;
+    struct iovec   iov[2];
+    net_msgvec	   msgv[3];
+
+    if (debug) NET_TIMESTAMP ("lscs_tstsrv: Sending %s (%d bytes)...\n",
+						tick_type->msg, tick_len);
+
+    /* never block the tick on a slow client: the rest of a partially
+       sent message goes out when its socket becomes writable */
+
+    if (simulate) {
+
+	/* the client's own segment */
+
+	msgv[0] = (net_msgvec) {(char *) sim_fill (indx), 0, sizeof (SegRtDataMsg)};
+	if (!multi)
+	    return net_send (cli_fd[indx], msgv[0].buf, msgv[0].len, NON_BLOCKING);
+
+	msgv[1] = tick_msgv[1];
+	msgv[2] = tick_msgv[2];
+	return net_send_many (cli_fd[indx], msgv, 3, NON_BLOCKING);
+    }
+
+    if (multi) {
+
+	/* the tick's status and strain messages share its segments */
+
+	return net_send_many (cli_fd[indx], tick_msgv, 3, NON_BLOCKING);
+    }
+
+    if (tick_tag || !tick_type->tagged || tick_len == sizeof hdr)
+	return net_send (cli_fd[indx], tick_buf, tick_len, NON_BLOCKING);
+
+    /* the client's own time tag: only the header is copied */
+
+    gettimeofday (&tm, NULL);
+    hdr = *(DataHdr *) tick_buf;
+    hdr.time = tm;
+
+    iov[0] = (struct iovec) {(char *) &hdr, sizeof hdr};
+    iov[1] = (struct iovec) {tick_buf + sizeof hdr, tick_len - sizeof hdr};
+
+    return net_sendv (cli_fd[indx], iov, 2, NON_BLOCKING);
+}
+
+
+/*
+ *  Generate the samples of client indx's segment for this tick, and
+ *  time-tag them.
+ */
+SegRtDataMsg *sim_fill (int indx)
+{
+    SegRtDataMsg   *msg = &sim_msg[indx];
+    struct timeval tm;
+
+    segsim_fill (&sim[indx], msg->data, SMPL_PER_MSG, sim_frame);
+
+    if (tick_tag)
+	tm = ((DataHdr *) tick_buf)->time;
+    else
+	gettimeofday (&tm, NULL);
+
+    msg->hdr.hdr.msgId = SEG_REALTIME_DATA;
+    msg->hdr.hdr.srcId = sim[indx].segno;
+    msg->hdr.time = tm;
+
+    return msg;
+}
+
+
+void check_send (int indx, int status)
+{
+    if (status == NWOULDBLOCK) {
+	if (debug) (void)fprintf (stderr, "lscs_tstsrv: Client %d is behind, "
+					  "tick skipped.\n", indx);
+    }
+    else if (status == NEOF) {
+	(void)printf ("lscs_tstsrv: Client %d disconnected.\n", indx);
+	close_client (indx);
+    }
+    else if (status < 0) {
+	(void)fprintf (stderr, "lscs_tstsrv: net_send() error: %s, errno=%d\n",
+				NET_ERRSTR(status), errno);
+	close_client (indx);
+    }
+    else if (multi) {
+
+	/* net_send_many() may have taken only the first messages */
+
+	step_msgs += status;
+	step_bytes += (status == 3) ? tick_bytes : (status == 2) ?
+		      tick_len + sizeof tick_stat : tick_len;
+    }
+    else {
+	step_msgs++;
+	step_bytes += tick_len;
+    }
+}
+
+
+/*
+ *  Give client indx an outbound queue of depth messages with the named
+ *  overflow policy, or with indx ERROR, only look the policy up.
+ */
+int set_queue (int indx, int depth, char *policy)
+{
+    int p;
+
+    if (!strcmp (policy, "oldest"))
+	p = NET_Q_DROP_OLDEST;
+    else if (!strcmp (policy, "newest"))
+	p = NET_Q_DROP_NEWEST;
+    else if (!strcmp (policy, "disconnect"))
+	p = NET_Q_DISCONNECT;
+    else
+	return ERROR;
+
+    if (indx != ERROR && net_setqueue (cli_fd[indx], depth, p) < 0)
+	return ERROR;
+
+    return p;
+}
+
+
+/*
+ *  Start n sender threads, pinned in turn to the cores listed in cpus
+ *  ("2,3,5"), or by default to cores 1, 2... leaving core 0 to the main
+ *  thread.
+ */
+int start_shards (int n, char *cpus)
+{
+    cpu_set_t set;
+    long      ncpu = sysconf (_SC_NPROCESSORS_ONLN);
+    int       cpu[MAXSHARDS];
+    int       ncpus = 0;
+    char      *p;
+    int       k, status;
+
+    for (p = cpus; p != NULL && *p != '\0' && ncpus < MAXSHARDS; ncpus++) {
+	cpu[ncpus] = (int) strtol (p, &p, 10);
+	if (*p == ',')
+	    p++;
+    }
+
+    for (k = 0; k < n; k++) {
+	if (ncpus > 0)
+	    shard[k].cpu = cpu[k % ncpus];
+	else
+	    shard[k].cpu = (ncpu > 1) ? 1 + k % (ncpu - 1) : 0;
+
+	if ((status = pthread_create (&shard[k].tid, NULL, shard_main,
+				      (void *) (intptr_t) k)) != 0) {
+	    (void)fprintf (stderr, "lscs_tstsrv: pthread_create() error: %s\n",
+				    strerror (status));
+	    return ERROR;
+	}
+
+	CPU_ZERO (&set);
+	CPU_SET (shard[k].cpu, &set);
+	if ((status = pthread_setaffinity_np (shard[k].tid, sizeof set, &set)) != 0)
+	    (void)fprintf (stderr, "lscs_tstsrv: Shard %d not pinned to cpu %d: %s\n",
+				    k, shard[k].cpu, strerror (status));
+    }
+
+    (void)printf ("lscs_tstsrv: %d sender threads started.\n", n);
+    return 0;
+}
+
+
+void *shard_main (void *arg)
+{
+    int		    k = (int) (intptr_t) arg;
+    unsigned	    seen = 0;
+    struct timespec now;
+    int		    i;
+
+    while (1) {
+	pthread_mutex_lock (&tick_lock);
+	while (tick_no == seen)
+	    pthread_cond_wait (&tick_start, &tick_lock);
+	seen = tick_no;
+	pthread_mutex_unlock (&tick_lock);
+
+	for (i = k; i < MAXCLIENTS; i += nshards)
+	    if (cli_fd[i] != ERROR)
+		cli_status[i] = send_client (i);
+
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	shard[k].done = (now.tv_sec - tick_time.tv_sec) * 1000000000L +
+			(now.tv_nsec - tick_time.tv_nsec);
+
+	pthread_mutex_lock (&tick_lock);
+	if (--tick_busy == 0)
+	    pthread_cond_signal (&tick_done);
+	pthread_mutex_unlock (&tick_lock);
+    }
+
+    return NULL;
+}
+
+
+/*
+ *  Accumulate the completion time of each shard, and of the tick (its last
+ *  shard), and summarize them every 5 s of ticks.
+ */
+void report_shards ()
+{
+    long last = 0;
+    int  k;
+
+    for (k = 0; k < nshards; k++) {
+	shard[k].n++;
+	shard[k].sum += shard[k].done;
+	if (shard[k].done > shard[k].max) shard[k].max = shard[k].done;
+	if (shard[k].done > last) last = shard[k].done;
+    }
+
+    last_n++;
+    last_sum += last;
+    if (last > last_max) last_max = last;
+
+    if (last_n < 5 * tick_rate)
+	return;
+
+    for (k = 0; k < nshards; k++) {
+	(void)printf ("lscs_tstsrv: Shard %d (cpu %d) tick-done avg/max %ld/%ld us\n",
+		      k, shard[k].cpu, shard[k].sum / shard[k].n / 1000,
+		      shard[k].max / 1000);
+	shard[k].n = shard[k].sum = shard[k].max = 0;
+    }
+    (void)printf ("lscs_tstsrv: Tick to last client avg/max %ld/%ld us\n",
+		  last_sum / last_n / 1000, last_max / 1000);
+    last_n = last_sum = last_max = 0;
+}
+
+
+int process_txstamps (int indx)
+{
+    net_txstamp ts[64];
+    long	lat;
+    int		n, i;
+
+    while ((n = net_gettxstamps (cli_fd[indx], ts, 64, NON_BLOCKING)) > 0)
+	for (i = 0; i < n; i++) {
+	    lat = (ts[i].kernel.tv_sec - ts[i].sent.tv_sec) * 1000000000L +
+		  (ts[i].kernel.tv_nsec - ts[i].sent.tv_nsec);
+
+	    if (debug)
+		(void)fprintf (stderr, "lscs_tstsrv: Client %d message %u: "
+				       "tx-ktx %ld ns\n", indx, ts[i].seq_no, lat);
+
+	    if (tx_n[indx] == 0 || lat < tx_min[indx]) tx_min[indx] = lat;
+	    if (lat > tx_max[indx]) tx_max[indx] = lat;
+	    tx_sum[indx] += lat;
+
+	    /* summarize every 5 s of ticks */
+
+	    if (++tx_n[indx] >= 5 * tick_rate) {
+		(void)printf ("lscs_tstsrv: Client %d tx-ktx min/avg/max "
+			      "%ld/%ld/%ld ns\n", indx, tx_min[indx],
+			      tx_sum[indx] / tx_n[indx], tx_max[indx]);
+		tx_n[indx] = tx_sum[indx] = tx_max[indx] = 0;
+	    }
+	}
+
+    return n;
+}
@@ -7,31 +7,193 @@
 #include <unistd.h>
 #include <errno.h>
 #include <netdb.h>
+#include <signal.h>
+#include <sys/socket.h>
 
-#include "net_ts.h"
 #include "net_glc.h"
 #include "GlcMsg.h"
+#include "rtprof.h"
+#include "histo.h"
+#include "segsim.h"
+#include "clkest.h"
+
+#define MAXBATCH  16      // Max messages taken per net_recv_batch() call.
+#define MAXSEGS   APP_SRVS_MAX  // Max segment servers aggregated, if -agg
+#define AGG_WINDOW 8      // Frames being assembled at a time, if -agg
+#define CLK_PROBES 8      // Clock probes per burst, if -clk
 
 bool debug = false;
+bool batch = false;
+bool udp   = false;
+bool mcast = false;
+bool tstamp = false;    // kernel receive timestamps, if -ts
+char *rt_spec = NULL;   // real-time profile, if -rt
+char rt_desc[RT_DESC_LEN];
+int  period = 5;        // latency summary every period s, if -p
+char *dump_path = NULL; // latency distribution file, if -o
+
+/* latencies, in ns, of the last period and of the whole run; with -ts,
+   also split at the kernel receive time */
+histo lat_period, lat_run, wire_run, user_run;
+struct timeval next_report;
+int data_fd = -1;       // shut down on SIGINT/SIGTERM to end the run
+volatile sig_atomic_t stopped = 0;
+
+/* offset of the server's clock, probed on the data connection every
+   clk_period s if -clk, and on SIGUSR1; added to the latencies */
+int  clk_period = 0;
+clkest clk;
+struct timespec clk_sent;       // the probe awaiting its reply
+bool clk_wait = false;
+time_t clk_next = 0;            // the next burst
+volatile sig_atomic_t clk_req = 0;
+
+/* aggregation of one SegRtDataMsg per segment server and tick, if -agg */
+
+char *agg_spec = NULL;  // "endpt[first..last]" or a file of servers
+int  rate = 50;         // the servers' tick rate, if -r
+bool frame_key = false; // frames keyed by frameCount, not time, if -key
+
+typedef struct agg_frame {
+  long key;                     // tick number, or -1 if unused
+  int  nseg;                    // segments arrived
+  struct timeval tag;           // earliest time tag of the segments
+  struct timeval first;         // first arrival
+  unsigned char got[MAXSEGS];   // segments arrived, by server
+} agg_frame;
+
+int  agg_nseg = 0;              // segment servers
+int  agg_open = 0;              // and connections still open
+int  agg_fd[MAXSEGS];
+agg_frame agg_win[AGG_WINDOW];  // frame of tick key in agg_win[key % AGG_WINDOW]
+long agg_maxkey = -1;           // latest tick seen
+unsigned long agg_frames, agg_incomplete, agg_missing, agg_late;
+unsigned long agg_last[3];      // the counts at the last report
+net_evloop *agg_ev;
+
+/* tick (earliest time tag) to last segment's arrival, and first to last
+   arrival, in ns, of complete frames */
+histo tolast_period, tolast_run, spread_run;
 
 int send_cmd(int sockfd, char *cmd);
 int process_rsp(int sockfd);
 int process_tlm(int sockfd);
+int process_udp(int sockfd);
+void report_tlm(char *buff, int len, struct timeval *tm);
+void report_hdr(net_msginfo *info);
+void record_lat(long lat_ns, struct timeval *tm);
+void report_lat(bool final);
+void on_signal(int sig);
+void on_clkreq(int sig);
+void clk_poll(int sockfd, struct timespec *now);
+void clk_send(int sockfd);
+void clk_reply(int sockfd, ClkMsg *msg, struct timespec *now);
+long clk_corr(struct timeval *tm);
+int  process_agg(char *spec, char *hostname);
+int  agg_connect(char *endpt, char *hostname);
+void on_segment(net_evloop *ev, int fd, int events, void *arg);
+void agg_add(int seg, SegRtDataMsg *msg, struct timeval *tm);
+void agg_close(agg_frame *f);
+void report_agg(bool final);
 
 
 int main(int argc, char **argv)
 {
-  char server[16];
+  char server[16] = LSCS_50HZ_DATA_SRV;
   // char cmd[MAX_CMD_LEN];
   int  msgfd;
   int  i;
 
   static char hostname[32] = "localhost";
+  char *ifname = NULL;
 
   for (i = 1; i < argc; i++) {
     if      (!strcmp(argv[i], "-s"))  (void) strcpy(server, argv[++i]);
     else if (!strcmp(argv[i], "-h"))  (void) strcpy(hostname, argv[++i]);
     else if (!strcmp(argv[i], "-d"))   debug = true;
+    else if (!strcmp(argv[i], "-b"))   batch = true;
+    else if (!strcmp(argv[i], "-u"))   udp = true;
+    else if (!strcmp(argv[i], "-mc"))  mcast = true;
+    else if (!strcmp(argv[i], "-i"))   ifname = argv[++i];
+    else if (!strcmp(argv[i], "-ts"))  tstamp = true;
+    else if (!strcmp(argv[i], "-rt"))  rt_spec = argv[++i];
+    else if (!strcmp(argv[i], "-p"))   period = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-o"))   dump_path = argv[++i];
+    else if (!strcmp(argv[i], "-agg")) agg_spec = argv[++i];
+    else if (!strcmp(argv[i], "-r"))   rate = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-key")) frame_key = !strcmp(argv[++i], "frame");
+    else if (!strcmp(argv[i], "-clk")) clk_period = atoi(argv[++i]);
+  }
+
+  if (period <= 0) {
+    (void) fprintf(stderr, "tstcli: -p takes a period in seconds.\n");
+    exit(1);
+  }
+  if (clk_period < 0) {
+    (void) fprintf(stderr, "tstcli: -clk takes a period in seconds.\n");
+    exit(1);
+  }
+  if (clk_period > 0 && (udp || mcast || agg_spec != NULL)) {
+    /* the probes go on the one TCP data connection */
+    (void) fprintf(stderr, "tstcli: -clk is not available with -u, -mc or -agg.\n");
+    exit(1);
+  }
+  if (rate <= 0 || rate > 1000000) {
+    (void) fprintf(stderr, "tstcli: -r takes the servers' tick rate in Hz.\n");
+    exit(1);
+  }
+
+  if (rt_profile(rt_spec, rt_desc, sizeof rt_desc) < 0) {
+    (void) fprintf(stderr, "tstcli: -rt takes prio[@cpus], e.g. 80@2.\n");
+    exit(1);
+  }
+  (void) printf("tstcli: Profile %s.\n", rt_desc);
+
+  if (agg_spec != NULL)
+    exit(process_agg(agg_spec, hostname));
+
+  if (mcast) {
+    /* join the multicast group; no subscription needed */
+    if (!strcmp(server, LSCS_50HZ_DATA_SRV))
+      (void) strcpy(server, LSCS_50HZ_MCAST_GRP);
+
+    msgfd = net_mcast_join(server, ifname, BLOCKING);
+    if (msgfd  < 0) {
+      (void) fprintf(stderr, "tstcli: net_mcast_join() error: %s: %s\n",
+                             NET_ERRSTR(msgfd), strerror (errno));
+      exit(msgfd);
+    }
+    (void) printf("tstcli: Joined %s...\n", server);
+
+    data_fd = msgfd;
+    (void) signal(SIGINT, on_signal);
+    (void) signal(SIGTERM, on_signal);
+    (void) process_udp(msgfd);
+    report_lat(true);
+
+    net_close (msgfd);
+    exit (0);
+  }
+
+  if (udp) {
+    /* open UDP endpoint to server and subscribe to its datagrams */
+    msgfd = net_udp_open(server, hostname, BLOCKING);
+    if (msgfd  < 0) {
+      (void) fprintf(stderr, "tstcli: net_udp_open() error: %s: %s\n",
+                             NET_ERRSTR(msgfd), strerror (errno));
+      exit(msgfd);
+    }
+    if (send_cmd(msgfd, "subscribe") <= 0)
+      exit(1);
+
+    data_fd = msgfd;
+    (void) signal(SIGINT, on_signal);
+    (void) signal(SIGTERM, on_signal);
+    (void) process_udp(msgfd);
+    report_lat(true);
+
+    net_close (msgfd);
+    exit (0);
   }
 
   /* connect to server */
@@ -43,6 +205,18 @@ int main(int argc, char **argv)
   }
 
   (void) printf("tstcli: Connected to %s...\n", server);
+
+  if (batch && (i = net_setrxbuf(msgfd, NET_RXBUF_LEN)) < 0) {
+    (void) fprintf(stderr, "tstcli: net_setrxbuf() error: %s\n", NET_ERRSTR(i));
+    exit(i);
+  }
+
+  /* split the latency at the kernel receive time (needs a -v2 server) */
+  if (tstamp && (i = net_settstamp(msgfd, NET_TS_RX)) < 0) {
+    (void) fprintf(stderr, "tstcli: net_settstamp() error: %s: %s\n",
+                           NET_ERRSTR(i), strerror (errno));
+    exit(i);
+  }
   #if 0
     while (fgets (cmd, MAX_CMD_LEN, stdin)) {
     (void) send_cmd (msgfd, cmd);
@@ -50,8 +224,13 @@ int main(int argc, char **argv)
         break;
     }
   #endif
-  
+
+  data_fd = msgfd;
+  (void) signal(SIGINT, on_signal);
+  (void) signal(SIGTERM, on_signal);
+  (void) signal(SIGUSR1, on_clkreq);
   (void) process_tlm(msgfd);
+  report_lat(true);
 
   net_close (msgfd);
   exit (0);
@@ -101,18 +280,41 @@ int process_rsp(int sockfd)
 
 int process_tlm (int sockfd)
 {
-  int  len;
-  char buff[1024];
+  int  len, n, i;
+  static char buff[MAXBATCH][1024];
+  net_msgvec  msgv[MAXBATCH];
+  char *msg;
   bool more = true;
-  struct timeval tm, lat;
-  static int pkt = 0;
+  struct timeval tm;
+  struct timespec now;
+  net_msginfo info;
 
-  while (more) {
-    (void) memset(buff, 0, sizeof buff);
+  for (i = 0; i < MAXBATCH; i++) {
+    msgv[i].buf    = buff[i];
+    msgv[i].maxlen = sizeof buff[i];
+  }
+  if (rt_spec != NULL)
+    rt_prefault(buff, sizeof buff);
 
-    len = net_recv(sockfd, buff, sizeof buff, BLOCKING);
+  clock_gettime(CLOCK_REALTIME, &now);
+  clk_poll(sockfd, &now);
 
-    gettimeofday(&tm, NULL);
+  while (more) {
+    if (batch) {
+      n = net_recv_batch(sockfd, msgv, MAXBATCH, BLOCKING);
+      len = n;
+    }
+    else {
+      /* decode the message in place in the receive buffer */
+      len = net_recv_view(sockfd, &msg, BLOCKING);
+      n = 1;
+      msgv[0].buf = msg;
+      msgv[0].len = len;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    tm.tv_sec  = now.tv_sec;
+    tm.tv_usec = now.tv_nsec / 1000;
 
     if (len < 0) {
       (void) fprintf(stderr, "tstcli: net_recv() error: %s, errno=%d\n",
@@ -120,21 +322,586 @@ int process_tlm (int sockfd)
       return len;
     }
     else if (len == NEOF) {
+      if (net_getmsginfo(sockfd, &info) == SUCCESS && info.nmsgs > 0)
+        (void) printf("tstcli: %u messages, %u gaps (%u lost), %u reordered\n",
+                      info.nmsgs, info.ngaps, info.nlost, info.nreordered);
       (void) printf("tstcli: Ending connection...\n");
       more = false;
     }
+    else if (!batch && ((MsgHdr *) msg)->msgId == CLK_TYPE) {
+      if (len == sizeof (ClkMsg))
+        clk_reply(sockfd, (ClkMsg *) msg, &now);
+    }
+    else if (!batch && net_getmsginfo(sockfd, &info) == SUCCESS &&
+                       info.version == NET_HDR_V2) {
+      /* v2 header: latency and sequence number from the net layer */
+      report_hdr(&info);
+    }
     else {
-      if (debug) {
-        NET_TIMESTAMP("%3d tstcli: Received %d bytes.\n", (pkt++%50)+1, len);
-      }
-      else {
-        timersub(&tm, &(((DataHdr *)buff)->time), &lat);
-        (void) fprintf(stderr, " %02ld.%06ld %3d\n",
-                               lat.tv_sec, lat.tv_usec, (pkt++%50)+1);
-      }
+      for (i = 0; i < n; i++)
+        if (((MsgHdr *) msgv[i].buf)->msgId != CLK_TYPE)
+          report_tlm(msgv[i].buf, msgv[i].len, &tm);
+        else if (msgv[i].len == sizeof (ClkMsg))
+          clk_reply(sockfd, (ClkMsg *) msgv[i].buf, &now);
     }
+
+    if (!batch)
+      (void) net_release(sockfd);
+
+    if (more)
+      clk_poll(sockfd, &now);
   }  /* while(more) */
 
   return 0;
 }
 
+
+int process_udp (int sockfd)
+{
+  int  n, i;
+  static char buff[MAXBATCH][NET_MAX_UDP_LEN];
+  net_udpmsg  msgv[MAXBATCH];
+  struct timeval tm;
+
+  for (i = 0; i < MAXBATCH; i++) {
+    msgv[i].buf    = buff[i];
+    msgv[i].maxlen = sizeof buff[i];
+  }
+  if (rt_spec != NULL)
+    rt_prefault(buff, sizeof buff);
+
+  while (1) {
+    /* drain every datagram already queued with one system call */
+    n = net_udp_recvmmsg(sockfd, msgv, MAXBATCH, BLOCKING);
+
+    gettimeofday(&tm, NULL);
+
+    if (n < 0) {
+      (void) fprintf(stderr, "tstcli: net_udp_recvmmsg() error: %s, errno=%d\n",
+                              NET_ERRSTR(n), errno);
+      return n;
+    }
+    else if (stopped)     /* shut down by on_signal() */
+      break;
+
+    for (i = 0; i < n; i++)
+      report_tlm(msgv[i].buf, msgv[i].len, &tm);
+  }
+
+  return 0;
+}
+
+
+void report_tlm(char *buff, int len, struct timeval *tm)
+{
+  struct timeval lat;
+  static int pkt = 0;
+
+  long lat_ns;
+
+  timersub(tm, &(((DataHdr *)buff)->time), &lat);
+  lat_ns = lat.tv_sec * 1000000000L + lat.tv_usec * 1000L + clk_corr(tm);
+  record_lat(lat_ns, tm);
+
+  if (debug)
+    (void) fprintf(stderr, " %02ld.%06ld %3d %d\n", lat_ns / 1000000000L,
+                           (lat_ns / 1000L) % 1000000L, (pkt++%50)+1, len);
+}
+
+
+void report_hdr(net_msginfo *info)
+{
+  static int pkt = 0;
+  struct timeval tm;
+  long lat_ns, wire, user, corr;
+
+  tm.tv_sec  = info->recvd.tv_sec;
+  tm.tv_usec = info->recvd.tv_nsec / 1000;
+  corr = clk_corr(&tm);
+  lat_ns = info->latency_ns + corr;
+  record_lat(lat_ns, &tm);
+
+  if (info->rxstamp.tv_sec != 0) {
+    /* sender's user space to our kernel, and our kernel to user space */
+    wire = (info->rxstamp.tv_sec - info->sent.tv_sec) * 1000000000L +
+           (info->rxstamp.tv_nsec - info->sent.tv_nsec) + corr;
+    user = (info->recvd.tv_sec - info->rxstamp.tv_sec) * 1000000000L +
+           (info->recvd.tv_nsec - info->rxstamp.tv_nsec);
+    if (clk_period == 0 || clk.nhist > 0) {
+      histo_add(&wire_run, wire);
+      histo_add(&user_run, user);
+    }
+
+    if (debug)
+      (void) fprintf(stderr, " %02ld.%06ld %3d %u  tx-krx %ld ns  krx-rx %ld ns\n",
+                             lat_ns / 1000000000L, (lat_ns / 1000L) % 1000000L,
+                             (pkt++%50)+1, info->seq_no, wire, user);
+  }
+  else if (debug) {
+    (void) fprintf(stderr, " %02ld.%06ld %3d %u\n",
+                           lat_ns / 1000000000L, (lat_ns / 1000L) % 1000000L,
+                           (pkt++%50)+1, info->seq_no);
+  }
+}
+
+
+/*
+ *  Record the latency of a message received at tm, and summarize the
+ *  latencies every period s.  Recording is a histogram update: nothing
+ *  is printed, or allocated, per message unless -d.
+ */
+void record_lat(long lat_ns, struct timeval *tm)
+{
+  /* with -clk, the latencies are only comparable once corrected */
+  if (clk_period > 0 && clk.nhist == 0)
+    return;
+
+  histo_add(&lat_period, lat_ns);
+
+  if (next_report.tv_sec == 0)
+    next_report.tv_sec = tm->tv_sec + period;
+  else if (tm->tv_sec >= next_report.tv_sec) {
+    report_lat(false);
+    next_report.tv_sec = tm->tv_sec + period;
+  }
+}
+
+
+/*
+ *  Print the latencies of the last period on one line, and add them to
+ *  those of the run; at the end, print the run's, and write their whole
+ *  distribution to the -o file, or to stdout.
+ */
+void report_lat(bool final)
+{
+  struct timespec now;
+  long uncert = clkest_uncert(&clk);
+  FILE *fp;
+
+  if (lat_period.count > 0) {
+    (void) printf("tstcli: %lu msgs, latency p50/p90/p99/p99.9/max "
+                  "%ld/%ld/%ld/%ld/%ld us", lat_period.count,
+                  histo_pct(&lat_period, 50) / 1000,
+                  histo_pct(&lat_period, 90) / 1000,
+                  histo_pct(&lat_period, 99) / 1000,
+                  histo_pct(&lat_period, 99.9) / 1000,
+                  lat_period.max / 1000);
+    if (uncert >= 0) {
+      clock_gettime(CLOCK_REALTIME, &now);
+      (void) printf(", clock %+ld +/- %ld us%s",
+                    clkest_offset(&clk, &now) / 1000, uncert / 1000,
+                    (uncert > histo_pct(&lat_period, 50)) ? " (UNCERTAIN)" : "");
+    }
+    (void) printf("\n");
+    histo_merge(&lat_run, &lat_period);
+    histo_reset(&lat_period);
+  }
+  (void) fflush(stdout);
+
+  if (!final)
+    return;
+
+  histo_print(stdout, "tstcli: Latency", &lat_run, 1000, "us");
+  if (wire_run.count > 0) {
+    histo_print(stdout, "tstcli: Sender to kernel rx", &wire_run, 1000, "us");
+    histo_print(stdout, "tstcli: Kernel rx to receiver", &user_run, 1000, "us");
+  }
+  if (uncert >= 0) {
+    clock_gettime(CLOCK_REALTIME, &now);
+    (void) printf("tstcli: Server clock %+ld us +/- %ld us, drift %.3f ppm "
+                  "(%lu probes, best of %d per burst)\n",
+                  clkest_offset(&clk, &now) / 1000, uncert / 1000,
+                  clk.drift / 1000.0, clk.nprobes, CLK_PROBES);
+    if (uncert > histo_pct(&lat_run, 50))
+      (void) printf("tstcli: Warning: the clock offset is uncertain by more "
+                    "than the median latency, %ld us.\n",
+                    histo_pct(&lat_run, 50) / 1000);
+  }
+  else if (clk_period > 0)
+    (void) printf("tstcli: Warning: no clock probe answered; no latency "
+                  "recorded.\n");
+  (void) printf("tstcli: Profile %s.\n", rt_desc);
+
+  if (dump_path == NULL)
+    fp = stdout;
+  else if ((fp = fopen(dump_path, "w")) == NULL) {
+    (void) fprintf(stderr, "tstcli: %s: %s\n", dump_path, strerror(errno));
+    return;
+  }
+  histo_dump(fp, "tstcli: Latency", &lat_run, 1000, "us");
+  if (fp != stdout)
+    (void) fclose(fp);
+  (void) fflush(stdout);
+}
+
+
+/*
+ *  End the run: wake the receive blocked on the data socket, which then
+ *  returns end of file.
+ */
+void on_signal(int sig)
+{
+  int i;
+
+  (void) sig;
+  stopped = 1;
+  (void) shutdown(data_fd, SHUT_RD);
+  for (i = 0; i < agg_nseg; i++)
+    (void) shutdown(agg_fd[i], SHUT_RD);
+}
+
+
+/*
+ *  Connect to every segment server of spec: "endpt[first..last]", an
+ *  endpoint range, or a file listing one "endpt [host]" per line.  Then
+ *  assemble their SegRtDataMsgs into one frame per tick, and report the
+ *  time until the last segment of each frame arrives.
+ */
+int process_agg(char *spec, char *hostname)
+{
+  char base[64], endpt[80], host[64], line[256];
+  int  first, last, len, i, n;
+  FILE *fp;
+
+  for (i = 0; i < AGG_WINDOW; i++)
+    agg_win[i].key = -1;
+
+  if (sscanf(spec, "%63[^[][%d..%d]%n", base, &first, &last, &len) == 3 &&
+      spec[len] == '\0') {
+    if (first < 0 || last < first || last - first >= MAXSEGS) {
+      (void) fprintf(stderr, "tstcli: -agg takes up to %d servers.\n", MAXSEGS);
+      return 1;
+    }
+    for (i = first; i <= last; i++) {
+      (void) snprintf(endpt, sizeof endpt, "%s[%d]", base, i);
+      if (agg_connect(endpt, hostname) < 0)
+        return 1;
+    }
+  }
+  else if ((fp = fopen(spec, "r")) != NULL) {
+    while (fgets(line, sizeof line, fp) != NULL) {
+      if ((n = sscanf(line, "%79s %63s", endpt, host)) < 1 || endpt[0] == '#')
+        continue;
+      if (agg_nseg == MAXSEGS) {
+        (void) fprintf(stderr, "tstcli: -agg takes up to %d servers.\n", MAXSEGS);
+        return 1;
+      }
+      if (agg_connect(endpt, (n == 2) ? host : hostname) < 0)
+        return 1;
+    }
+    (void) fclose(fp);
+  }
+  else {
+    (void) fprintf(stderr, "tstcli: -agg %s: %s\n", spec, strerror(errno));
+    return 1;
+  }
+
+  if (agg_nseg == 0) {
+    (void) fprintf(stderr, "tstcli: -agg %s: no servers.\n", spec);
+    return 1;
+  }
+  (void) printf("tstcli: Connected to %d segment servers, frames keyed by %s...\n",
+                agg_nseg, frame_key ? "frameCount" : "time tag");
+
+  if ((agg_ev = net_evloop_create()) == NULL) {
+    perror("tstcli: net_evloop_create");
+    return 1;
+  }
+  for (i = 0; i < agg_nseg; i++)
+    (void) net_evloop_add(agg_ev, agg_fd[i], NET_EV_IN, on_segment,
+                          (void *) (long) i);
+
+  (void) signal(SIGINT, on_signal);
+  (void) signal(SIGTERM, on_signal);
+
+  if (net_evloop_run(agg_ev) < 0) {
+    perror("tstcli: net_evloop_run");
+    return 1;
+  }
+  net_evloop_destroy(agg_ev);
+
+  /* the frames still being assembled are incomplete only if a later
+     one is complete: the run may have ended in their middle */
+
+  for (i = 0; i < AGG_WINDOW; i++)
+    if (agg_win[i].key >= 0 && agg_win[i].key < agg_maxkey)
+      agg_close(&agg_win[i]);
+
+  report_agg(true);
+  return 0;
+}
+
+
+int agg_connect(char *endpt, char *hostname)
+{
+  int fd;
+
+  if ((fd = net_connect(endpt, hostname, ANY_TASK, BLOCKING)) < 0) {
+    (void) fprintf(stderr, "tstcli: net_connect(%s, %s) error: %s: %s\n",
+                           endpt, hostname, NET_ERRSTR(fd), strerror(errno));
+    return fd;
+  }
+  agg_fd[agg_nseg++] = fd;
+  agg_open++;
+  return fd;
+}
+
+
+/*
+ *  Take all the messages a segment server sent, without blocking.
+ */
+void on_segment(net_evloop *ev, int fd, int events, void *arg)
+{
+  int  seg = (int) (long) arg;
+  struct timeval tm;
+  char *msg;
+  int  len;
+
+  while ((len = net_recv_view(fd, &msg, NON_BLOCKING)) > 0) {
+    gettimeofday(&tm, NULL);
+    if (len >= sizeof (SegRtDataMsg) &&
+        ((DataHdr *) msg)->hdr.msgId == SEG_REALTIME_DATA)
+      agg_add(seg, (SegRtDataMsg *) msg, &tm);
+    (void) net_release(fd);
+  }
+
+  if (len != NWOULDBLOCK) {
+    if (len != NEOF)
+      (void) fprintf(stderr, "tstcli: net_recv_view() error: %s, errno=%d\n",
+                             NET_ERRSTR(len), errno);
+    else if (!stopped)
+      (void) fprintf(stderr, "tstcli: Segment server %d closed the connection.\n",
+                             seg);
+    (void) net_evloop_del(ev, fd);
+    (void) net_close(fd);
+    agg_fd[seg] = ERROR;
+    if (--agg_open == 0)
+      net_evloop_stop(ev);
+  }
+}
+
+
+/*
+ *  Add segment seg's message, received at tm, to the frame of its tick.
+ *  A frame is complete once every server's message is in; it is counted
+ *  incomplete if its slot is needed for a tick AGG_WINDOW later first.
+ */
+void agg_add(int seg, SegRtDataMsg *msg, struct timeval *tm)
+{
+  struct timeval tag = msg->hdr.time;
+  agg_frame *f;
+  long key, d, ticks;
+
+  if (frame_key) {
+    /* frame counts wrap every second (ticks of SMPL_PER_MSG frames): the
+       tick nearest the latest one */
+    ticks = SEGSIM_FRAMES / SMPL_PER_MSG;
+    key = msg->data[0].sensor[0].bitFields.frameCount / SMPL_PER_MSG;
+    if (agg_maxkey >= 0) {
+      d = ((key - agg_maxkey) % ticks + ticks) % ticks;
+      key = agg_maxkey + ((d >= ticks / 2) ? d - ticks : d);
+    }
+  }
+  else
+    key = (tag.tv_sec * 1000000L + tag.tv_usec) / (1000000L / rate);
+
+  if (key < 0 || key <= agg_maxkey - AGG_WINDOW) {
+    agg_late++;             /* its frame is closed */
+    return;
+  }
+
+  f = &agg_win[key % AGG_WINDOW];
+  if (f->key != key) {
+    agg_close(f);
+    f->key   = key;
+    f->nseg  = 0;
+    f->tag   = tag;
+    f->first = *tm;
+    (void) memset(f->got, 0, agg_nseg);
+  }
+  if (key > agg_maxkey)
+    agg_maxkey = key;
+
+  if (f->got[seg])          /* already in: a late tick's message */
+    return;
+  f->got[seg] = 1;
+  if (timercmp(&tag, &f->tag, <))
+    f->tag = tag;
+
+  if (debug)
+    (void) fprintf(stderr, " %ld %3d %d/%d\n", key, seg, f->nseg + 1, agg_nseg);
+
+  if (++f->nseg == agg_nseg) {
+    histo_add(&tolast_period, (tm->tv_sec - f->tag.tv_sec) * 1000000000L +
+                              (tm->tv_usec - f->tag.tv_usec) * 1000L);
+    histo_add(&spread_run, (tm->tv_sec - f->first.tv_sec) * 1000000000L +
+                           (tm->tv_usec - f->first.tv_usec) * 1000L);
+    agg_frames++;
+
+    if (next_report.tv_sec == 0)
+      next_report.tv_sec = tm->tv_sec + period;
+    else if (tm->tv_sec >= next_report.tv_sec) {
+      report_agg(false);
+      next_report.tv_sec = tm->tv_sec + period;
+    }
+  }
+}
+
+
+/*
+ *  Retire a frame, counting it if incomplete.
+ */
+void agg_close(agg_frame *f)
+{
+  if (f->key >= 0 && f->nseg < agg_nseg) {
+    agg_incomplete++;
+    agg_missing += agg_nseg - f->nseg;
+  }
+  f->key = -1;
+}
+
+
+/*
+ *  Print the frames of the last period on one line; at the end, print the
+ *  run's, and write the distribution of the time to the last segment to
+ *  the -o file, or to stdout.
+ */
+void report_agg(bool final)
+{
+  FILE *fp;
+
+  if (tolast_period.count > 0 || agg_incomplete > agg_last[1]) {
+    (void) printf("tstcli: %lu frames, %lu incomplete (%lu segments missing), "
+                  "%lu late; to last segment p50/p90/p99/p99.9/max "
+                  "%ld/%ld/%ld/%ld/%ld us\n", agg_frames - agg_last[0],
+                  agg_incomplete - agg_last[1], agg_missing - agg_last[2],
+                  agg_late, histo_pct(&tolast_period, 50) / 1000,
+                  histo_pct(&tolast_period, 90) / 1000,
+                  histo_pct(&tolast_period, 99) / 1000,
+                  histo_pct(&tolast_period, 99.9) / 1000,
+                  tolast_period.max / 1000);
+    histo_merge(&tolast_run, &tolast_period);
+    histo_reset(&tolast_period);
+    agg_last[0] = agg_frames;
+    agg_last[1] = agg_incomplete;
+    agg_last[2] = agg_missing;
+  }
+  (void) fflush(stdout);
+
+  if (!final)
+    return;
+
+  (void) printf("tstcli: %d segments: %lu frames complete, %lu incomplete "
+                "(%lu segments missing), %lu segments too late\n", agg_nseg,
+                agg_frames, agg_incomplete, agg_missing, agg_late);
+  histo_print(stdout, "tstcli: Tick to last segment", &tolast_run, 1000, "us");
+  histo_print(stdout, "tstcli: First to last segment", &spread_run, 1000, "us");
+  (void) printf("tstcli: Profile %s.\n", rt_desc);
+
+  if (dump_path == NULL)
+    fp = stdout;
+  else if ((fp = fopen(dump_path, "w")) == NULL) {
+    (void) fprintf(stderr, "tstcli: %s: %s\n", dump_path, strerror(errno));
+    return;
+  }
+  histo_dump(fp, "tstcli: Tick to last segment", &tolast_run, 1000, "us");
+  if (fp != stdout)
+    (void) fclose(fp);
+  (void) fflush(stdout);
+}
+
+
+/*
+ *  Request a burst of clock probes: on SIGUSR1.
+ */
+void on_clkreq(int sig)
+{
+  (void) sig;
+  clk_req = 1;
+}
+
+
+/*
+ *  Start a burst of clock probes when one is due; give up on a probe not
+ *  answered within a second, e.g. by a server that does not echo them.
+ */
+void clk_poll(int sockfd, struct timespec *now)
+{
+  if (clk_wait) {
+    if (now->tv_sec - clk_sent.tv_sec > 1) {
+      (void) fprintf(stderr, "tstcli: Clock probe not answered.\n");
+      clk_wait = false;
+      clk.nburst = 0;
+      clk_next = now->tv_sec + (clk_period ? clk_period : 1);
+    }
+  }
+  else if (clk_req || (clk_period > 0 && now->tv_sec >= clk_next)) {
+    clk_req = 0;
+    clk_send(sockfd);
+  }
+}
+
+
+/*
+ *  Send a clock probe, time-tagged last.
+ */
+void clk_send(int sockfd)
+{
+  ClkMsg probe;
+  int    status;
+
+  (void) memset(&probe, 0, sizeof probe);
+  probe.hdr.msgId = CLK_TYPE;
+  probe.hdr.srcId = ANY_TASK;
+  clock_gettime(CLOCK_REALTIME, &clk_sent);
+  probe.t1 = clk_sent;
+
+  if ((status = net_send(sockfd, (char *) &probe, sizeof probe, BLOCKING)) <= 0) {
+    (void) fprintf(stderr, "tstcli: net_send() error: %s\n", NET_ERRSTR(status));
+    clk_period = 0;
+    return;
+  }
+  clk_wait = true;
+}
+
+
+/*
+ *  Take the server's echo of the probe, received at now; send the next
+ *  probe of the burst, ping-pong, or end the burst.
+ */
+void clk_reply(int sockfd, ClkMsg *msg, struct timespec *now)
+{
+  struct timespec t1 = msg->t1, t2 = msg->t2, t3 = msg->t3;
+
+  if (!clk_wait || t1.tv_sec != clk_sent.tv_sec || t1.tv_nsec != clk_sent.tv_nsec)
+    return;
+  clk_wait = false;
+
+  clkest_probe(&clk, &t1, &t2, &t3, now);
+
+  if (clk.nburst < CLK_PROBES) {
+    clk_send(sockfd);
+    return;
+  }
+  (void) clkest_burst_end(&clk);
+  clk_next = now->tv_sec + clk_period;
+
+  if (debug)
+    (void) fprintf(stderr, "tstcli: Server clock %+ld ns +/- %ld ns, "
+                           "drift %.3f ppm.\n", clkest_offset(&clk, now),
+                           clkest_uncert(&clk), clk.drift / 1000.0);
+}
+
+
+/*
+ *  The correction of a latency measured at tm from a server's time tag:
+ *  the server clock's offset then, or 0 before any was measured.
+ */
+long clk_corr(struct timeval *tm)
+{
+  struct timespec t;
+
+  t.tv_sec  = tm->tv_sec;
+  t.tv_nsec = tm->tv_usec * 1000;
+  return clkest_offset(&clk, &t);
+}
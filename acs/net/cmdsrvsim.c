@@ -23,30 +23,46 @@
 #include <unistd.h>
 #include <errno.h>
 #include <netdb.h>
+#include <stdint.h>
 
 #include "net_glc.h"
 #include "GlcMsg.h"
+#include "rtprof.h"
 
 #define MAXCLIENTS	20
 #define MAXMSGLEN	1024
 
 int listenfd = ERROR;
 int cli_fd[MAXCLIENTS];
+net_evloop *ev;				// dispatches ready descriptors
 
 
-void event_loop ();
+void on_accept (net_evloop *ev, int fd, int events, void *arg);
+void on_client (net_evloop *ev, int fd, int events, void *arg);
+void close_client (int indx);
 int  process_msg (int sockfd);
 
 
 int main (int argc, char **argv)
 {
-    char server[128] = LSEB_CMD_SRV;
+    char server[128] = LSCS_CMD_SRV;
+    char *rt_spec = NULL;
+    char rt_desc[RT_DESC_LEN];
     int  i;
 
     for (i = 1; i < argc; i++) {
 	if (!strcmp (argv[i], "-s"))
 	    (void) strncpy (server, argv[++i], sizeof server);
+
+	else if (!strcmp (argv[i], "-rt") && i + 1 < argc)
+	    rt_spec = argv[++i];
+    }
+
+    if (rt_profile (rt_spec, rt_desc, sizeof rt_desc) < 0) {
+	(void)fprintf (stderr, "cmdsrvsim: -rt takes prio[@cpus], e.g. 80@2.\n");
+	exit (1);
     }
+    printf ("cmdsrvsim: Profile %s.\n", rt_desc);
 
     for (i = 0; i < MAXCLIENTS; i++)
     	cli_fd[i] = ERROR;
@@ -61,9 +77,19 @@ int main (int argc, char **argv)
     else
         printf ("cmdsrvsim: Listening on socket %d...\n", listenfd);
 
+    if ((ev = net_evloop_create ()) == NULL) {
+	perror ("cmdsrvsim: net_evloop_create");
+	exit (1);
+    }
+    (void) net_evloop_add (ev, listenfd, NET_EV_IN, on_accept, NULL);
+
     /* Main event loop */
 
-    event_loop ();
+    if (net_evloop_run (ev) < 0) {
+	perror ("cmdsrvsim: net_evloop_run");
+	exit (-1);
+    }
+    net_evloop_destroy (ev);
 
     if (listenfd != ERROR)
         net_close (listenfd);
@@ -76,98 +102,95 @@ int main (int argc, char **argv)
 }
 
 
-void event_loop ()
+/*
+ *  Accept every pending connection: the listener only signals new ones.
+ */
+void on_accept (net_evloop *ev, int fd, int events, void *arg)
 {
-    fd_set read_fds;       /* file descriptors to be polled */
-    int  nfds;
-    int  sockfd;
-    int  i;
-
-    while (1) {
-
-        FD_ZERO (&read_fds);
-        FD_SET (listenfd, &read_fds);
-
-	for (i = 0; i < MAXCLIENTS; i++)
-	    if (cli_fd[i] != ERROR) FD_SET (cli_fd[i], &read_fds);
-
-        nfds = select (FD_SETSIZE, &read_fds, (fd_set *) 0, (fd_set *) 0,
-                       (struct timeval *) 0);
-        if (nfds <= 0)  {
-            if (errno == EINTR)  {
-                continue;
-            }
-            // error on select
-            (void)fprintf (stderr, "cmdsrvsim: select() error: %s.", strerror (errno));
-            exit (-1);
-        }
-        else {
-            if (FD_ISSET (listenfd, &read_fds)) {
-
-		/* accept new client connection */
-		if ((sockfd = net_accept (listenfd, BLOCKING)) < 0) {
-		    (void)fprintf (stderr, "cmdsrvsim: net_accept() error: %s, errno=%d\n",
-					    NET_ERRSTR(sockfd), errno);
-		    net_close (listenfd);
-		    exit (sockfd);
-		}
-		(void)printf ("cmdsrvsim: Connection accepted...\n");
-
-		int n = 0;
-
-		while (n < MAXCLIENTS && cli_fd[n] != ERROR)
-		    n++;
-
-		if (n < MAXCLIENTS)
-		    cli_fd[n] = sockfd;
-		else {
-		    (void)fprintf (stderr, "cmdsrvsim: Max client connections exceeded.\n");
-		    net_close (sockfd);
-		}
-
-                if (--nfds <= 0)
-                    continue;
-            }
-
-	    for (i = 0; i < MAXCLIENTS; i++)
-		if (cli_fd[i] != ERROR && FD_ISSET (cli_fd[i], &read_fds)) {
-
-		    /* service client's request */
-		    (void) process_msg (i);
-		    if (--nfds <= 0)
-			break;
-		}
-        }
+    int sockfd, n;
+
+    while ((sockfd = net_accept (listenfd, NON_BLOCKING)) != NWOULDBLOCK) {
+
+	if (sockfd < 0) {
+	    (void)fprintf (stderr, "cmdsrvsim: net_accept() error: %s, errno=%d\n",
+				    NET_ERRSTR(sockfd), errno);
+	    if (errno == EMFILE || errno == ENFILE)
+		return;
+	    net_close (listenfd);
+	    exit (sockfd);
+	}
+	(void)printf ("cmdsrvsim: Connection accepted...\n");
+
+	n = 0;
+
+	while (n < MAXCLIENTS && cli_fd[n] != ERROR)
+	    n++;
+
+	if (n < MAXCLIENTS) {
+	    cli_fd[n] = sockfd;
+	    (void) net_evloop_add (ev, sockfd, NET_EV_IN, on_client,
+				   (void *) (intptr_t) n);
+	}
+	else {
+	    (void)fprintf (stderr, "cmdsrvsim: Max client connections exceeded.\n");
+	    net_close (sockfd);
+	}
     }
 }
 
 
+void on_client (net_evloop *ev, int fd, int events, void *arg)
+{
+    /* service every request received */
+
+    while (process_msg ((int) (intptr_t) arg) > 0)
+	;
+}
+
+
+void close_client (int indx)
+{
+    (void) net_evloop_del (ev, cli_fd[indx]);
+    net_close (cli_fd[indx]);
+    cli_fd[indx] = ERROR;
+}
+
+
 int process_msg (int indx)
 {
     char msg[MAXMSGLEN];
     int  len;
+    net_msginfo info;
 
-    int  send_rsp (int sockfd, char *cmdstr, int csn);
+    int  send_rsp (int sockfd, char *cmdstr, unsigned csn);
 
     (void) memset (msg, 0, sizeof msg);
 
-    if ((len = net_recv (cli_fd[indx], msg, MAXMSGLEN, BLOCKING)) < 0) {
+    /* a partial request is kept by net_recv() until the rest arrives */
+
+    if ((len = net_recv (cli_fd[indx], msg, MAXMSGLEN, NON_BLOCKING)) == NWOULDBLOCK)
+	return len;
+
+    else if (len < 0) {
 	(void)fprintf (stderr, "cmdsrvsim: net_recv() error: %s, errno=%d\n",
 				NET_ERRSTR(len), errno);
+	close_client (indx);
 	return len;
     }
     else if (len == NEOF) {
 	(void)printf ("cmdsrvsim: Closing broken connection...\n");
-	net_close (cli_fd[indx]);
-	cli_fd[indx] = ERROR;
+	close_client (indx);
 	return len;
     }
 
     if (((MsgHdr *) msg)->msgId == CMD_TYPE) {
 
+	/* the command sequence number is carried by the net header */
+	(void) net_getmsginfo (cli_fd[indx], &info);
+
 	((CmdMsg *) msg)->cmd[MAX_CMD_LEN - 1] = '\0';
-    	(void)printf ("%s\n", ((CmdMsg *) msg)->cmd);
-	send_rsp (cli_fd[indx], ((CmdMsg *) msg)->cmd, ((CmdMsg *) msg)->hdr.seqNo);
+    	(void)printf ("%u: %s\n", info.seq_no, ((CmdMsg *) msg)->cmd);
+	send_rsp (cli_fd[indx], ((CmdMsg *) msg)->cmd, info.seq_no);
     }
     else
     	(void)fprintf (stderr, "cmdsrvsim: Invalid message received.\n");
@@ -176,16 +199,16 @@ int process_msg (int indx)
 }
 
 
-int send_rsp (int sockfd, char *cmdstr, int csn)
+int send_rsp (int sockfd, char *cmdstr, unsigned csn)
 {
     char	cmd[MAX_CMD_LEN] = "\0";
     int		status;
     RspMsg	rsp_msg;
 
     rsp_msg.hdr.msgId = RSP_TYPE;
-    rsp_msg.hdr.seqNo = csn;
+    rsp_msg.hdr.srcId = 0;
     (void) sscanf (cmdstr, "%80s", cmd);
-    (void) sprintf (rsp_msg.rsp, "%s: Completed.", cmd);
+    (void) sprintf (rsp_msg.rsp, "%s: Completed (%u).", cmd, csn);
 
     if ((status = net_send (sockfd, (char *) &rsp_msg, sizeof rsp_msg, BLOCKING)) <= 0)
         (void)fprintf (stderr, "cmdsrvsim: net_send() error: %s, errno=%d\n",
@@ -20,8 +20,21 @@
  *	endpoint names, and the array of port numbers that are bound to by
  *	a client.
  *
+ *	The endpoints looked up are those of a registry, hashed by name:
+ *	the built-in list, then the entries of the file named by the
+ *	NET_ENDPTS_FILE environment variable, of the NET_ENDPTS variable,
+ *	and of files loaded by net_loadendpts().  An entry can name a range
+ *	of endpoints, e.g. "lscs_data[0..491]", registered and looked up at
+ *	the cost of a single one.
+ *
  *--------------------------------------------------------------------------*/
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
 #include "net_appl.h"
 #include "net.h"
 
@@ -55,7 +68,18 @@ endpt_entry net_endpt[] = {
     {APP_SRV19,  TCP,    SRV19_TASK,  8022},
     {APP_SRV20,  TCP,    SRV20_TASK,  8023},
 
-    {ANT_BRDCST, BRDCST, 0,	      8101}
+    {APP_UDP1,   UDP,    SRV19_TASK,  8201},
+    {APP_UDP2,   UDP,    SRV20_TASK,  8202},
+
+/*  endpoint     type    server       port  group */
+
+    {APP_MCAST1, MCAST,  SRV19_TASK,  8301, "239.192.0.1"},
+
+    {ANT_BRDCST, BRDCST, 0,	      8101},
+
+/*  endpoint     type    server       port  group  range */
+
+    {APP_SRVS,   TCP,    SRV19_TASK, 10000, NULL,  0,     APP_SRVS_MAX}
 };
 
 /* port numbers bound to by a client, so that a listener can
@@ -67,3 +91,396 @@ int net_port[] = {
     9010, 9011, 9012, 9013, 9014, 9015, 9016, 9017, 9018, 9019,
     9020, 9021, 9022, 9023
 };
+
+/* endpoint registry */
+
+static endpt_entry *net_reg;		/* registered entries */
+static int net_nreg;			/* number of entries */
+static int net_maxreg;			/* entries allocated */
+static int *net_hash;			/* open-addressed table of entry
+					   indices + 1, 0 when free */
+static int net_hsize;			/* its size, a power of two at least
+					   twice the number of entries */
+static pthread_once_t net_reg_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t net_reg_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void net_reg_init ();
+static int net_reg_add ();
+static int net_reg_slot ();
+static int net_reg_parse ();
+static int net_reg_load ();
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_loadendpts (path)
+*
+* Description:
+*	net_loadendpts() adds the endpoints listed in file path to the
+*	registry that endpoint names are looked up in, e.g. by net_init()
+*	and net_connect().  An entry replaces any earlier one of the same
+*	name and type, built-in entries included.
+*
+*	Each line of the file, blank lines and "#" comments aside, reads
+*
+*		name  type  pname  port  [group]
+*
+*	where type is tcp, udp, mcast or brdcst, pname is the server's
+*	process name (task number), and group is the address of an mcast
+*	endpoint.  A name of the form "base[first..last]" registers the
+*	endpoints base[first] to base[last], on ports port, port+1...
+*
+*	The registry first holds the built-in endpoints, then those of the
+*	file named by the NET_ENDPTS_FILE environment variable, then those
+*	of the NET_ENDPTS variable, in the same format with ";" between
+*	entries.  They are loaded on the first lookup or net_loadendpts()
+*	call.
+*
+* Return Values:
+*	On success, net_loadendpts() returns the number of entries added.
+*
+*	On failure, it returns:
+*
+*	NBADADDR	when path is not a valid pointer.
+*
+*	NBADENDPT	when a line of the file is not a valid entry; the
+*			entries above it are added.
+*
+*	ERROR		on a system call error, with errno containing the
+*			error indication.
+*
+* Environment Access:
+*	NET_ENDPTS_FILE and NET_ENDPTS, as above.
+*
+* Performance:
+*	A lookup hashes the name once, however many endpoints there are;
+*	a range costs the same as a single endpoint.
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	Endpoints are best loaded before connections are opened; lookups
+*	made meanwhile from other threads are safe but may miss them.
+*
+*************************************************************************** */
+#endif
+
+int net_loadendpts (path)
+char *path;				/* endpoint file */
+{
+    FILE *fp;				/* endpoint file stream */
+    int status;				/* entries added, or error */
+
+    if (path == NULL)
+	return NBADADDR;
+
+    (void) pthread_once (&net_reg_once, net_reg_init);
+
+    if ((fp = fopen (path, "r")) == NULL)
+	return ERROR;
+
+    pthread_mutex_lock (&net_reg_lock);
+    status = net_reg_load (fp, NULL);
+    pthread_mutex_unlock (&net_reg_lock);
+
+    (void) fclose (fp);
+    return status;
+}
+
+/* ***************************************************************************
+*
+* net_getendpt() copies into entry the registered endpoint of the given
+* type named endpt: a single endpoint, or "base[i]" of a range, with its
+* own port.  It returns SUCCESS, or NBADENDPT when there is none.
+*
+*************************************************************************** */
+
+int net_getendpt (endpt, type, entry)
+char *endpt;				/* endpoint name */
+endpt_type type;			/* endpoint type */
+endpt_entry *entry;			/* returned endpoint entry */
+{
+    int len = strlen (endpt);		/* length of the name looked up */
+    long indx = -1;			/* index within a range, if any */
+    char *p, *q;
+    int h;				/* hash table slot */
+
+    (void) pthread_once (&net_reg_once, net_reg_init);
+
+    /* "base[i]": look up the range */
+
+    if (len > 0 && endpt[len-1] == ']' && (p = strrchr (endpt, '[')) != NULL) {
+	indx = strtol (p + 1, &q, 10);
+	if (q == p + 1 || q != endpt + len - 1 || indx < 0)
+	    return NBADENDPT;
+	len = p - endpt;
+    }
+
+    pthread_mutex_lock (&net_reg_lock);
+
+    if (net_hsize == 0 || net_hash[h = net_reg_slot (endpt, len, type)] == 0) {
+	pthread_mutex_unlock (&net_reg_lock);
+	return NBADENDPT;
+    }
+    *entry = net_reg[net_hash[h] - 1];
+
+    pthread_mutex_unlock (&net_reg_lock);
+
+    if (indx < 0)
+	return (entry->count == 0) ? SUCCESS : NBADENDPT;
+
+    if (entry->count == 0 || indx < entry->first ||
+			     indx >= entry->first + entry->count)
+	return NBADENDPT;
+
+    entry->port += indx - entry->first;
+    entry->first = indx;
+    entry->count = 1;
+    return SUCCESS;
+}
+
+/* ***************************************************************************
+*
+* net_getendptport() returns the process name of the server whose endpoint
+* is on port, or NBADPROCESS if none is.
+*
+*************************************************************************** */
+
+int net_getendptport (port)
+int port;				/* endpoint port number */
+{
+    int pname = NBADPROCESS;		/* server's process name */
+    int i;
+
+    (void) pthread_once (&net_reg_once, net_reg_init);
+
+    pthread_mutex_lock (&net_reg_lock);
+    for (i = 0; i < net_nreg; i++)
+	if (port >= net_reg[i].port &&
+	    port < net_reg[i].port + (net_reg[i].count ? net_reg[i].count : 1)) {
+	    pname = net_reg[i].pname;
+	    break;
+	}
+    pthread_mutex_unlock (&net_reg_lock);
+
+    return pname;
+}
+
+/* ***************************************************************************
+*
+* net_reg_init() registers the built-in endpoints, then those of the
+* environment.  Errors in the environment are reported on stderr, as no
+* caller is there to return them to.
+*
+*************************************************************************** */
+
+static void net_reg_init ()
+{
+    char *path, *list;			/* environment's entries */
+    FILE *fp;
+    int i;
+
+    for (i = 0; i < sizeof (net_endpt) / sizeof (net_endpt[0]); i++)
+	(void) net_reg_add (&net_endpt[i]);
+
+    if ((path = getenv ("NET_ENDPTS_FILE")) != NULL) {
+	if ((fp = fopen (path, "r")) == NULL)
+	    (void) fprintf (stderr, "net: NET_ENDPTS_FILE %s: %s\n", path,
+			    strerror (errno));
+	else {
+	    if (net_reg_load (fp, NULL) < 0)
+		(void) fprintf (stderr, "net: NET_ENDPTS_FILE %s: invalid entry\n",
+				path);
+	    (void) fclose (fp);
+	}
+    }
+
+    if ((list = getenv ("NET_ENDPTS")) != NULL && net_reg_load (NULL, list) < 0)
+	(void) fprintf (stderr, "net: NET_ENDPTS: invalid entry\n");
+}
+
+/* ***************************************************************************
+*
+* net_reg_load() registers the entries read from fp, or else listed in
+* list between ";".  It returns the number of entries added, or NBADENDPT
+* on the first invalid one, or ERROR when out of memory.
+*
+*************************************************************************** */
+
+static int net_reg_load (fp, list)
+FILE *fp;				/* endpoint file, or */
+char *list;				/* endpoint entries */
+{
+    char line[256];			/* one entry */
+    char name[128], group[64];		/* and its strings */
+    endpt_entry entry;
+    char *end;
+    int n = 0, len, status;
+
+    while (1) {
+	if (fp != NULL) {
+	    if (fgets (line, sizeof line, fp) == NULL)
+		break;
+	}
+	else {
+	    if (*list == '\0')
+		break;
+	    len = ((end = strchr (list, ';')) != NULL) ? end - list : strlen (list);
+	    if (len >= sizeof line)
+		return NBADENDPT;
+	    (void) memcpy (line, list, len);
+	    line[len] = '\0';
+	    list += (end != NULL) ? len + 1 : len;
+	}
+
+	if ((status = net_reg_parse (line, &entry, name, group)) < 0)
+	    return status;
+	if (status == 0)
+	    continue;
+
+	if (net_reg_add (&entry) < 0)
+	    return ERROR;
+	n++;
+    }
+    return n;
+}
+
+/* ***************************************************************************
+*
+* net_reg_parse() fills in entry from line "name type pname port [group]",
+* its strings in name and group.  It returns 1, 0 for a blank or comment
+* line, or NBADENDPT.
+*
+*************************************************************************** */
+
+static int net_reg_parse (line, entry, name, group)
+char *line;				/* entry's line */
+endpt_entry *entry;			/* returned entry */
+char *name;				/* its name, 128 bytes */
+char *group;				/* its group, 64 bytes */
+{
+    static char *types[] = {"", "tcp", "udp", "brdcst", "mcast"};
+    char type[16];
+    char *p;
+    int first, last, nfld, len;
+
+    if ((p = strchr (line, '#')) != NULL)
+	*p = '\0';
+
+    group[0] = '\0';
+    if ((nfld = sscanf (line, "%127s %15s %d %d %63s", name, type,
+			&entry->pname, &entry->port, group)) <= 0)
+	return 0;
+    if (nfld < 4 || entry->port <= 0 || entry->port > 65535)
+	return NBADENDPT;
+
+    for (entry->type = TCP; entry->type <= MCAST; entry->type++)
+	if (strcmp (type, types[entry->type]) == 0)
+	    break;
+    if (entry->type > MCAST || (entry->type == MCAST) != (group[0] != '\0'))
+	return NBADENDPT;
+
+    /* "base[first..last]": a range of endpoints */
+
+    entry->first = entry->count = 0;
+    if ((p = strchr (name, '[')) != NULL) {
+	if (sscanf (p, "[%d..%d]%n", &first, &last, &len) != 2 ||
+		    p[len] != '\0' || first < 0 || last < first ||
+		    entry->port + last - first > 65535)
+	    return NBADENDPT;
+	*p = '\0';
+	entry->first = first;
+	entry->count = last - first + 1;
+    }
+
+    entry->name  = name;
+    entry->group = group[0] ? group : NULL;
+    return 1;
+}
+
+/* ***************************************************************************
+*
+* net_reg_slot() returns the hash table slot of the entry of the given
+* type named by the len bytes of name, or the free slot it would take.
+*
+*************************************************************************** */
+
+static int net_reg_slot (name, len, type)
+char *name;				/* endpoint name */
+int len;				/* its length */
+endpt_type type;			/* endpoint type */
+{
+    unsigned int h = 2166136261u;	/* FNV-1a hash of the name */
+    endpt_entry *e;
+    int i;
+
+    for (i = 0; i < len; i++)
+	h = (h ^ (unsigned char) name[i]) * 16777619u;
+
+    for (h &= net_hsize - 1; net_hash[h] != 0; h = (h + 1) & (net_hsize - 1)) {
+	e = &net_reg[net_hash[h] - 1];
+	if (e->type == type && strncmp (e->name, name, len) == 0 &&
+			       e->name[len] == '\0')
+	    break;
+    }
+    return h;
+}
+
+/* ***************************************************************************
+*
+* net_reg_add() registers a copy of entry, in place of any of the same
+* name and type.  It returns SUCCESS, or ERROR when out of memory.
+*
+*************************************************************************** */
+
+static int net_reg_add (entry)
+endpt_entry *entry;			/* entry to add */
+{
+    endpt_entry e = *entry;		/* the copy */
+    endpt_entry *reg;			/* grown entries */
+    int *hash;				/* grown hash table */
+    int h, i;
+
+    /* copies live as long as the process: earlier lookups may hold them */
+
+    if ((e.name = strdup (entry->name)) == NULL ||
+	(entry->group != NULL && (e.group = strdup (entry->group)) == NULL))
+	return ERROR;
+
+    if (net_hsize > 0 &&
+	net_hash[h = net_reg_slot (e.name, strlen (e.name), e.type)] != 0) {
+	net_reg[net_hash[h] - 1] = e;
+	return SUCCESS;
+    }
+
+    if (net_nreg == net_maxreg) {
+	i = net_maxreg ? 2 * net_maxreg : 64;
+	if ((reg = realloc (net_reg, i * sizeof (*reg))) == NULL)
+	    return ERROR;
+	net_reg = reg;
+	net_maxreg = i;
+    }
+    net_reg[net_nreg++] = e;
+
+    /* rehash into a table at least twice the number of entries */
+
+    if (2 * net_nreg > net_hsize) {
+	for (i = net_hsize ? 2 * net_hsize : 128; i < 2 * net_nreg; i *= 2)
+	    ;
+	if ((hash = calloc (i, sizeof (*hash))) == NULL) {
+	    net_nreg--;
+	    return ERROR;
+	}
+	free (net_hash);
+	net_hash  = hash;
+	net_hsize = i;
+	for (i = 0; i < net_nreg - 1; i++)
+	    net_hash[net_reg_slot (net_reg[i].name, strlen (net_reg[i].name),
+				   net_reg[i].type)] = i + 1;
+    }
+
+    net_hash[net_reg_slot (e.name, strlen (e.name), e.type)] = net_nreg;
+    return SUCCESS;
+}
@@ -0,0 +1,402 @@
+/* net_evloop.c -- epoll Event Loop Functions */
+
+/*----------------------------------------------------------------------------
+ * Copyright (c) 1995-2010,2015, Jet Propulsion Laboratory
+ * Permission is granted to make and distribute copies of this software
+ * without fee, provided the above copyright notice and this permission notice
+ * are preserved on all copies.  All other rights reserved.  The software is
+ * provided "as is" without express or implied warranty, and no representation
+ * is made about its suitability for any purpose.
+ *
+ * Description:
+ *	This module contains an event loop for servers, built on edge-
+ *	triggered epoll.  Listening sockets, connections, timerfds and any
+ *	other descriptors are registered with a callback, which the loop
+ *	calls only for the descriptors that became ready.  Unlike select(),
+ *	the cost of a wakeup does not grow with the number of descriptors
+ *	registered, and descriptors are not limited to FD_SETSIZE.
+ *
+ *--------------------------------------------------------------------------*/
+
+#include <sys/types.h>
+#include <sys/epoll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "net_appl.h"
+#include "net.h"
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	net_evloop *net_evloop_create ()
+*
+* Description:
+*	net_evloop_create() creates an event loop with no descriptors
+*	registered.  Descriptors are added with net_evloop_add(), and
+*	net_evloop_run() then waits for them and calls their callbacks.
+*
+* Return Values:
+*	On success, net_evloop_create() returns the new event loop.
+*
+*	On failure, it returns NULL, with errno containing the error
+*	indication.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	epoll is Linux specific.
+*
+* Notes:
+*	An event loop is meant to be run by a single thread.  Threads that
+*	each need a loop create their own.
+*
+*************************************************************************** */
+#endif
+
+net_evloop *net_evloop_create ()
+{
+    net_evloop *ev;			/* new event loop */
+
+    if ((ev = (net_evloop *) calloc (1, sizeof (net_evloop))) == NULL)
+	return NULL;
+
+    if ((ev->epfd = epoll_create1 (EPOLL_CLOEXEC)) == ERROR) {
+	free (ev);
+	return NULL;
+    }
+    return ev;
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_evloop_add (ev, fd, events, func, arg)
+*
+* Description:
+*	net_evloop_add() registers descriptor fd with event loop ev.
+*	Whenever fd becomes ready for one of events, NET_EV_IN and/or
+*	NET_EV_OUT, net_evloop_run() calls func (ev, fd, ready, arg), where
+*	ready holds the events fd is ready for, with NET_EV_ERR set on an
+*	error or hang-up.
+*
+*	Readiness is edge-triggered: func is called when fd becomes
+*	ready, not for as long as it stays ready.  func must therefore
+*	consume everything available, e.g. call net_recv() NON_BLOCKING
+*	or net_accept() NON_BLOCKING until NWOULDBLOCK, before returning.
+*	A socket with an internal receive buffer (see net_setrxbuf()) can
+*	hold messages the kernel no longer reports; they are returned by
+*	the same loop.
+*
+* Return Values:
+*	net_evloop_add() returns SUCCESS on success.
+*
+*	On failure, it returns:
+*
+*	NBADADDR	when ev or func is not a valid pointer.
+*
+*	NBADFD		when fd is not a valid descriptor, or is already
+*			registered.
+*
+*	NBADMODE	when events is not a non-empty combination of
+*			NET_EV_IN and NET_EV_OUT.
+*
+*	ERROR		on a system call error, with errno containing the
+*			error indication.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	func may add and delete descriptors, its own included, and may
+*	close them once deleted.
+*
+*************************************************************************** */
+#endif
+
+int net_evloop_add (ev, fd, events, func, arg)
+net_evloop *ev;				/* event loop */
+int fd;					/* descriptor to watch */
+int events;				/* events to watch for */
+net_evfunc func;			/* callback */
+void *arg;				/* argument passed to func */
+{
+    struct epoll_event ee;		/* epoll registration */
+    net_evfd *fdv;			/* grown registration table */
+    int nfd;				/* new table size */
+
+    /* validate parameters */
+
+    if (ev == (net_evloop *) NULL || func == (net_evfunc) NULL)
+	return NBADADDR;
+
+    if (fd < 0 || (fd < ev->nfd && ev->fdv[fd].func != NULL))
+	return NBADFD;
+
+    if (events == 0 || (events & ~(NET_EV_IN | NET_EV_OUT)) != 0)
+	return NBADMODE;
+
+    /* the table is indexed by descriptor; grow it to cover fd */
+
+    if (fd >= ev->nfd) {
+	nfd = (fd < 2 * ev->nfd) ? 2 * ev->nfd : fd + 64;
+
+	if ((fdv = (net_evfd *) realloc (ev->fdv,
+				    nfd * sizeof (net_evfd))) == NULL)
+	    return ERROR;
+
+	(void) memset (fdv + ev->nfd, 0, (nfd - ev->nfd) * sizeof (net_evfd));
+	ev->fdv = fdv;
+	ev->nfd = nfd;
+    }
+
+    /* the registration number travels with the event, so that an event
+       still pending for a descriptor closed and reused is ignored */
+
+    ev->gen++;
+
+    (void) memset (&ee, 0, sizeof (ee));
+    ee.events   = EPOLLET | ((events & NET_EV_IN) ? EPOLLIN : 0) |
+			    ((events & NET_EV_OUT) ? EPOLLOUT : 0);
+    ee.data.u64 = ((uint64_t) ev->gen << 32) | (unsigned) fd;
+
+    if (epoll_ctl (ev->epfd, EPOLL_CTL_ADD, fd, &ee) == ERROR)
+	return (errno == EBADF) ? NBADFD : ERROR;
+
+    ev->fdv[fd].func = func;
+    ev->fdv[fd].arg  = arg;
+    ev->fdv[fd].gen  = ev->gen;
+
+    return (0);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_evloop_del (ev, fd)
+*
+* Description:
+*	net_evloop_del() removes descriptor fd from event loop ev.  Its
+*	callback is not called again, even for events already taken by
+*	the current net_evloop_run() iteration.  A descriptor must be
+*	removed before it is closed.
+*
+* Return Values:
+*	net_evloop_del() returns SUCCESS on success.
+*
+*	On failure, it returns:
+*
+*	NBADADDR	when ev is not a valid pointer.
+*
+*	NBADFD		when fd is not registered with ev.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	None.
+*
+*************************************************************************** */
+#endif
+
+int net_evloop_del (ev, fd)
+net_evloop *ev;				/* event loop */
+int fd;					/* descriptor to remove */
+{
+    /* validate parameters */
+
+    if (ev == (net_evloop *) NULL)
+	return NBADADDR;
+
+    if (fd < 0 || fd >= ev->nfd || ev->fdv[fd].func == NULL)
+	return NBADFD;
+
+    /* a descriptor closed already has left the epoll set by itself */
+
+    (void) epoll_ctl (ev->epfd, EPOLL_CTL_DEL, fd, (struct epoll_event *) NULL);
+
+    ev->fdv[fd].func = NULL;
+    ev->fdv[fd].arg  = NULL;
+
+    return (0);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_evloop_run (ev)
+*
+* Description:
+*	net_evloop_run() waits for the descriptors registered with event
+*	loop ev to become ready, and calls the callback of each ready
+*	descriptor, until net_evloop_stop() is called.
+*
+* Return Values:
+*	net_evloop_run() returns SUCCESS once stopped.
+*
+*	On failure, it returns:
+*
+*	NBADADDR	when ev is not a valid pointer.
+*
+*	ERROR		on an epoll_wait() error, with errno containing
+*			the error indication.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	Up to NET_EV_BATCH ready descriptors are taken per epoll_wait().
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	A signal interrupting the wait does not end the loop, unless its
+*	handler calls net_evloop_stop().
+*
+*************************************************************************** */
+#endif
+
+int net_evloop_run (ev)
+net_evloop *ev;				/* event loop */
+{
+    struct epoll_event ready[NET_EV_BATCH];	/* ready descriptors */
+    net_evfd *ef;			/* registration of a descriptor */
+    int nready;				/* number of ready descriptors */
+    int fd;				/* ready descriptor */
+    int events;				/* its ready events */
+    int i;				/* loop index */
+
+    if (ev == (net_evloop *) NULL)
+	return NBADADDR;
+
+    while (!ev->stop) {
+
+	if ((nready = epoll_wait (ev->epfd, ready, NET_EV_BATCH, -1)) == ERROR) {
+	    if (errno == EINTR)
+		continue;
+	    return ERROR;
+	}
+
+	for (i = 0; i < nready && !ev->stop; i++) {
+	    fd = (int) (ready[i].data.u64 & 0xffffffff);
+
+	    /* skip descriptors deleted by an earlier callback */
+
+	    if (fd >= ev->nfd)
+		continue;
+
+	    ef = &ev->fdv[fd];
+	    if (ef->func == NULL || ef->gen != (unsigned) (ready[i].data.u64 >> 32))
+		continue;
+
+	    events = ((ready[i].events & EPOLLIN) ? NET_EV_IN : 0) |
+		     ((ready[i].events & EPOLLOUT) ? NET_EV_OUT : 0) |
+		     ((ready[i].events & (EPOLLERR | EPOLLHUP)) ? NET_EV_ERR : 0);
+
+	    (*ef->func) (ev, fd, events, ef->arg);
+	}
+    }
+
+    ev->stop = 0;
+
+    return (0);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	void net_evloop_stop (ev)
+*
+* Description:
+*	net_evloop_stop() makes net_evloop_run() return once the callback
+*	being called, if any, returns.
+*
+* Return Values:
+*	None.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	net_evloop_stop() may be called from a callback or from a signal
+*	handler.
+*
+*************************************************************************** */
+#endif
+
+void net_evloop_stop (ev)
+net_evloop *ev;				/* event loop */
+{
+    if (ev != (net_evloop *) NULL)
+	ev->stop = 1;
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	void net_evloop_destroy (ev)
+*
+* Description:
+*	net_evloop_destroy() frees event loop ev.  The descriptors still
+*	registered with it are not closed.
+*
+* Return Values:
+*	None.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	None.
+*
+*************************************************************************** */
+#endif
+
+void net_evloop_destroy (ev)
+net_evloop *ev;				/* event loop */
+{
+    if (ev == (net_evloop *) NULL)
+	return;
+
+    (void) close (ev->epfd);
+    free (ev->fdv);
+    free (ev);
+}
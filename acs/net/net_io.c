@@ -20,10 +20,23 @@
  *
  * Description:
  *	This module contains functions for sending and receiving data in a
- *	connection-oriented communication.
+ *	connection-oriented communication.  net_send() and net_recv() also
+ *	accept UDP sockets opened by net_udp_open(), in which case each
+ *	message is sent as one datagram without an internal header.
+ *	net_send_timed() and net_recv_timed() bound a whole transfer by a
+ *	deadline and wait on socket readiness instead of sleeping.
+ *	net_send_zc() and net_sendfile() send large messages without
+ *	copying them from a user buffer or file into the kernel.
+ *	net_send_many() writes several messages with one system call.
+ *	net_settstamp() enables kernel receive and transmit timestamps.
+ *	net_setqueue() queues non-blocking messages behind a busy socket.
+ *	The I/O mode is applied per call, and the send and receive sides of a
+ *	connection each take a lock, so that threads can share it.
  *
  *--------------------------------------------------------------------------*/
 
+#define _GNU_SOURCE		/* for ppoll() */
+
 #ifdef VXWORKS
 #include <vxWorks.h>
 #include <ioLib.h>
@@ -34,27 +47,61 @@
 #else
 #include <sys/types.h>
 #include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
 #include <netinet/in.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
 #include <errno.h>
 #endif
 
-#include "net_appl.h"
-#include "net.h"
+#include <poll.h>
+#include <time.h>
 
-#define NET_HDR_ID	0x3c54543e	/* ascii representation for "<TT>" */
+#include <stdlib.h>
+#include <string.h>
 
-/* TCP internal message header */
+#include "net_appl.h"
+#include "net.h"
 
-struct msg_hdr_dcl {
+/* global variable definitions */
 
-    int hdr_id;			/* message header id */
-    int msg_len;		/* length of user's message in bytes */
-};
+struct timespec net_forever = {-1, 0};
 
 /* external variable declarations */
 
 extern sockfd_entry net_sockfd[];
+static int net_sendframed ();
+static int net_sendbatch ();
+static int net_writev ();
+static int net_sendiov ();
+static void net_txbuf_free ();
+static int net_txqueue ();
+static net_txbuf *net_txq_next ();
+static void net_txq_free ();
+static int net_errqueue ();
+static int net_txsave_file ();
+static int net_zc_enable ();
+static int net_sendzc ();
+static int net_sendfmsg ();
+static int net_rxbatch ();
+static int net_rxbuf_resize ();
+static int net_rxview ();
+static int net_recvmsg ();
+static int net_recvts ();
+static int net_readn ();
 static int net_read_excess ();
+static int net_rxskip ();
+static int net_rxstash ();
+static int net_rxfill ();
+static int net_rxnext ();
+static int net_rxrecv ();
+static void net_rxinfo ();
+static void net_rxbuf_release ();
+static void net_rxbuf_free ();
+static void net_deadline ();
 
 #ifdef FUNCT_HDR
 /* ***************************************************************************
@@ -67,6 +114,11 @@ static int net_read_excess ();
 *	oriented communication.  net_send() preserves message boundaries
 *	between the sender and receiver.
 *
+*	A NON_BLOCKING net_send() never waits.  If only part of the
+*	message can be sent immediately, the message is accepted and the
+*	rest of it is kept with the socket, to be sent ahead of the next
+*	message or by net_flush().
+*
 * Return Values:
 *	On success, net_send() returns the number of bytes sent.  If a
 *	broken connection condition is detected, net_send() will return
@@ -84,10 +136,10 @@ static int net_read_excess ();
 *
 *	NBADMODE	when the mode is not a valid I/O mode.
 *
-*	NWOULDBLOCK	when the I/O mode is NON_BLOCKING and no
-*			messages could be sent immediately.  It is
-*			possible, however, that a partial message may have
-*			been sent when this error is returned.
+*	NWOULDBLOCK	when the I/O mode is NON_BLOCKING and no part of
+*			the message could be sent immediately, or the rest
+*			of an earlier message is still pending.  The
+*			message has not been sent.
 *
 *	ERROR		on a system call error, with errno containing the
 *			error indication.
@@ -96,7 +148,9 @@ static int net_read_excess ();
 *	None.
 *
 * Performance:
-*	N/A
+*	The internal message header and the user's message are written
+*	with a single writev() call, so that a message is normally put on
+*	the wire as one segment.
 *
 * Portability:
 *	None.
@@ -113,19 +167,7 @@ char *msg;				/* message to be sent */
 int length;				/* message length in bytes */
 io_mode mode;				/* send I/O mode */
 {
-    int status;				/* return status */
-    int nwritten;			/* number of bytes written */
-    int nleft;				/* remaining bytes to write */
-    int ndelay;				/* number of delays before quitting */
-    char *msgptr;			/* output buffer */
-
-    struct msg_hdr_dcl msg_hdr = {NET_HDR_ID, 0};
-
-    /* validate socket descriptor */
-
-    if (sockfd < 0 || sockfd >= NET_MAX_FD ||
-				    net_sockfd[sockfd].type == UNDEF)
-	return NBADFD;
+    struct iovec iov;			/* user's message */
 
     /* validate msg pointer */
 
@@ -137,133 +179,152 @@ io_mode mode;				/* send I/O mode */
     if (length < NET_MIN_MSG_LEN || length > NET_MAX_MSG_LEN)
 	return NBADLENGTH;
 
-    /* validate and set socket I/O mode */
-
-    if (mode != BLOCKING && mode != NON_BLOCKING)
-	return NBADMODE;
+    iov.iov_base = msg;
+    iov.iov_len  = length;
 
-    if ((status = net_setiomode (sockfd, mode)) < 0)
-	return status;
+    return net_sendv (sockfd, &iov, 1, mode);
+}
 
-    /* output internal message header */
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_sendv (sockfd, iov, iovcnt, mode)
+* 
+* Description:
+*	net_sendv() sends a single message, gathered from the iovcnt
+*	buffers described by the array iov, to a connected endpoint in a
+*	connection-oriented communication.  The buffers are sent in array
+*	order and are received by the peer as one message, e.g. by a
+*	single net_recv() call, so that a caller can send a header
+*	structure and a separate data block without first copying them
+*	together.
+*
+* Return Values:
+*	On success, net_sendv() returns the total number of bytes sent.  If
+*	a broken connection condition is detected, net_sendv() will return
+*	NEOF.
+*
+*	On failure, it returns:
+*
+*	NBADFD		when sockfd is not a valid socket descriptor.
+*
+*	NBADADDR	when iov or one of its buffer pointers is not a
+*			valid pointer.
+*
+*	NBADLENGTH	when iovcnt is out of range, or the total message
+*			length either exceeds the maximum length allowed
+*			or is less than the minimum required.
+*
+*	NBADMODE	when the mode is not a valid I/O mode.
+*
+*	NWOULDBLOCK	when the I/O mode is NON_BLOCKING and no part of
+*			the message could be sent immediately, or the rest
+*			of an earlier message is still pending.  The
+*			message has not been sent.
+*
+*	ERROR		on a system call error, with errno containing the
+*			error indication.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	The internal message header and all of the user's buffers are
+*	written with a single writev() call.
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	iovcnt may not exceed NET_MAX_IOV.
+* 
+*************************************************************************** */
+#endif
 
-    msg_hdr.hdr_id  = htonl (NET_HDR_ID);
-    msg_hdr.msg_len = htonl (length);
-    msgptr = (char *) &msg_hdr;
-    nleft  = sizeof (msg_hdr);
+int net_sendv (sockfd, iov, iovcnt, mode)
+int sockfd;				/* endpoint socket descriptor */
+const struct iovec *iov;		/* message buffers to be sent */
+int iovcnt;				/* number of message buffers */
+io_mode mode;				/* send I/O mode */
+{
+    int i;				/* loop index */
+    long length;			/* total message length in bytes */
+    struct iovec out[NET_MAX_IOV + 1];	/* header and user's buffers */
 
-    while (nleft > 0) {
+    /* validate socket descriptor */
 
-	nwritten = write (sockfd, msgptr, nleft);
+    if (sockfd < 0 || sockfd >= NET_MAX_FD ||
+				    NET_TYPE (sockfd) == UNDEF)
+	return NBADFD;
 
-	if (nwritten == ERROR) {
-	    if (errno == EINTR) {
-		errno = 0;
-		continue;
-	    }
-	    else if (errno == EWOULDBLOCK)
-		return NWOULDBLOCK;
+    /* validate iov array and compute msg length */
 
-	    /* if broken pipe, return NEOF */
-	    else if (errno == EPIPE)
-		return NEOF;
+    if (iov == (struct iovec *) NULL)
+	return NBADADDR;
 
-	    else
-		return ERROR;
-	}
-	else if (nwritten == 0)
-	    return NEOF;
+    if (iovcnt < 1 || iovcnt > NET_MAX_IOV)
+	return NBADLENGTH;
 
-	/* update amount written */
+    length = 0;
+    for (i = 0; i < iovcnt; i++) {
+	if (iov[i].iov_base == NULL && iov[i].iov_len > 0)
+	    return NBADADDR;
 
-	nleft  -= nwritten;
-	msgptr += nwritten;
+	length += iov[i].iov_len;
+	out[i + 1] = iov[i];
     }
-    /* output actual user's message */
-
-    ndelay = 0;
-    nleft  = length;
-
-    while (nleft > 0) {
-
-	nwritten = write (sockfd, msg, nleft);
-
-	if (nwritten == ERROR) {
-	    if (errno == EINTR) {
-		errno = 0;
-		continue;
-	    }
-	    else if (errno == EWOULDBLOCK) {
-		struct timeval delay;
-
-		delay.tv_sec  = 0;
-		delay.tv_usec = NET_MIN_USEC_DELAY;
-
-		if (++ndelay > NET_MAX_NDELAY)
-		    return NWOULDBLOCK;
-
-		(void) select (0, (fd_set *)0, (fd_set *)0, (fd_set *)0,
-								&delay);
-		continue;
-	    }
-
-	    /* if broken pipe, return NEOF */
-	    else if (errno == EPIPE)
-		return NEOF;
 
-	    else
-		return ERROR;
-	}
-	else if (nwritten == 0)
-	    return NEOF;
+    if (length < NET_MIN_MSG_LEN || length > NET_MAX_MSG_LEN)
+	return NBADLENGTH;
 
-	/* update amount written */
+    /* validate socket I/O mode */
 
-	nleft -= nwritten;
-	msg   += nwritten;
-    }
-    /* return number of bytes written */
+    if (mode != BLOCKING && mode != NON_BLOCKING)
+	return NBADMODE;
 
-    return (length - nleft);
+    return net_sendframed (sockfd, out, iovcnt, length,
+					    NET_MODE_DEADLINE (mode));
 }
 
 #ifdef FUNCT_HDR
 /* ***************************************************************************
 *
 * Synopsis:
-*	int net_recv (sockfd, buff, maxlen, mode)
+*	int net_send_many (sockfd, msgv, vlen, mode)
 * 
 * Description:
-*	net_recv() receives a message from a connected endpoint in a
-*	connection-oriented communication.  net_recv() preserves message
-*	boundaries between the sender and receiver.  The received message
-*	will be placed into the array buff for up to maxlen bytes.  If the
-*	message is too long to fit in the supplied buffer, it will be
-*	truncated and the excess bytes discarded.
+*	net_send_many() sends vlen messages to a connected endpoint in a
+*	single call.  Message i is the msgv[i].len bytes at msgv[i].buf;
+*	msgv[i].maxlen is not used.  The receiver gets vlen ordinary
+*	messages, in order, as if each had been sent by net_send().
+*
+*	The messages are framed and written together, so that messages
+*	sent in the same tick share TCP segments instead of each taking
+*	its own with TCP_NODELAY.  The I/O mode applies to the whole
+*	batch as for a single message of net_send().
 *
 * Return Values:
-*	On success, net_recv() returns the number of bytes received.  If a
-*	broken connection condition is detected, net_recv() will return
-*	NEOF.
+*	On success, net_send_many() returns vlen.  If a broken connection
+*	condition is detected, net_send_many() will return NEOF.
 *
 *	On failure, it returns:
 *
 *	NBADFD		when sockfd is not a valid socket descriptor.
 *
-*	NBADADDR	when the buffer pointer is not a valid pointer.
+*	NBADADDR	when msgv or one of its buffer pointers is not a
+*			valid pointer.
 *
-*	NBADLENGTH	when the requested message length is less than
-*			the minimum length required.
+*	NBADLENGTH	when vlen is out of range, or the length of a
+*			message either exceeds the maximum length allowed
+*			or is less than the minimum required.
 *
 *	NBADMODE	when the mode is not a valid I/O mode.
 *
-*	NSYNCERR	when the incoming message boundaries are out of
-*			sync.
-*
-*	NWOULDBLOCK	when the I/O mode is NON_BLOCKING and no
-*			messages were available to be received.  It is
-*			possible, however, that a partial message may have
-*			been received when this error is returned.
+*	NWOULDBLOCK	when the I/O mode is NON_BLOCKING and no part of
+*			the messages could be sent immediately, or the
+*			rest of an earlier message is still pending.  None
+*			of the messages has been sent.
 *
 *	ERROR		on a system call error, with errno containing the
 *			error indication.
@@ -272,167 +333,188 @@ io_mode mode;				/* send I/O mode */
 *	None.
 *
 * Performance:
-*	N/A
+*	The internal message headers and all of the messages are written
+*	with a single writev() call.
 *
 * Portability:
 *	None.
 *
 * Notes:
-*	None.
+*	vlen may not exceed NET_MAX_IOV.  On a UDP socket, each message is
+*	sent as its own datagram.
 * 
 *************************************************************************** */
 #endif
 
-int net_recv (sockfd, buff, maxlen, mode)
+int net_send_many (sockfd, msgv, vlen, mode)
 int sockfd;				/* endpoint socket descriptor */
-char *buff;				/* buffer area to receive msg into */
-int maxlen;				/* length in bytes of buffer area */
-io_mode mode;				/* receive I/O mode */
+net_msgvec *msgv;			/* messages to be sent */
+int vlen;				/* number of messages */
+io_mode mode;				/* send I/O mode */
 {
+    int i;				/* loop index */
     int status;				/* return status */
-    int nread;				/* number of bytes read */
-    int nleft;				/* remaining bytes to read */
-    int nbytes;				/* number of bytes placed in buff */
-    int nexcess;			/* number of excess bytes */
-    int ndelay;				/* number of delays before quitting */
-    char *bufptr;			/* input buffer pointer */
-    struct msg_hdr_dcl msg_hdr;		/* internal message header */
-
+    struct iovec out[2];		/* header slot and one message */
 
     /* validate socket descriptor */
 
     if (sockfd < 0 || sockfd >= NET_MAX_FD ||
-				    net_sockfd[sockfd].type == UNDEF)
+				    NET_TYPE (sockfd) == UNDEF)
 	return NBADFD;
 
-    /* validate buff pointer */
+    /* validate message array */
 
-    if (buff == (char *) NULL)
+    if (msgv == (net_msgvec *) NULL)
 	return NBADADDR;
 
-    /* validate buffer length */
-
-    if (maxlen < NET_MIN_MSG_LEN)
+    if (vlen < 1 || vlen > NET_MAX_IOV)
 	return NBADLENGTH;
 
-    /* validate and set socket I/O mode */
+    for (i = 0; i < vlen; i++) {
+	if (msgv[i].buf == NULL)
+	    return NBADADDR;
+
+	if (msgv[i].len < (int) NET_MIN_MSG_LEN ||
+				    msgv[i].len > NET_MAX_MSG_LEN)
+	    return NBADLENGTH;
+    }
+
+    /* validate socket I/O mode */
 
     if (mode != BLOCKING && mode != NON_BLOCKING)
 	return NBADMODE;
 
-    if ((status = net_setiomode (sockfd, mode)) < 0)
-	return status;
+    if (NET_TYPE (sockfd) != UDP)
+	return net_sendbatch (sockfd, msgv, vlen, NET_MODE_DEADLINE (mode));
 
-    /* read internal message header */
+    /* datagrams carry no header to batch */
 
-    bufptr = (char *) &msg_hdr;
-    nleft  = sizeof (msg_hdr);
+    for (i = 0; i < vlen; i++) {
+	out[1].iov_base = msgv[i].buf;
+	out[1].iov_len  = msgv[i].len;
 
-    while (nleft > 0) {
+	if ((status = net_sendframed (sockfd, out, 1, (long) msgv[i].len,
+					    NET_MODE_DEADLINE (mode))) < 0)
+	    return (i > 0) ? i : status;
+    }
+    return (vlen);
+}
 
-	nread = read (sockfd, bufptr, nleft);
+/* ***************************************************************************
+*
+* net_sendbatch() frames the vlen messages of msgv and writes them to a
+* connected TCP endpoint with net_writev(), as net_sendframed() does for a
+* single message.  It returns vlen once all of the messages are accepted,
+* or the error status of net_writev().
+*
+*************************************************************************** */
 
-	if (nread == ERROR) {
-	    if (errno == EINTR) {
-		errno = 0;
-		continue;
-	    }
-	    else if (errno == EWOULDBLOCK)
-		return NWOULDBLOCK;
+static int net_sendbatch (sockfd, msgv, vlen, deadline)
+int sockfd;				/* endpoint socket descriptor */
+net_msgvec *msgv;			/* messages to be sent */
+int vlen;				/* number of messages */
+struct timespec *deadline;		/* time limit, NULL if none */
+{
+    struct msg_hdr_v2 msg_hdr[NET_MAX_IOV];	/* internal message headers */
+    struct iovec out[2 * NET_MAX_IOV];	/* headers and messages */
+    int hlen[NET_MAX_IOV];		/* header lengths in bytes */
+    int i;				/* loop index */
+    int status;				/* return status */
 
-	    else
-		return ERROR;
-	}
-	else if (nread == 0)
-	    return NEOF;
+    (void) pthread_mutex_lock (&net_sockfd[sockfd].txlock);
 
-	/* update amount read */
+    /* finish sending an earlier message first to keep the stream in sync */
 
-	nleft  -= nread;
-	bufptr += nread;
+    status = 0;
+
+    if (net_sockfd[sockfd].txbuf != NULL) {
+	if ((status = net_txflush (sockfd, deadline)) < 0) {
+	    if (status == ERROR && errno == EPIPE)
+		status = NEOF;
+	}
+	else if (status > 0)
+	    status = NWOULDBLOCK;
     }
-    /* check message header id */
 
-    if (ntohl (msg_hdr.hdr_id) != NET_HDR_ID)
-	return NSYNCERR;
+    if (status == 0) {
 
-    /* read message into user's buffer */
+	/* each message gets the sequence number it is accepted with */
 
-    nbytes = 0;
-    ndelay = 0;
-    if (ntohl (msg_hdr.msg_len) < maxlen)
-	nleft = ntohl (msg_hdr.msg_len);
-    else
-	nleft = maxlen;
+	for (i = 0; i < vlen; i++) {
+	    hlen[i] = net_hdr_make (sockfd, msgv[i].len, &msg_hdr[i]);
+	    if (hlen[i] == sizeof (struct msg_hdr_v2))
+		msg_hdr[i].seq_no = htonl (net_sockfd[sockfd].tx_seq + i);
 
-    while (nleft > 0) {
+	    out[2 * i].iov_base     = (char *) &msg_hdr[i];
+	    out[2 * i].iov_len      = hlen[i];
+	    out[2 * i + 1].iov_base = msgv[i].buf;
+	    out[2 * i + 1].iov_len  = msgv[i].len;
+	}
 
-	nread = read (sockfd, buff, nleft);
+	if ((status = net_writev (sockfd, out, 2 * vlen, deadline)) > 0) {
+	    for (i = 0; i < vlen; i++)
+		net_txdone (sockfd, hlen[i] + msgv[i].len);
+	    status = vlen;
+	}
 
-	if (nread == ERROR) {
-	    if (errno == EINTR) {
-		errno = 0;
-		continue;
-	    }
-	    else if (errno == EWOULDBLOCK) {
-		struct timeval delay;
+    }
 
-		delay.tv_sec  = 0;
-		delay.tv_usec = NET_MIN_USEC_DELAY;
+    /* a busy socket queues the messages, if it has a queue */
 
-		if (++ndelay > NET_MAX_NDELAY)
-		    return NWOULDBLOCK;
+    if (status == NWOULDBLOCK && net_sockfd[sockfd].txqinfo.depth > 0) {
+	for (i = 0; i < vlen; i++) {
+	    out[0].iov_base = msgv[i].buf;
+	    out[0].iov_len  = msgv[i].len;
 
-		(void) select (0, (fd_set *)0, (fd_set *)0, (fd_set *)0,
-								&delay);
-		continue;
-	    }
-	    else
-		return ERROR;
+	    if ((status = net_txqueue (sockfd, out, 1, msgv[i].len)) < 0)
+		break;
 	}
-	else if (nread == 0)
-	    return NEOF;
-
-	/* update amount read */
 
-	nleft  -= nread;
-	nbytes += nread;
-	buff   += nread;
-    }
-    /* read and discard excess bytes */
+	if (net_sockfd[sockfd].txbuf == NULL)
+	    (void) net_txq_next (sockfd);
 
-    nexcess = ntohl (msg_hdr.msg_len) - maxlen;
-    if (nexcess > 0) {
-	status = net_read_excess (sockfd, nexcess);
-	if (status < 0)
-	    return (status);
+	if (i > 0 && status != NEOF)
+	    status = i;
     }
 
-    /* return number of bytes placed in user's buffer */
+    (void) pthread_mutex_unlock (&net_sockfd[sockfd].txlock);
 
-    return (nbytes);
+    return (status);
 }
 
 #ifdef FUNCT_HDR
 /* ***************************************************************************
 *
 * Synopsis:
-*       static int net_read_excess (sockfd, nexcess)
+*	int net_send_timed (sockfd, msg, length, usec)
 * 
 * Description:
-*	net_read_excess() reads and discards excess bytes from a connected
-*	endpoint.  It is called by net_recv() to truncate a received
-*	message that is too long to fit in the user-supplied buffer.
+*	net_send_timed() sends a message to a connected endpoint like
+*	net_send(), but gives up once usec microseconds have elapsed.
+*	While the socket cannot accept more data, net_send_timed() waits
+*	for it to become writable, and resumes writing as soon as it does.
+*	If usec is NET_WAIT_FOREVER, there is no deadline.
 *
 * Return Values:
-*	On success, net_read_excess() returns the number of bytes read and
-*	discarded.  If a broken connection condition is detected,
-*	net_read_excess() will return NEOF.
+*	On success, net_send_timed() returns the number of bytes sent.  If
+*	a broken connection condition is detected, net_send_timed() will
+*	return NEOF.
 *
 *	On failure, it returns:
 *
-*	NWOULDBLOCK	when the I/O mode is NON_BLOCKING and no
-*			messages were available to be received.
+*	NBADFD		when sockfd is not a valid socket descriptor.
+*
+*	NBADADDR	when the message pointer is not a valid pointer.
+*
+*	NBADLENGTH	when the requested message length either exceeds
+*			the maximum length allowed or is less than the
+*			minimum required.
+*
+*	NBADMODE	when usec is neither positive nor NET_WAIT_FOREVER.
+*
+*	NTIMEDOUT	when the message could not be sent before the
+*			deadline.  The rest of a partially sent message is
+*			kept as for a non-blocking net_send().
 *
 *	ERROR		on a system call error, with errno containing the
 *			error indication.
@@ -441,10 +523,11 @@ io_mode mode;				/* receive I/O mode */
 *	None.
 *
 * Performance:
-*	N/A
+*	The calling thread never sleeps for longer than it takes the
+*	socket to become writable, nor past the deadline.
 *
 * Portability:
-*	None.
+*	This function uses ppoll().
 *
 * Notes:
 *	None.
@@ -452,55 +535,3992 @@ io_mode mode;				/* receive I/O mode */
 *************************************************************************** */
 #endif
 
-#define NET_BUFSIZE	4096		/* size of read buffer */
-
-static int net_read_excess (sockfd, nexcess)
+int net_send_timed (sockfd, msg, length, usec)
 int sockfd;				/* endpoint socket descriptor */
-int nexcess;				/* number of excess bytes to discard */
+char *msg;				/* message to be sent */
+int length;				/* message length in bytes */
+long usec;				/* time limit in microseconds */
 {
-    int nread;				/* number of bytes read */
-    int nleft;				/* remaining bytes to read */
-    int ndelay;				/* number of delays before quitting */
-    char buff[NET_BUFSIZE];		/* excess read buffer */
+    struct iovec out[2];		/* header and user's message */
+    struct timespec deadline;		/* time limit for the send */
 
-    ndelay = 0;
-    nleft  = nexcess;
+    /* validate socket descriptor */
 
-    while (nleft > 0) {
+    if (sockfd < 0 || sockfd >= NET_MAX_FD ||
+				    NET_TYPE (sockfd) == UNDEF)
+	return NBADFD;
 
-	/* read excess bytes in NET_BUFSIZE increments */
+    /* validate msg pointer and length */
 
-	nread = read (sockfd, buff,
-			      (nleft > NET_BUFSIZE)? NET_BUFSIZE : nleft);
+    if (msg == (char *) NULL)
+	return NBADADDR;
 
-	if (nread == ERROR) {
-	    if (errno == EINTR) {
-		errno = 0;
-		continue;
-	    }
-	    else if (errno == EWOULDBLOCK) {
-		struct timeval delay;
+    if (length < NET_MIN_MSG_LEN || length > NET_MAX_MSG_LEN)
+	return NBADLENGTH;
 
-		delay.tv_sec  = 0;
-		delay.tv_usec = NET_MIN_USEC_DELAY;
+    /* validate time limit */
 
-		if (++ndelay > NET_MAX_NDELAY)
-		    return NWOULDBLOCK;
+    if (usec <= 0 && usec != NET_WAIT_FOREVER)
+	return NBADMODE;
 
-		(void) select (0, (fd_set *)0, (fd_set *)0, (fd_set *)0,
-								&delay);
-		continue;
-	    }
-	    else
+    net_deadline (&deadline, usec);
+
+    out[1].iov_base = msg;
+    out[1].iov_len  = length;
+
+    return net_sendframed (sockfd, out, 1, (long) length, &deadline);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	static int net_sendframed (sockfd, out, iovcnt, length, deadline)
+* 
+* Description:
+*	net_sendframed() sends the message held in the iovcnt buffers
+*	out[1] through out[iovcnt], whose total length is length bytes.
+*	For a TCP socket, the internal message header is placed in out[0]
+*	and the whole message is written with net_writev(); for a UDP
+*	socket, the message is sent as one datagram.  It is called by
+*	net_sendv() and net_send_timed() once the arguments are validated.
+*
+*	The rest of an earlier message still pending in the socket's
+*	transmit buffer is sent first.  If deadline is NULL, a
+*	non-blocking send never waits, as described for net_sendv();
+*	otherwise it waits for the socket to become writable until the
+*	deadline.
+*
+* Return Values:
+*	Same as net_sendv(), or net_send_timed() when a deadline is given.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	The contents of out are modified.
+* 
+*************************************************************************** */
+#endif
+
+static int net_sendframed (sockfd, out, iovcnt, length, deadline)
+int sockfd;				/* endpoint socket descriptor */
+struct iovec *out;			/* header slot and user's buffers */
+int iovcnt;				/* number of user's buffers */
+long length;				/* total message length in bytes */
+struct timespec *deadline;		/* time limit, NULL if none */
+{
+    struct msg_hdr_v2 msg_hdr;		/* internal message header */
+    int hlen;				/* header length in bytes */
+    int status;				/* return status */
+
+    /* a UDP datagram is a message by itself: send it without header */
+
+    if (NET_TYPE (sockfd) == UDP) {
+	if (length > NET_MAX_UDP_LEN)
+	    return NBADLENGTH;
+
+	for (;;) {
+	    status = net_sendiov (sockfd, out + 1, iovcnt,
+						    NET_IOFLAGS (deadline));
+
+	    if (status != ERROR)
+		return (status);
+
+	    if (errno == EINTR)
+		continue;
+
+	    if (errno != EWOULDBLOCK)
 		return ERROR;
+
+	    if (deadline == NULL)
+		return NWOULDBLOCK;
+
+	    if ((status = net_wait (sockfd, POLLOUT, deadline,
+						    (int *) NULL)) < 0)
+		return status;
 	}
-	else if (nread == 0)
+    }
+
+    /* keep other threads' messages out until this one is written */
+
+    (void) pthread_mutex_lock (&net_sockfd[sockfd].txlock);
+
+    /* finish sending an earlier message first to keep the stream in sync */
+
+    status = 0;
+
+    if (net_sockfd[sockfd].txbuf != NULL) {
+	if ((status = net_txflush (sockfd, deadline)) < 0) {
+	    if (status == ERROR && errno == EPIPE)
+		status = NEOF;
+	}
+	else if (status > 0)
+	    status = NWOULDBLOCK;
+    }
+
+    /* prepend internal message header and output in one system call */
+
+    if (status == 0) {
+	hlen = net_hdr_make (sockfd, (int) length, &msg_hdr);
+	out[0].iov_base = (char *) &msg_hdr;
+	out[0].iov_len  = hlen;
+
+	/* return number of user's bytes written */
+
+	if ((status = net_writev (sockfd, out, iovcnt + 1, deadline)) > 0) {
+	    status -= hlen;
+	    net_txdone (sockfd, hlen + (int) length);
+	}
+
+	/* a timed out message is still accepted if its rest was kept */
+
+	else if (status == NTIMEDOUT && net_sockfd[sockfd].txbuf != NULL)
+	    net_txdone (sockfd, hlen + (int) length);
+    }
+
+    /* a busy socket queues the message, if it has a queue */
+
+    if (status == NWOULDBLOCK && net_sockfd[sockfd].txqinfo.depth > 0) {
+	status = net_txqueue (sockfd, out + 1, iovcnt, (int) length);
+
+	if (net_sockfd[sockfd].txbuf == NULL)
+	    (void) net_txq_next (sockfd);
+    }
+
+    (void) pthread_mutex_unlock (&net_sockfd[sockfd].txlock);
+
+    return (status);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	static int net_writev (sockfd, iov, iovcnt, deadline)
+* 
+* Description:
+*	net_writev() writes all of the buffers described by the array iov
+*	to a connected endpoint, advancing through the array as partial
+*	writes complete.  It is called by net_sendframed() to output a
+*	framed message.  The contents of iov are modified.
+*
+*	Whenever the socket cannot accept more data, net_writev() waits
+*	for it to become writable with net_wait() if deadline is given.
+*	Otherwise, or once the deadline has expired, the unwritten rest
+*	of a partially written message is saved in the socket's transmit
+*	buffer, to be sent ahead of the next message or by net_flush().
+*
+* Return Values:
+*	On success, net_writev() returns the total number of bytes
+*	written or saved.  If a broken connection condition is detected,
+*	net_writev() will return NEOF.
+*
+*	On failure, it returns:
+*
+*	NWOULDBLOCK	when the socket is non-blocking, deadline is NULL
+*			and no bytes could be written immediately.
+*
+*	NTIMEDOUT	when the deadline expired first.  The rest of a
+*			partially written message has been saved.
+*
+*	ERROR		on a system call error, with errno containing the
+*			error indication.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	None.
+* 
+*************************************************************************** */
+#endif
+
+static int net_writev (sockfd, iov, iovcnt, deadline)
+int sockfd;				/* endpoint socket descriptor */
+struct iovec *iov;			/* buffers to be written */
+int iovcnt;				/* number of buffers */
+struct timespec *deadline;		/* time limit, NULL if none */
+{
+    int nwritten;			/* number of bytes written */
+    int ntotal;				/* total bytes written */
+    int nsaved;				/* number of bytes saved for later */
+    int status;				/* return status */
+
+    ntotal = 0;
+
+    while (iovcnt > 0) {
+
+	nwritten = net_sendiov (sockfd, iov, iovcnt, NET_IOFLAGS (deadline));
+
+	if (nwritten == ERROR) {
+	    if (errno == EINTR) {
+		errno = 0;
+		continue;
+	    }
+	    else if (errno == EWOULDBLOCK) {
+
+		if (deadline == NULL)
+		    status = NWOULDBLOCK;
+		else if ((status = net_wait (sockfd, POLLOUT, deadline,
+						    (int *) NULL)) == 0)
+		    continue;
+
+		/* nothing sent yet, so the stream is still in sync */
+
+		if (ntotal == 0)
+		    return status;
+
+		/* otherwise keep the rest of the message for later */
+
+		if ((nsaved = net_txsave (sockfd, iov, iovcnt)) < 0)
+		    return ERROR;
+
+		return (deadline == NULL) ? ntotal + nsaved : status;
+	    }
+
+	    /* if broken pipe, return NEOF */
+	    else if (errno == EPIPE)
+		return NEOF;
+
+	    else
+		return ERROR;
+	}
+	else if (nwritten == 0)
 	    return NEOF;
 
-	/* update amount read */
+	/* update amount written and skip completed buffers */
+
+	ntotal += nwritten;
 
-	nleft -= nread;
+	while (iovcnt > 0 && nwritten >= (int) iov->iov_len) {
+	    nwritten -= iov->iov_len;
+	    iov++;
+	    iovcnt--;
+	}
+	if (iovcnt > 0) {
+	    iov->iov_base = (char *) iov->iov_base + nwritten;
+	    iov->iov_len -= nwritten;
+	}
     }
-    return (nexcess - nleft);
+    return (ntotal);
+}
+
+/* ***************************************************************************
+*
+* net_sendiov() writes the iovcnt buffers described by the array iov with
+* a single sendmsg() call, passing flags, and returns its result.
+*
+*************************************************************************** */
+
+static int net_sendiov (sockfd, iov, iovcnt, flags)
+int sockfd;				/* endpoint socket descriptor */
+struct iovec *iov;			/* buffers to be written */
+int iovcnt;				/* number of buffers */
+int flags;				/* sendmsg() flags */
+{
+    struct msghdr msg;			/* message descriptor */
+
+    (void) memset (&msg, 0, sizeof (msg));
+    msg.msg_iov    = iov;
+    msg.msg_iovlen = iovcnt;
+
+    return sendmsg (sockfd, &msg, flags);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_txsave (sockfd, iov, iovcnt)
+* 
+* Description:
+*	net_txsave() copies the iovcnt buffers described by the array iov,
+*	the unwritten rest of a partially written message, into a new
+*	transmit buffer attached to the socket.  The socket must not have
+*	a transmit buffer already.
+*
+* Return Values:
+*	On success, net_txsave() returns the number of bytes saved.
+*
+*	On failure, it returns:
+*
+*	ERROR		when the buffer could not be allocated, with errno
+*			containing the error indication.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	This is an internal function of the network services.
+* 
+*************************************************************************** */
+#endif
+
+int net_txsave (sockfd, iov, iovcnt)
+int sockfd;				/* endpoint socket descriptor */
+struct iovec *iov;			/* buffers left to be written */
+int iovcnt;				/* number of buffers */
+{
+    net_txbuf *tb;			/* socket's transmit buffer */
+    int nbytes;				/* number of bytes to save */
+    int i;				/* loop index */
+
+    for (nbytes = 0, i = 0; i < iovcnt; i++)
+	nbytes += iov[i].iov_len;
+
+    if ((tb = malloc (sizeof (net_txbuf))) == NULL)
+	return ERROR;
+
+    if ((tb->base = malloc (nbytes)) == NULL) {
+	free (tb);
+	return ERROR;
+    }
+
+    for (tb->tail = 0, i = 0; i < iovcnt; i++) {
+	(void) memcpy (tb->base + tb->tail, iov[i].iov_base, iov[i].iov_len);
+	tb->tail += iov[i].iov_len;
+    }
+    tb->head = 0;
+    tb->next = NULL;
+
+    net_sockfd[sockfd].txbuf = tb;
+
+    return (nbytes);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_txflush (sockfd, deadline)
+* 
+* Description:
+*	net_txflush() writes the bytes pending in the transmit buffer of a
+*	socket, and frees the buffer once they are all written.  The
+*	messages queued behind it (see net_setqueue()) are then written
+*	in turn.  If the socket cannot accept more data, net_txflush()
+*	waits for it to become writable with net_wait() if deadline is
+*	given, or returns at once otherwise.
+*
+* Return Values:
+*	On success, net_txflush() returns the number of bytes still
+*	pending in the transmit buffer, zero once it and the queue have
+*	been emptied.
+*
+*	On failure, it returns:
+*
+*	NTIMEDOUT	when the deadline expired first.
+*
+*	ERROR		on a system call error, with errno containing the
+*			error indication (EPIPE for a broken connection).
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	This is an internal function of the network services.
+* 
+*************************************************************************** */
+#endif
+
+int net_txflush (sockfd, deadline)
+int sockfd;				/* endpoint socket descriptor */
+struct timespec *deadline;		/* time limit, NULL if none */
+{
+    net_txbuf *tb = net_sockfd[sockfd].txbuf;
+    int nwritten;			/* number of bytes written */
+    int status;				/* return status */
+
+    while (tb->head < tb->tail) {
+
+	nwritten = send (sockfd, tb->base + tb->head, tb->tail - tb->head,
+						    NET_IOFLAGS (deadline));
+
+	if (nwritten == ERROR) {
+	    if (errno == EINTR) {
+		errno = 0;
+		continue;
+	    }
+	    else if (errno == EWOULDBLOCK) {
+		if (deadline == NULL)
+		    return (tb->tail - tb->head);
+
+		status = net_wait (sockfd, POLLOUT, deadline, (int *) NULL);
+		if (status < 0)
+		    return status;
+		continue;
+	    }
+	    else
+		return ERROR;
+	}
+
+	tb->head += nwritten;
+
+	/* on to the next queued message once this one is out */
+
+	if (tb->head == tb->tail) {
+	    net_txbuf_free (sockfd);
+	    if ((tb = net_txq_next (sockfd)) == NULL)
+		break;
+	}
+    }
+
+    return (0);
 }
 
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_flush (sockfd, mode)
+* 
+* Description:
+*	net_flush() sends the rest of a partially sent message that a
+*	non-blocking or timed send left pending on a connected socket.
+*	Such a message has already been accepted by the send call (see
+*	net_send()); its remaining bytes are also sent automatically
+*	ahead of the next message.
+*
+*	If mode is BLOCKING, net_flush() returns once all pending bytes
+*	are sent.  If mode is NON_BLOCKING, it sends what the socket can
+*	accept immediately.  An event-driven application should call it
+*	whenever the socket becomes writable while net_pending() is
+*	non-zero.
+*
+* Return Values:
+*	On success, net_flush() returns the number of bytes still
+*	pending, zero once all have been sent.
+*
+*	On failure, it returns:
+*
+*	NBADFD		when sockfd is not a valid socket descriptor.
+*
+*	NBADMODE	when the mode is not a valid I/O mode.
+*
+*	ERROR		on a system call error, with errno containing the
+*			error indication (EPIPE for a broken connection).
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	None.
+* 
+*************************************************************************** */
+#endif
+
+int net_flush (sockfd, mode)
+int sockfd;				/* endpoint socket descriptor */
+io_mode mode;				/* send I/O mode */
+{
+    int status;				/* return status */
+
+    /* validate socket descriptor */
+
+    if (sockfd < 0 || sockfd >= NET_MAX_FD ||
+				    NET_TYPE (sockfd) == UNDEF)
+	return NBADFD;
+
+    /* validate socket I/O mode */
+
+    if (mode != BLOCKING && mode != NON_BLOCKING)
+	return NBADMODE;
+
+    (void) pthread_mutex_lock (&net_sockfd[sockfd].txlock);
+
+    status = 0;
+    if (net_sockfd[sockfd].txbuf != NULL)
+	status = net_txflush (sockfd, NET_MODE_DEADLINE (mode));
+
+    (void) pthread_mutex_unlock (&net_sockfd[sockfd].txlock);
+
+    return (status);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_pending (sockfd)
+* 
+* Description:
+*	net_pending() returns the number of bytes of a partially sent
+*	message still pending on a socket (see net_flush()), and of the
+*	messages queued behind it (see net_setqueue()).
+*
+* Return Values:
+*	On success, net_pending() returns the number of pending bytes.
+*
+*	On failure, it returns:
+*
+*	NBADFD		when sockfd is not a valid socket descriptor.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	None.
+* 
+*************************************************************************** */
+#endif
+
+int net_pending (sockfd)
+int sockfd;				/* endpoint socket descriptor */
+{
+    net_txbuf *tb;			/* socket's transmit buffer */
+    int npending;			/* number of bytes pending */
+
+    /* validate socket descriptor */
+
+    if (sockfd < 0 || sockfd >= NET_MAX_FD ||
+				    NET_TYPE (sockfd) == UNDEF)
+	return NBADFD;
+
+    (void) pthread_mutex_lock (&net_sockfd[sockfd].txlock);
+
+    npending = 0;
+    for (tb = net_sockfd[sockfd].txbuf; tb != NULL; tb = tb->next)
+	npending += tb->tail - tb->head;
+
+    for (tb = net_sockfd[sockfd].txq; tb != NULL; tb = tb->next)
+	npending += tb->tail - tb->head;
+
+    (void) pthread_mutex_unlock (&net_sockfd[sockfd].txlock);
+
+    return (npending);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_sethdrver (sockfd, version)
+* 
+* Description:
+*	net_sethdrver() selects the internal message header sent ahead of
+*	each message on a connected socket.  A version 1 header holds the
+*	message length only.  A version 2 header adds the sequence number
+*	of the message on the connection, counting from zero, and the time
+*	it was sent, so that the receiver can detect lost or reordered
+*	messages and measure their one-way latency (see net_getmsginfo()).
+*
+*	Receivers accept both versions.  A peer built before version 2
+*	does not, so version 2 must only be selected if the peer is known
+*	to support it.  With NET_HDR_AUTO, the default, version 1 is sent
+*	until a version 2 header has been received from the peer, and
+*	version 2 from then on.
+*
+* Return Values:
+*	net_sethdrver() returns SUCCESS on success.
+*
+*	On failure, it returns:
+*
+*	NBADFD		when sockfd is not a valid TCP socket descriptor.
+*
+*	NBADMODE	when version is not NET_HDR_AUTO, NET_HDR_V1 or
+*			NET_HDR_V2.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	A version 2 header is 16 bytes longer and costs a clock_gettime()
+*	per message.
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	UDP datagrams are sent without internal header.
+* 
+*************************************************************************** */
+#endif
+
+int net_sethdrver (sockfd, version)
+int sockfd;				/* endpoint socket descriptor */
+int version;				/* header version to send */
+{
+    /* validate socket descriptor and version */
+
+    if (sockfd < 0 || sockfd >= NET_MAX_FD ||
+				    NET_TYPE (sockfd) != TCP)
+	return NBADFD;
+
+    if (version != NET_HDR_AUTO && version != NET_HDR_V1 &&
+						version != NET_HDR_V2)
+	return NBADMODE;
+
+    (void) pthread_mutex_lock (&net_sockfd[sockfd].txlock);
+
+    net_sockfd[sockfd].hdrver = version;
+
+    (void) pthread_mutex_unlock (&net_sockfd[sockfd].txlock);
+
+    return (0);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_getmsginfo (sockfd, info)
+* 
+* Description:
+*	net_getmsginfo() returns in info the internal header of the last
+*	message received on a connected socket, together with counters
+*	kept over all messages received on it.
+*
+*	For a version 2 header, info holds the sequence number of the
+*	message, the time it was sent and received (CLOCK_REALTIME) and
+*	the difference of the two.  Whenever a sequence number is higher
+*	than the previous one plus one, a gap is counted and the numbers
+*	skipped are counted as lost; a sequence number lower than
+*	expected is counted as reordered.
+*
+*	With receive timestamps enabled (see net_settstamp()), info also
+*	holds the time the kernel received the message, and the time it
+*	was received by the caller, whatever the header version.
+*
+* Return Values:
+*	net_getmsginfo() returns SUCCESS on success.
+*
+*	On failure, it returns:
+*
+*	NBADFD		when sockfd is not a valid TCP socket descriptor.
+*
+*	NBADADDR	when info is not a valid pointer.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	The latency is only meaningful if the clocks of both hosts are
+*	synchronized.  net_recv_batch() records the last message of the
+*	batch.
+* 
+*************************************************************************** */
+#endif
+
+int net_getmsginfo (sockfd, info)
+int sockfd;				/* endpoint socket descriptor */
+net_msginfo *info;			/* returned message information */
+{
+    /* validate socket descriptor and info pointer */
+
+    if (sockfd < 0 || sockfd >= NET_MAX_FD ||
+				    NET_TYPE (sockfd) != TCP)
+	return NBADFD;
+
+    if (info == (net_msginfo *) NULL)
+	return NBADADDR;
+
+    (void) pthread_mutex_lock (&net_sockfd[sockfd].rxlock);
+
+    *info = net_sockfd[sockfd].rxinfo;
+
+    (void) pthread_mutex_unlock (&net_sockfd[sockfd].rxlock);
+
+    return (0);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_settstamp (sockfd, flags)
+* 
+* Description:
+*	net_settstamp() enables kernel timestamps (SO_TIMESTAMPING) on a
+*	connected socket, so that the latency of a message can be split
+*	at the points where it enters and leaves the kernels.  flags is
+*	zero, to disable them, or any of:
+*
+*	NET_TS_RX	the time the kernel received the data of each
+*			message is returned by net_getmsginfo().
+*
+*	NET_TS_TX	the time the kernel handed each message sent to
+*			the device is returned by net_gettxstamps().
+*
+*	NET_TS_HW	timestamps taken by the network interface instead
+*			of the kernel.  Receive times fall back to the
+*			kernel's where the interface provides none.
+*
+* Return Values:
+*	net_settstamp() returns SUCCESS on success.
+*
+*	On failure, it returns:
+*
+*	NBADFD		when sockfd is not a valid TCP socket descriptor.
+*
+*	NBADMODE	when flags holds any other bit.
+*
+*	ERROR		on a system call error, with errno containing the
+*			error indication.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	Receive timestamps cost a recvmsg() with control data in place of
+*	each recv(), and a clock_gettime() per message.  Each transmit
+*	timestamp is a message on the error queue of the socket.
+*
+* Portability:
+*	SO_TIMESTAMPING with SOF_TIMESTAMPING_OPT_ID requires Linux 3.19
+*	or later.
+*
+* Notes:
+*	Hardware timestamps must also be enabled on the interface (see
+*	SIOCSHWTSTAMP, e.g. with hwstamp_ctl), which net_settstamp() does
+*	not do, and are in the clock of the interface.  A message taken
+*	from the receive buffer (see net_setrxbuf()) gets the time of the
+*	last read on the socket, which may be later than its arrival.
+* 
+*************************************************************************** */
+#endif
+
+int net_settstamp (sockfd, flags)
+int sockfd;				/* endpoint socket descriptor */
+int flags;				/* timestamps to enable */
+{
+    sockfd_entry *se;			/* socket table entry */
+    net_txring *tr;			/* new transmit timestamp ring */
+    int sof;				/* SO_TIMESTAMPING flags */
+    int status;				/* return status */
+
+    /* validate socket descriptor and flags */
+
+    if (sockfd < 0 || sockfd >= NET_MAX_FD ||
+				    NET_TYPE (sockfd) != TCP)
+	return NBADFD;
+
+    if ((flags & ~(NET_TS_RX | NET_TS_TX | NET_TS_HW)) != 0)
+	return NBADMODE;
+
+    sof = 0;
+
+    if (flags & NET_TS_RX)
+	sof |= SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE |
+	       ((flags & NET_TS_HW) ? SOF_TIMESTAMPING_RX_HARDWARE |
+				      SOF_TIMESTAMPING_RAW_HARDWARE : 0);
+
+    /* key each transmit timestamp by the stream offset of its last byte */
+
+    if (flags & NET_TS_TX)
+	sof |= ((flags & NET_TS_HW) ? SOF_TIMESTAMPING_TX_HARDWARE |
+				      SOF_TIMESTAMPING_RAW_HARDWARE :
+				      SOF_TIMESTAMPING_TX_SOFTWARE |
+				      SOF_TIMESTAMPING_SOFTWARE) |
+	       SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+
+    tr = NULL;
+    if ((flags & NET_TS_TX) &&
+		(tr = (net_txring *) calloc (1, sizeof (net_txring))) == NULL)
+	return ERROR;
+
+    se = &net_sockfd[sockfd];
+
+    (void) pthread_mutex_lock (&se->txlock);
+    (void) pthread_mutex_lock (&se->rxlock);
+
+    if (setsockopt (sockfd, SOL_SOCKET, SO_TIMESTAMPING,
+					(char *) &sof, sizeof (sof)) == ERROR)
+	status = ERROR;
+    else {
+	/* the kernel counts from the first byte it has not been given,
+	   which follows the rest of a partially sent message */
+
+	if (se->txring == NULL && tr != NULL) {
+	    se->tx_off = (se->txbuf != NULL) ?
+			    se->txbuf->tail - se->txbuf->head : 0;
+	    se->txring = tr;
+	    tr = NULL;
+	}
+	else if (se->txring != NULL && !(flags & NET_TS_TX)) {
+	    free (se->txring);
+	    se->txring = NULL;
+	}
+	se->tstamp = flags;
+	status = SUCCESS;
+    }
+
+    (void) pthread_mutex_unlock (&se->rxlock);
+    (void) pthread_mutex_unlock (&se->txlock);
+
+    free (tr);
+
+    return (status);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_gettxstamps (sockfd, tsv, vlen, mode)
+* 
+* Description:
+*	net_gettxstamps() returns the transmit timestamps of up to vlen
+*	messages sent on a socket with NET_TS_TX enabled (see
+*	net_settstamp()), oldest first.  For each message, tsv[i] holds
+*	its sequence number (see net_sethdrver()), the time it was given
+*	to the send call and the time the kernel handed it to the device,
+*	both CLOCK_REALTIME.  Their difference is the time spent in the
+*	sender's protocol stack.
+*
+*	If mode is BLOCKING and no timestamp has been collected yet,
+*	net_gettxstamps() waits for at least one, unless no message is
+*	awaiting its timestamp.  If mode is NON_BLOCKING, it collects only
+*	the timestamps already queued.
+*
+* Return Values:
+*	On success, net_gettxstamps() returns the number of timestamps
+*	returned in tsv, possibly zero.
+*
+*	On failure, it returns:
+*
+*	NBADFD		when sockfd is not a valid TCP socket descriptor.
+*
+*	NBADADDR	when tsv is not a valid pointer.
+*
+*	NBADLENGTH	when vlen is less than one.
+*
+*	NBADMODE	when the mode is not a valid I/O mode, or NET_TS_TX
+*			is not enabled on the socket.
+*
+*	ERROR		on a system call error, with errno containing the
+*			error indication.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	Messages written by the same system call share a timestamp.  The
+*	timestamps of the last NET_TS_RING messages are kept; older ones
+*	are dropped if net_gettxstamps() is not called often enough.  As
+*	with net_zc_wait(), a socket with queued timestamps polls readable
+*	with POLLERR, and net_zc_wait() keeps those it collects.
+* 
+*************************************************************************** */
+#endif
+
+int net_gettxstamps (sockfd, tsv, vlen, mode)
+int sockfd;				/* endpoint socket descriptor */
+net_txstamp *tsv;			/* returned timestamps */
+int vlen;				/* number of entries of tsv */
+io_mode mode;				/* wait I/O mode */
+{
+    sockfd_entry *se;			/* socket table entry */
+    net_txring *tr;			/* messages awaiting a stamp */
+    int n;				/* number of timestamps returned */
+    int status;				/* return status */
+
+    /* validate parameters */
+
+    if (sockfd < 0 || sockfd >= NET_MAX_FD ||
+				    NET_TYPE (sockfd) != TCP)
+	return NBADFD;
+
+    if (tsv == (net_txstamp *) NULL)
+	return NBADADDR;
+
+    if (vlen < 1)
+	return NBADLENGTH;
+
+    if (mode != BLOCKING && mode != NON_BLOCKING)
+	return NBADMODE;
+
+    se = &net_sockfd[sockfd];
+
+    (void) pthread_mutex_lock (&se->txlock);
+
+    for (;;) {
+	if ((tr = se->txring) == NULL) {
+	    status = NBADMODE;
+	    break;
+	}
+
+	/* collect what the kernel has queued */
+
+	while ((status = net_errqueue (sockfd, (int *) NULL)) > 0)
+	    ;
+
+	if (status < 0 || mode == NON_BLOCKING ||
+			    tr->ready != tr->head || tr->ready == tr->tail)
+	    break;
+
+	/* let other threads send while waiting */
+
+	(void) pthread_mutex_unlock (&se->txlock);
+	status = net_wait (sockfd, 0, &net_forever, (int *) NULL);
+	(void) pthread_mutex_lock (&se->txlock);
+
+	if (status < 0)
+	    break;
+    }
+
+    if (status >= 0) {
+	for (n = 0; n < vlen && tr->head != tr->ready; n++)
+	    tsv[n] = tr->ts[tr->head++ % NET_TS_RING];
+	status = n;
+    }
+
+    (void) pthread_mutex_unlock (&se->txlock);
+
+    return (status);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_setqueue (sockfd, depth, policy)
+* 
+* Description:
+*	net_setqueue() gives a connected TCP socket an outbound queue of
+*	up to depth messages.  A NON_BLOCKING send that finds the socket
+*	unable to take the message, because it is full or still holds
+*	the rest of an earlier message, then queues a copy of the message
+*	instead of returning NWOULDBLOCK.  The queued messages are sent,
+*	in order, as the socket drains: by net_flush(), which should be
+*	called whenever the socket becomes writable while net_pending()
+*	is non-zero, or ahead of the next message sent.
+*
+*	When the queue is full, the policy decides:
+*
+*	NET_Q_DROP_OLDEST	the oldest queued message is discarded to
+*				make room for the new one.
+*
+*	NET_Q_DROP_NEWEST	the new message is refused; the send
+*				returns NWOULDBLOCK.
+*
+*	NET_Q_DISCONNECT	the queue is discarded and the connection
+*				shut down; the send returns NEOF, and the
+*				peer sees end of file.
+*
+*	A depth of 0 removes the queue; messages already queued are
+*	still sent.
+*
+* Return Values:
+*	net_setqueue() returns SUCCESS on success.
+*
+*	On failure, it returns:
+*
+*	NBADFD		when sockfd is not a valid TCP socket descriptor.
+*
+*	NBADLENGTH	when depth is negative.
+*
+*	NBADMODE	when policy is not one of the values above.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	Each queued message is copied once, and framed with its internal
+*	header only when it is about to be written, so a message dropped
+*	from the queue takes no sequence number.
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	Blocking and timed sends wait as before and are never queued.
+* 
+*************************************************************************** */
+#endif
+
+int net_setqueue (sockfd, depth, policy)
+int sockfd;				/* endpoint socket descriptor */
+int depth;				/* most messages queued, 0 for none */
+int policy;				/* overflow policy */
+{
+    /* validate parameters */
+
+    if (sockfd < 0 || sockfd >= NET_MAX_FD || NET_TYPE (sockfd) != TCP)
+	return NBADFD;
+
+    if (depth < 0)
+	return NBADLENGTH;
+
+    if (policy != NET_Q_DROP_OLDEST && policy != NET_Q_DROP_NEWEST &&
+					policy != NET_Q_DISCONNECT)
+	return NBADMODE;
+
+    (void) pthread_mutex_lock (&net_sockfd[sockfd].txlock);
+
+    net_sockfd[sockfd].txqinfo.depth  = depth;
+    net_sockfd[sockfd].txqinfo.policy = policy;
+
+    (void) pthread_mutex_unlock (&net_sockfd[sockfd].txlock);
+
+    return (0);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_getqueue (sockfd, info)
+* 
+* Description:
+*	net_getqueue() copies into the net_txqinfo structure pointed to
+*	by info the outbound queue settings of a socket (see
+*	net_setqueue()) and its counters:
+*
+*	queued		the number of messages queued now.
+*
+*	hiwat		the highest number of messages ever queued.
+*
+*	ndropped	the number of messages discarded on overflow, or
+*			refused under NET_Q_DROP_NEWEST.
+*
+* Return Values:
+*	net_getqueue() returns SUCCESS on success.
+*
+*	On failure, it returns:
+*
+*	NBADFD		when sockfd is not a valid socket descriptor.
+*
+*	NBADADDR	when info is not a valid pointer.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	None.
+* 
+*************************************************************************** */
+#endif
+
+int net_getqueue (sockfd, info)
+int sockfd;				/* endpoint socket descriptor */
+net_txqinfo *info;			/* returned queue state */
+{
+    /* validate parameters */
+
+    if (sockfd < 0 || sockfd >= NET_MAX_FD ||
+				    NET_TYPE (sockfd) == UNDEF)
+	return NBADFD;
+
+    if (info == (net_txqinfo *) NULL)
+	return NBADADDR;
+
+    (void) pthread_mutex_lock (&net_sockfd[sockfd].txlock);
+
+    *info = net_sockfd[sockfd].txqinfo;
+
+    (void) pthread_mutex_unlock (&net_sockfd[sockfd].txlock);
+
+    return (0);
+}
+
+/* ***************************************************************************
+*
+* net_txqueue() appends a copy of a message, gathered from iov, to the
+* outbound queue of a socket, applying the socket's overflow policy when the
+* queue is full.  It returns length once the message is queued, NWOULDBLOCK
+* when it is refused, NEOF when the connection has been shut down, or ERROR
+* when no memory is left.  The caller holds the send lock.
+*
+*************************************************************************** */
+
+static int net_txqueue (sockfd, iov, iovcnt, length)
+int sockfd;				/* endpoint socket descriptor */
+struct iovec *iov;			/* message buffers */
+int iovcnt;				/* number of buffers */
+int length;				/* message length in bytes */
+{
+    sockfd_entry *se = &net_sockfd[sockfd];
+    net_txqinfo *qi = &se->txqinfo;
+    net_txbuf *tb;			/* queued message */
+    int i;				/* loop index */
+
+    /* make room according to the policy */
+
+    if (qi->queued >= qi->depth) {
+	if (qi->policy == NET_Q_DROP_NEWEST) {
+	    qi->ndropped++;
+	    return NWOULDBLOCK;
+	}
+
+	if (qi->policy == NET_Q_DISCONNECT) {
+	    qi->ndropped += qi->queued + 1;
+	    net_txq_free (sockfd);
+	    (void) shutdown (sockfd, SHUT_RDWR);
+	    return NEOF;
+	}
+
+	while (qi->queued >= qi->depth && (tb = se->txq) != NULL) {
+	    if ((se->txq = tb->next) == NULL)
+		se->txq_last = NULL;
+	    free (tb->base);
+	    free (tb);
+	    qi->queued--;
+	    qi->ndropped++;
+	}
+    }
+
+    /* leave room ahead of the message for its header */
+
+    if ((tb = malloc (sizeof (net_txbuf))) == NULL)
+	return ERROR;
+
+    if ((tb->base = malloc (sizeof (struct msg_hdr_v2) + length)) == NULL) {
+	free (tb);
+	return ERROR;
+    }
+
+    tb->head = tb->tail = sizeof (struct msg_hdr_v2);
+    for (i = 0; i < iovcnt; i++) {
+	(void) memcpy (tb->base + tb->tail, iov[i].iov_base, iov[i].iov_len);
+	tb->tail += iov[i].iov_len;
+    }
+    tb->next = NULL;
+
+    if (se->txq_last != NULL)
+	se->txq_last->next = tb;
+    else
+	se->txq = tb;
+    se->txq_last = tb;
+
+    if (++qi->queued > qi->hiwat)
+	qi->hiwat = qi->queued;
+
+    return (length);
+}
+
+/* ***************************************************************************
+*
+* net_txq_next() moves the oldest queued message of a socket, framed with
+* its internal header, to the empty transmit buffer, and returns it, or NULL
+* if the queue is empty.  The caller holds the send lock.
+*
+*************************************************************************** */
+
+static net_txbuf *net_txq_next (sockfd)
+int sockfd;				/* endpoint socket descriptor */
+{
+    sockfd_entry *se = &net_sockfd[sockfd];
+    struct msg_hdr_v2 msg_hdr;		/* internal message header */
+    net_txbuf *tb;			/* next message */
+    int length;				/* its length in bytes */
+    int hlen;				/* header length in bytes */
+
+    if ((tb = se->txq) == NULL)
+	return NULL;
+
+    if ((se->txq = tb->next) == NULL)
+	se->txq_last = NULL;
+    tb->next = NULL;
+    se->txqinfo.queued--;
+
+    length = tb->tail - tb->head;
+    hlen = net_hdr_make (sockfd, length, &msg_hdr);
+    tb->head -= hlen;
+    (void) memcpy (tb->base + tb->head, &msg_hdr, hlen);
+
+    se->txbuf = tb;
+    net_txdone (sockfd, hlen + length);
+
+    return tb;
+}
+
+/* ***************************************************************************
+*
+* net_txq_free() discards the messages queued on a socket.
+*
+*************************************************************************** */
+
+static void net_txq_free (sockfd)
+int sockfd;				/* endpoint socket descriptor */
+{
+    sockfd_entry *se = &net_sockfd[sockfd];
+    net_txbuf *tb;			/* queued message */
+
+    while ((tb = se->txq) != NULL) {
+	se->txq = tb->next;
+	free (tb->base);
+	free (tb);
+    }
+    se->txq_last = NULL;
+    se->txqinfo.queued = 0;
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_hdr_make (sockfd, length, hdr)
+* 
+* Description:
+*	net_hdr_make() fills in hdr with the internal header of the next
+*	message of length bytes to be sent on a socket, in the version
+*	selected for it (see net_sethdrver()).  A version 2 header
+*	carries the socket's next sequence number and the current time.
+*	The caller holds the send lock of the socket and, once the message
+*	has been accepted, calls net_txdone().
+*
+* Return Values:
+*	net_hdr_make() returns the header length in bytes.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	This is an internal function of the network services.
+* 
+*************************************************************************** */
+#endif
+
+int net_hdr_make (sockfd, length, hdr)
+int sockfd;				/* endpoint socket descriptor */
+int length;				/* message length in bytes */
+struct msg_hdr_v2 *hdr;			/* returned internal header */
+{
+    sockfd_entry *se = &net_sockfd[sockfd];
+    struct timespec now;		/* send time */
+
+    hdr->msg_len = htonl (length);
+
+    /* a transmit timestamp is reported with the send time */
+
+    if (se->txring != NULL)
+	(void) clock_gettime (CLOCK_REALTIME, &se->tx_time);
+
+    if (se->hdrver == NET_HDR_V1 || (se->hdrver == NET_HDR_AUTO &&
+			!__atomic_load_n (&se->peer_v2, __ATOMIC_RELAXED))) {
+	hdr->hdr_id = htonl (NET_HDR_ID);
+	return sizeof (struct msg_hdr_dcl);
+    }
+
+    if (se->txring != NULL)
+	now = se->tx_time;
+    else
+	(void) clock_gettime (CLOCK_REALTIME, &now);
+
+    hdr->hdr_id  = htonl (NET_HDR_ID_V2);
+    hdr->seq_no  = htonl (se->tx_seq);
+    hdr->ts_sec  = htonl ((unsigned) now.tv_sec);
+    hdr->ts_nsec = htonl ((unsigned) now.tv_nsec);
+    hdr->spare   = 0;
+
+    return sizeof (struct msg_hdr_v2);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	void net_txdone (sockfd, nbytes)
+* 
+* Description:
+*	net_txdone() accounts for a message of nbytes, header included,
+*	that has been accepted for sending on a socket: whether written
+*	in full or kept in part in the transmit buffer.  It advances the
+*	sequence number of the socket and, while transmit timestamps are
+*	enabled, queues the message to be stamped by the kernel (see
+*	net_gettxstamps()).  The caller holds the send lock.
+*
+* Return Values:
+*	None.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	This is an internal function of the network services.
+* 
+*************************************************************************** */
+#endif
+
+void net_txdone (sockfd, nbytes)
+int sockfd;				/* endpoint socket descriptor */
+int nbytes;				/* message length on the stream */
+{
+    sockfd_entry *se = &net_sockfd[sockfd];
+    net_txring *tr = se->txring;	/* messages awaiting a stamp */
+    unsigned i;				/* ring entry of the message */
+
+    if (tr != NULL) {
+
+	/* a ring that is not collected drops its oldest message */
+
+	if (tr->tail - tr->head == NET_TS_RING) {
+	    if (tr->ready == tr->head)
+		tr->ready++;
+	    tr->head++;
+	}
+
+	se->tx_off += nbytes;
+
+	i = tr->tail++ % NET_TS_RING;
+	tr->end[i]	       = se->tx_off;
+	tr->ts[i].seq_no       = se->tx_seq;
+	tr->ts[i].sent	       = se->tx_time;
+	tr->ts[i].kernel.tv_sec  = 0;
+	tr->ts[i].kernel.tv_nsec = 0;
+    }
+    se->tx_seq++;
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_send_zc (sockfd, msg, length, mode)
+* 
+* Description:
+*	net_send_zc() sends a large message to a connected endpoint like
+*	net_send(), but without copying the message into the kernel: the
+*	pages of msg are handed to the network stack with MSG_ZEROCOPY and
+*	read again as the data goes out on the wire.  The caller must
+*	therefore not modify or free msg until the kernel has reported
+*	the send complete, which net_zc_wait() collects.
+*
+*	Messages shorter than NET_ZC_MIN_LEN bytes, and all messages on a
+*	system without zero-copy support, are sent with net_send(), so
+*	net_send_zc() can be used for every message of a bulk stream.
+*
+*	A NON_BLOCKING net_send_zc() never waits.  If only part of the
+*	message can be sent immediately, the rest of it is copied and
+*	kept with the socket, as described for net_send().
+*
+* Return Values:
+*	Same as net_send().
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	The internal message header is copied and corked with MSG_MORE,
+*	so that it leaves together with the first zero-copy segment.
+*	Zero-copy saves the copy of the message at the cost of page
+*	pinning and one completion notification per send, and so only
+*	pays off for messages of some ten kilobytes and more.  On the
+*	loopback interface the kernel still copies the data (see
+*	net_zc_wait()).
+*
+* Portability:
+*	MSG_ZEROCOPY requires Linux 4.14 or later.
+*
+* Notes:
+*	The message header is not sent zero-copy since it lives on the
+*	stack of net_send_zc().  If the kernel runs short of memory for
+*	completion notifications, the rest of the message is copied.
+* 
+*************************************************************************** */
+#endif
+
+int net_send_zc (sockfd, msg, length, mode)
+int sockfd;				/* endpoint socket descriptor */
+char *msg;				/* message to be sent */
+int length;				/* message length in bytes */
+io_mode mode;				/* send I/O mode */
+{
+    int zc;				/* zero-copy usable */
+    int status;				/* return status */
+
+    /* validate socket descriptor */
+
+    if (sockfd < 0 || sockfd >= NET_MAX_FD ||
+				    NET_TYPE (sockfd) != TCP)
+	return NBADFD;
+
+    /* validate msg pointer and length */
+
+    if (msg == (char *) NULL)
+	return NBADADDR;
+
+    if (length < NET_MIN_MSG_LEN || length > NET_MAX_MSG_LEN)
+	return NBADLENGTH;
+
+    /* validate socket I/O mode */
+
+    if (mode != BLOCKING && mode != NON_BLOCKING)
+	return NBADMODE;
+
+    if (length < NET_ZC_MIN_LEN)
+	return net_send (sockfd, msg, length, mode);
+
+    (void) pthread_mutex_lock (&net_sockfd[sockfd].txlock);
+
+    if ((zc = net_zc_enable (sockfd)) == SUCCESS)
+	status = net_sendzc (sockfd, msg, length, NET_MODE_DEADLINE (mode));
+
+    (void) pthread_mutex_unlock (&net_sockfd[sockfd].txlock);
+
+    /* without zero-copy support, send a copy */
+
+    if (zc != SUCCESS)
+	status = net_send (sockfd, msg, length, mode);
+
+    return (status);
+}
+
+/* ***************************************************************************
+*
+* net_sendzc() does the work of net_send_zc() once zero-copy is enabled on
+* the socket, with the send lock held.  If deadline is NULL, it never
+* waits; otherwise it waits for the socket to become writable.
+*
+*************************************************************************** */
+
+static int net_sendzc (sockfd, msg, length, deadline)
+int sockfd;				/* endpoint socket descriptor */
+char *msg;				/* message to be sent */
+int length;				/* message length in bytes */
+struct timespec *deadline;		/* time limit, NULL if none */
+{
+    struct msg_hdr_v2 msg_hdr;		/* internal message header */
+    struct iovec iov[2];		/* header and user's message */
+    int hlen;				/* header length in bytes */
+    int i;				/* buffer being sent */
+    int zcflag;				/* MSG_ZEROCOPY while it is usable */
+    int nwritten;			/* number of bytes written */
+    int ntotal;				/* total bytes written */
+    int status;				/* return status */
+
+    /* finish sending an earlier message first to keep the stream in sync */
+
+    if (net_sockfd[sockfd].txbuf != NULL) {
+	if ((status = net_txflush (sockfd, deadline)) < 0)
+	    return (status == ERROR && errno == EPIPE) ? NEOF : status;
+	else if (status > 0)
+	    return NWOULDBLOCK;
+    }
+
+    hlen = net_hdr_make (sockfd, length, &msg_hdr);
+    iov[0].iov_base = (char *) &msg_hdr;
+    iov[0].iov_len  = hlen;
+    iov[1].iov_base = msg;
+    iov[1].iov_len  = length;
+
+    zcflag = MSG_ZEROCOPY;
+    ntotal = 0;
+    i = 0;
+
+    while (i < 2) {
+
+	nwritten = send (sockfd, iov[i].iov_base, iov[i].iov_len,
+				((i == 0) ? MSG_MORE : zcflag) |
+				NET_IOFLAGS (deadline));
+
+	if (nwritten == ERROR) {
+	    if (errno == EINTR) {
+		errno = 0;
+		continue;
+	    }
+
+	    /* out of notification memory: copy the rest */
+
+	    else if (errno == ENOBUFS && i == 1 && zcflag != 0) {
+		zcflag = 0;
+		continue;
+	    }
+	    else if (errno == EWOULDBLOCK) {
+
+		if (deadline != NULL) {
+		    if ((status = net_wait (sockfd, POLLOUT, deadline,
+						    (int *) NULL)) < 0)
+			return status;
+		    continue;
+		}
+
+		/* nothing sent yet, so the stream is still in sync */
+
+		if (ntotal == 0)
+		    return NWOULDBLOCK;
+
+		/* otherwise keep a copy of the rest for later */
+
+		if (net_txsave (sockfd, iov + i, 2 - i) < 0)
+		    return ERROR;
+
+		net_txdone (sockfd, hlen + length);
+		return (length);
+	    }
+
+	    /* if broken pipe, return NEOF */
+	    else if (errno == EPIPE)
+		return NEOF;
+
+	    else
+		return ERROR;
+	}
+
+	if (i == 1 && zcflag != 0)
+	    net_sockfd[sockfd].zc_sent++;
+
+	ntotal += nwritten;
+	iov[i].iov_base = (char *) iov[i].iov_base + nwritten;
+	iov[i].iov_len -= nwritten;
+	if (iov[i].iov_len == 0)
+	    i++;
+    }
+    net_txdone (sockfd, hlen + length);
+
+    return (length);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_zc_wait (sockfd, mode, ncopiedp)
+* 
+* Description:
+*	net_zc_wait() collects the completion notifications of earlier
+*	net_send_zc() calls from the error queue of a socket.  Once a
+*	send is complete, the kernel no longer refers to its message
+*	buffer, which may then be reused or freed.  Sends complete in the
+*	order they were issued.
+*
+*	If mode is BLOCKING, net_zc_wait() returns once all sends issued
+*	on the socket are complete.  If mode is NON_BLOCKING, it collects
+*	only the notifications already queued.
+*
+*	If ncopiedp is not NULL, the number of collected sends for which
+*	the kernel fell back to copying the data is added to *ncopiedp.
+*
+* Return Values:
+*	On success, net_zc_wait() returns the number of zero-copy sends
+*	still outstanding, zero once all are complete.
+*
+*	On failure, it returns:
+*
+*	NBADFD		when sockfd is not a valid TCP socket descriptor.
+*
+*	NBADMODE	when the mode is not a valid I/O mode.
+*
+*	ERROR		on a system call error, with errno containing the
+*			error indication.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	The kernel merges the notifications of consecutive sends, so a
+*	single recvmsg() usually completes many of them.
+*
+* Portability:
+*	MSG_ZEROCOPY requires Linux 4.14 or later.
+*
+* Notes:
+*	A socket with queued notifications polls readable with POLLERR;
+*	a select()-based application should call net_zc_wait() with
+*	NON_BLOCKING when such a socket has no message to receive.  The
+*	copy fallback (SO_EE_CODE_ZEROCOPY_COPIED) is always taken on the
+*	loopback interface.
+* 
+*************************************************************************** */
+#endif
+
+int net_zc_wait (sockfd, mode, ncopiedp)
+int sockfd;				/* endpoint socket descriptor */
+io_mode mode;				/* wait I/O mode */
+int *ncopiedp;				/* sends copied by the kernel */
+{
+    sockfd_entry *se;			/* socket table entry */
+    int status;				/* return status */
+
+    /* validate socket descriptor */
+
+    if (sockfd < 0 || sockfd >= NET_MAX_FD ||
+				    NET_TYPE (sockfd) != TCP)
+	return NBADFD;
+
+    if (mode != BLOCKING && mode != NON_BLOCKING)
+	return NBADMODE;
+
+    se = &net_sockfd[sockfd];
+    status = SUCCESS;
+
+    /* the counters are shared with net_send_zc() */
+
+    (void) pthread_mutex_lock (&se->txlock);
+
+    while (se->zc_done != se->zc_sent) {
+
+	if ((status = net_errqueue (sockfd, ncopiedp)) < 0)
+	    break;
+
+	if (status > 0)
+	    continue;
+
+	if (mode == NON_BLOCKING)
+	    break;
+
+	/* an error queue entry is signalled as POLLERR; let other
+	   threads send while waiting for it */
+
+	(void) pthread_mutex_unlock (&se->txlock);
+	status = net_wait (sockfd, 0, &net_forever, (int *) NULL);
+	(void) pthread_mutex_lock (&se->txlock);
+
+	if (status < 0)
+	    break;
+    }
+    if (status >= 0)
+	status = (int) (se->zc_sent - se->zc_done);
+
+    (void) pthread_mutex_unlock (&se->txlock);
+
+    return (status);
+}
+
+/* ***************************************************************************
+*
+* net_errqueue() reads one entry from the error queue of a socket and
+* accounts for it: a zero-copy completion for net_zc_wait(), or a transmit
+* timestamp for net_gettxstamps(), which stamps every message written up
+* to the byte it is keyed by.  It returns 1 if an entry was read, 0 if the
+* queue is empty, or ERROR.  The caller holds the send lock.
+*
+*************************************************************************** */
+
+static int net_errqueue (sockfd, ncopiedp)
+int sockfd;				/* endpoint socket descriptor */
+int *ncopiedp;				/* sends copied by the kernel */
+{
+    sockfd_entry *se = &net_sockfd[sockfd];
+    net_txring *tr;			/* messages awaiting a stamp */
+    struct msghdr msg;			/* error queue message */
+    struct cmsghdr *cm;			/* control message */
+    struct sock_extended_err *ee;	/* extended error */
+    struct scm_timestamping *tss;	/* timestamps of the entry */
+    struct timespec *kts;		/* timestamp reported */
+    char control[256];			/* control message buffer */
+    unsigned n;				/* number of sends completed */
+
+    for (;;) {
+	(void) memset (&msg, 0, sizeof (msg));
+	msg.msg_control    = control;
+	msg.msg_controllen = sizeof (control);
+
+	if (recvmsg (sockfd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) != ERROR)
+	    break;
+
+	if (errno == EWOULDBLOCK)
+	    return (0);
+
+	if (errno != EINTR)
+	    return ERROR;
+	errno = 0;
+    }
+
+    ee  = NULL;
+    tss = NULL;
+
+    for (cm = CMSG_FIRSTHDR (&msg); cm != NULL; cm = CMSG_NXTHDR (&msg, cm)) {
+	if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMPING)
+	    tss = (struct scm_timestamping *) CMSG_DATA (cm);
+
+	else if ((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+	         (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+	    ee = (struct sock_extended_err *) CMSG_DATA (cm);
+    }
+
+    if (ee == NULL)
+	return (1);
+
+    /* notification covers sends ee_info through ee_data */
+
+    if (ee->ee_errno == 0 && ee->ee_origin == SO_EE_ORIGIN_ZEROCOPY) {
+	n = ee->ee_data - ee->ee_info + 1;
+	se->zc_done += n;
+
+	if (ncopiedp != NULL && (ee->ee_code & SO_EE_CODE_ZEROCOPY_COPIED))
+	    *ncopiedp += n;
+    }
+
+    /* timestamp of the data up to stream offset ee_data; the hardware
+       one is in ts[2], the software one in ts[0] */
+
+    else if (ee->ee_errno == ENOMSG &&
+	     ee->ee_origin == SO_EE_ORIGIN_TIMESTAMPING &&
+	     tss != NULL && (tr = se->txring) != NULL) {
+	kts = (tss->ts[2].tv_sec != 0 || tss->ts[2].tv_nsec != 0) ?
+						    &tss->ts[2] : &tss->ts[0];
+
+	while (tr->ready != tr->tail &&
+		(int) (tr->end[tr->ready % NET_TS_RING] - 1 - ee->ee_data) <= 0)
+	    tr->ts[tr->ready++ % NET_TS_RING].kernel = *kts;
+    }
+
+    return (1);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_sendfile (sockfd, filefd, offset, length, mode)
+* 
+* Description:
+*	net_sendfile() sends length bytes of the file open on filefd,
+*	starting at byte offset, as one message to a connected endpoint.
+*	The receiver gets an ordinary message, as if it had been sent by
+*	net_send().  The data goes from the page cache to the socket with
+*	sendfile(), without passing through a user buffer.  The file
+*	offset of filefd is not changed.
+*
+*	A NON_BLOCKING net_sendfile() never waits.  If only part of the
+*	message can be sent immediately, the rest of it is read from the
+*	file and kept with the socket, as described for net_send().
+*
+* Return Values:
+*	On success, net_sendfile() returns the number of bytes sent.  If
+*	a broken connection condition is detected, net_sendfile() will
+*	return NEOF.
+*
+*	On failure, it returns:
+*
+*	NBADFD		when sockfd is not a valid TCP socket descriptor
+*			or filefd is not an open file.
+*
+*	NBADLENGTH	when the requested message length either exceeds
+*			the maximum length allowed or is less than the
+*			minimum required, or the file ends before offset
+*			plus length.
+*
+*	NBADMODE	when the mode is not a valid I/O mode.
+*
+*	NWOULDBLOCK	when the I/O mode is NON_BLOCKING and no part of
+*			the message could be sent immediately, or the rest
+*			of an earlier message is still pending.  The
+*			message has not been sent.
+*
+*	ERROR		on a system call error, with errno containing the
+*			error indication.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	The internal message header is corked with MSG_MORE, so that it
+*	leaves together with the first file segment.
+*
+* Portability:
+*	sendfile() to a socket requires Linux 2.6.33 or later.
+*
+* Notes:
+*	sendfile() splices the file pages to the socket within the
+*	kernel, so no separate splice() path through a pipe is needed.
+*	The file must not be truncated while it is being sent; if it is,
+*	net_sendfile() returns ERROR with errno EIO and the connection is
+*	out of sync.  Since sendfile() takes no flags, net_sendfile() sets
+*	the I/O mode of the socket itself (see net_setiomode()).
+* 
+*************************************************************************** */
+#endif
+
+int net_sendfile (sockfd, filefd, offset, length, mode)
+int sockfd;				/* endpoint socket descriptor */
+int filefd;				/* file to be sent */
+off_t offset;				/* file offset of message */
+int length;				/* message length in bytes */
+io_mode mode;				/* send I/O mode */
+{
+    struct stat st;			/* file status */
+    int status;				/* return status */
+
+    /* validate socket and file descriptors */
+
+    if (sockfd < 0 || sockfd >= NET_MAX_FD ||
+				    NET_TYPE (sockfd) != TCP)
+	return NBADFD;
+
+    if (fstat (filefd, &st) == ERROR)
+	return NBADFD;
+
+    /* validate msg length */
+
+    if (length < NET_MIN_MSG_LEN || length > NET_MAX_MSG_LEN ||
+				offset < 0 || offset + length > st.st_size)
+	return NBADLENGTH;
+
+    /* validate and set socket I/O mode; sendfile() takes no flags */
+
+    if (mode != BLOCKING && mode != NON_BLOCKING)
+	return NBADMODE;
+
+    if ((status = net_setiomode (sockfd, mode)) < 0)
+	return status;
+
+    (void) pthread_mutex_lock (&net_sockfd[sockfd].txlock);
+
+    status = net_sendfmsg (sockfd, filefd, offset, length,
+						NET_MODE_DEADLINE (mode));
+
+    (void) pthread_mutex_unlock (&net_sockfd[sockfd].txlock);
+
+    return (status);
+}
+
+/* ***************************************************************************
+*
+* net_sendfmsg() does the work of net_sendfile() with the send lock held.
+* If deadline is NULL, it never waits; otherwise it waits for the socket
+* to become writable, which it may have to if another thread changed the
+* I/O mode of the socket in the meantime.
+*
+*************************************************************************** */
+
+static int net_sendfmsg (sockfd, filefd, offset, length, deadline)
+int sockfd;				/* endpoint socket descriptor */
+int filefd;				/* file to be sent */
+off_t offset;				/* file offset of message */
+int length;				/* message length in bytes */
+struct timespec *deadline;		/* time limit, NULL if none */
+{
+    struct msg_hdr_v2 msg_hdr;		/* internal message header */
+    int hlen;				/* header length in bytes */
+    int nhdr;				/* header bytes written */
+    int nbody;				/* file bytes written */
+    int nwritten;			/* number of bytes written */
+    int status;				/* return status */
+
+    /* finish sending an earlier message first to keep the stream in sync */
+
+    if (net_sockfd[sockfd].txbuf != NULL) {
+	if ((status = net_txflush (sockfd, deadline)) < 0)
+	    return (status == ERROR && errno == EPIPE) ? NEOF : status;
+	else if (status > 0)
+	    return NWOULDBLOCK;
+    }
+
+    hlen = net_hdr_make (sockfd, length, &msg_hdr);
+
+    nhdr = nbody = 0;
+
+    while (nbody < length) {
+
+	if (nhdr < hlen)
+	    nwritten = send (sockfd, (char *) &msg_hdr + nhdr, hlen - nhdr,
+				    MSG_MORE | NET_IOFLAGS (deadline));
+	else
+	    nwritten = sendfile (sockfd, filefd, &offset, length - nbody);
+
+	if (nwritten == ERROR) {
+	    if (errno == EINTR) {
+		errno = 0;
+		continue;
+	    }
+	    else if (errno == EWOULDBLOCK) {
+
+		if (deadline != NULL) {
+		    if ((status = net_wait (sockfd, POLLOUT, deadline,
+						    (int *) NULL)) < 0)
+			return status;
+		    continue;
+		}
+
+		/* nothing sent yet, so the stream is still in sync */
+
+		if (nhdr == 0)
+		    return NWOULDBLOCK;
+
+		/* otherwise keep the rest of the message for later */
+
+		if (net_txsave_file (sockfd, (char *) &msg_hdr + nhdr,
+			    hlen - nhdr, filefd, offset, length - nbody) < 0)
+		    return ERROR;
+
+		net_txdone (sockfd, hlen + length);
+		return (length);
+	    }
+
+	    /* if broken pipe, return NEOF */
+	    else if (errno == EPIPE)
+		return NEOF;
+
+	    else
+		return ERROR;
+	}
+
+	/* the file was truncated under us */
+
+	else if (nwritten == 0) {
+	    errno = EIO;
+	    return ERROR;
+	}
+
+	if (nhdr < hlen)
+	    nhdr += nwritten;
+	else
+	    nbody += nwritten;
+    }
+    net_txdone (sockfd, hlen + length);
+
+    return (length);
+}
+
+/* ***************************************************************************
+*
+* net_txsave_file() saves the rest of a message partially sent by
+* net_sendfile(), nhdr bytes of header followed by nbytes of the file at
+* offset, in the transmit buffer of a socket.
+*
+*************************************************************************** */
+
+static int net_txsave_file (sockfd, hdr, nhdr, filefd, offset, nbytes)
+int sockfd;				/* endpoint socket descriptor */
+char *hdr;				/* unwritten header bytes */
+int nhdr;				/* number of header bytes */
+int filefd;				/* file being sent */
+off_t offset;				/* file offset of unwritten bytes */
+int nbytes;				/* number of file bytes */
+{
+    struct iovec iov[2];		/* rest of header and file data */
+    char *data;				/* file data */
+    int nread;				/* number of bytes read */
+    int status;				/* return status */
+
+    if ((data = malloc (nbytes)) == NULL)
+	return ERROR;
+
+    for (nread = 0; nread < nbytes; nread += status) {
+	status = pread (filefd, data + nread, nbytes - nread,
+						    offset + nread);
+	if (status == ERROR && errno == EINTR)
+	    status = 0;
+	else if (status <= 0) {
+	    if (status == 0)
+		errno = EIO;
+	    free (data);
+	    return ERROR;
+	}
+    }
+
+    iov[0].iov_base = hdr;
+    iov[0].iov_len  = nhdr;
+    iov[1].iov_base = data;
+    iov[1].iov_len  = nbytes;
+
+    status = net_txsave (sockfd, iov, 2);
+
+    free (data);
+
+    return status;
+}
+
+/* ***************************************************************************
+*
+* net_zc_enable() turns on SO_ZEROCOPY for a socket the first time it is
+* asked to, and returns SUCCESS if zero-copy sends can be used on it.
+*
+*************************************************************************** */
+
+static int net_zc_enable (sockfd)
+int sockfd;				/* endpoint socket descriptor */
+{
+    int on = 1;				/* option value */
+
+    if (net_sockfd[sockfd].zcopy == 0)
+	net_sockfd[sockfd].zcopy = (setsockopt (sockfd, SOL_SOCKET,
+		SO_ZEROCOPY, (char *) &on, sizeof (on)) == ERROR) ? ERROR : 1;
+
+    return (net_sockfd[sockfd].zcopy == 1) ? SUCCESS : ERROR;
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_recv (sockfd, buff, maxlen, mode)
+* 
+* Description:
+*	net_recv() receives a message from a connected endpoint in a
+*	connection-oriented communication.  net_recv() preserves message
+*	boundaries between the sender and receiver.  The received message
+*	will be placed into the array buff for up to maxlen bytes.  If the
+*	message is too long to fit in the supplied buffer, it will be
+*	truncated and the excess bytes discarded.
+*
+* Return Values:
+*	On success, net_recv() returns the number of bytes received.  If a
+*	broken connection condition is detected, net_recv() will return
+*	NEOF.
+*
+*	On failure, it returns:
+*
+*	NBADFD		when sockfd is not a valid socket descriptor.
+*
+*	NBADADDR	when the buffer pointer is not a valid pointer.
+*
+*	NBADLENGTH	when the requested message length is less than
+*			the minimum length required.
+*
+*	NBADMODE	when the mode is not a valid I/O mode.
+*
+*	NSYNCERR	when the incoming message boundaries are out of
+*			sync.
+*
+*	NWOULDBLOCK	when the I/O mode is NON_BLOCKING and no complete
+*			message was available to be received.  Any part of
+*			a message already read is kept for the next call.
+*
+*	ERROR		on a system call error, with errno containing the
+*			error indication.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	None.
+* 
+*************************************************************************** */
+#endif
+
+int net_recv (sockfd, buff, maxlen, mode)
+int sockfd;				/* endpoint socket descriptor */
+char *buff;				/* buffer area to receive msg into */
+int maxlen;				/* length in bytes of buffer area */
+io_mode mode;				/* receive I/O mode */
+{
+    int status;				/* return status */
+
+    /* validate socket descriptor */
+
+    if (sockfd < 0 || sockfd >= NET_MAX_FD ||
+				    NET_TYPE (sockfd) == UNDEF)
+	return NBADFD;
+
+    /* validate buff pointer */
+
+    if (buff == (char *) NULL)
+	return NBADADDR;
+
+    /* validate buffer length */
+
+    if (maxlen < NET_MIN_MSG_LEN)
+	return NBADLENGTH;
+
+    /* validate socket I/O mode */
+
+    if (mode != BLOCKING && mode != NON_BLOCKING)
+	return NBADMODE;
+
+    /* a UDP datagram is a message by itself */
+
+    if (NET_TYPE (sockfd) == UDP)
+	return net_udp_recvfrom (sockfd, buff, maxlen, NULL, mode);
+
+    (void) pthread_mutex_lock (&net_sockfd[sockfd].rxlock);
+
+    status = net_recvmsg (sockfd, buff, maxlen, NET_MODE_DEADLINE (mode));
+
+    (void) pthread_mutex_unlock (&net_sockfd[sockfd].rxlock);
+
+    return (status);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_recv_timed (sockfd, buff, maxlen, usec)
+* 
+* Description:
+*	net_recv_timed() receives a message from a connected endpoint like
+*	net_recv(), but gives up once usec microseconds have elapsed.
+*	While no data is available, net_recv_timed() waits for the socket
+*	to become readable, and resumes reading as soon as it does.  If
+*	usec is NET_WAIT_FOREVER, there is no deadline.
+*
+* Return Values:
+*	On success, net_recv_timed() returns the number of bytes received.
+*	If a broken connection condition is detected, net_recv_timed()
+*	will return NEOF.
+*
+*	On failure, it returns:
+*
+*	NBADFD		when sockfd is not a valid socket descriptor.
+*
+*	NBADADDR	when the buffer pointer is not a valid pointer.
+*
+*	NBADLENGTH	when the requested message length is less than
+*			the minimum length required.
+*
+*	NBADMODE	when usec is neither positive nor NET_WAIT_FOREVER.
+*
+*	NSYNCERR	when the incoming message boundaries are out of
+*			sync.
+*
+*	NTIMEDOUT	when no complete message was received before the
+*			deadline.  Any part of a message already read is
+*			kept for the next call.
+*
+*	ERROR		on a system call error, with errno containing the
+*			error indication.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	The calling thread never sleeps for longer than it takes the
+*	socket to become readable, nor past the deadline.
+*
+* Portability:
+*	This function uses ppoll().
+*
+* Notes:
+*	None.
+* 
+*************************************************************************** */
+#endif
+
+int net_recv_timed (sockfd, buff, maxlen, usec)
+int sockfd;				/* endpoint socket descriptor */
+char *buff;				/* buffer area to receive msg into */
+int maxlen;				/* length in bytes of buffer area */
+long usec;				/* time limit in microseconds */
+{
+    int status;				/* return status */
+    struct timespec deadline;		/* time limit for the receive */
+
+    /* validate socket descriptor */
+
+    if (sockfd < 0 || sockfd >= NET_MAX_FD ||
+				    NET_TYPE (sockfd) == UNDEF)
+	return NBADFD;
+
+    /* validate buff pointer and length */
+
+    if (buff == (char *) NULL)
+	return NBADADDR;
+
+    if (maxlen < NET_MIN_MSG_LEN)
+	return NBADLENGTH;
+
+    /* validate time limit */
+
+    if (usec <= 0 && usec != NET_WAIT_FOREVER)
+	return NBADMODE;
+
+    net_deadline (&deadline, usec);
+
+    /* a UDP datagram is a message by itself */
+
+    if (NET_TYPE (sockfd) == UDP) {
+	while ((status = net_udp_recvfrom (sockfd, buff, maxlen, NULL,
+					    NON_BLOCKING)) == NWOULDBLOCK)
+	    if ((status = net_wait (sockfd, POLLIN, &deadline,
+						    (int *) NULL)) < 0)
+		return status;
+	return status;
+    }
+
+    (void) pthread_mutex_lock (&net_sockfd[sockfd].rxlock);
+
+    status = net_recvmsg (sockfd, buff, maxlen, &deadline);
+
+    (void) pthread_mutex_unlock (&net_sockfd[sockfd].rxlock);
+
+    return (status);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	static int net_recvmsg (sockfd, buff, maxlen, deadline)
+* 
+* Description:
+*	net_recvmsg() receives the next message from a connected TCP
+*	endpoint into the array buff for up to maxlen bytes, discarding
+*	any excess.  It is called by net_recv() and net_recv_timed() once
+*	the arguments are validated.
+*
+*	If deadline is NULL, a non-blocking receive never waits, as
+*	described for net_recv(); otherwise it waits for the socket to
+*	become readable until the deadline.  Either way, if the receive
+*	stops in the middle of a message, the part already read is kept
+*	(see net_rxstash()) and the next call resumes from it.
+*
+* Return Values:
+*	Same as net_recv(), or net_recv_timed() when a deadline is given.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	None.
+* 
+*************************************************************************** */
+#endif
+
+static int net_recvmsg (sockfd, buff, maxlen, deadline)
+int sockfd;				/* endpoint socket descriptor */
+char *buff;				/* buffer area to receive msg into */
+int maxlen;				/* length in bytes of buffer area */
+struct timespec *deadline;		/* time limit, NULL if none */
+{
+    int status;				/* return status */
+    int nread;				/* number of bytes read */
+    int nleft;				/* remaining bytes to read */
+    int nbytes;				/* number of bytes placed in buff */
+    int nexcess;			/* number of excess bytes */
+    char *bufptr;			/* input buffer pointer */
+    int hlen;				/* header length in bytes */
+    struct msg_hdr_v2 msg_hdr;		/* internal message header */
+
+    /* take message from the receive buffer, if one is attached */
+
+    if (net_sockfd[sockfd].rxbuf != NULL)
+	return net_rxrecv (sockfd, buff, maxlen, deadline);
+
+    /* finish discarding the excess of an earlier message */
+
+    if (net_sockfd[sockfd].rxskip > 0 &&
+			(status = net_rxskip (sockfd, deadline)) <= 0)
+	return status;
+
+    /* read internal message header, version 1 or 2 */
+
+    bufptr = (char *) &msg_hdr;
+    hlen   = sizeof (struct msg_hdr_dcl);
+    nleft  = hlen;
+
+    while (nleft > 0) {
+
+	nread = net_recvts (sockfd, bufptr, nleft, NET_IOFLAGS (deadline));
+
+	if (nread == ERROR) {
+	    if (errno == EINTR) {
+		errno = 0;
+		continue;
+	    }
+	    else if (errno == EWOULDBLOCK) {
+
+		if (deadline == NULL)
+		    status = NWOULDBLOCK;
+		else if ((status = net_wait (sockfd, POLLIN, deadline,
+						    (int *) NULL)) == 0)
+		    continue;
+
+		/* nothing read yet, so the stream is still in sync */
+
+		if (bufptr == (char *) &msg_hdr)
+		    return status;
+
+		/* otherwise keep the partial header for the next call */
+
+		if (net_rxstash (sockfd, (char *) &msg_hdr,
+			    bufptr - (char *) &msg_hdr, buff, 0) < 0)
+		    return ERROR;
+		return status;
+	    }
+	    else
+		return ERROR;
+	}
+	else if (nread == 0)
+	    return NEOF;
+
+	/* update amount read */
+
+	nleft  -= nread;
+	bufptr += nread;
+
+	/* a version 2 header continues past the version 1 fields */
+
+	if (nleft == 0 && hlen < NET_HDR_LEN (ntohl (msg_hdr.hdr_id))) {
+	    nleft = NET_HDR_LEN (ntohl (msg_hdr.hdr_id)) - hlen;
+	    hlen += nleft;
+	}
+    }
+    /* check message header id */
+
+    if (ntohl (msg_hdr.hdr_id) != NET_HDR_ID &&
+			ntohl (msg_hdr.hdr_id) != NET_HDR_ID_V2)
+	return NSYNCERR;
+
+    /* read message into user's buffer */
+
+    if (ntohl (msg_hdr.msg_len) < maxlen)
+	nleft = ntohl (msg_hdr.msg_len);
+    else
+	nleft = maxlen;
+
+    status = net_readn (sockfd, buff, nleft, deadline, &nbytes);
+
+    if (status == NWOULDBLOCK || status == NTIMEDOUT) {
+
+	/* keep the partial message for the next call */
+
+	if (net_rxstash (sockfd, (char *) &msg_hdr, hlen,
+						    buff, nbytes) < 0)
+	    return ERROR;
+	return status;
+    }
+    else if (status <= 0)
+	return status;
+
+    net_rxinfo (sockfd, (char *) &msg_hdr);
+
+    /* read and discard excess bytes, or leave them for the next call */
+
+    nexcess = ntohl (msg_hdr.msg_len) - maxlen;
+    if (nexcess > 0) {
+	status = net_read_excess (sockfd, nexcess, deadline, &nread);
+
+	if (status == NWOULDBLOCK || status == NTIMEDOUT)
+	    net_sockfd[sockfd].rxskip = nexcess - nread;
+
+	else if (status < 0)
+	    return (status);
+    }
+
+    /* return number of bytes placed in user's buffer */
+
+    return (nbytes);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*       static int net_readn (sockfd, buff, nbytes, deadline, nreadp)
+* 
+* Description:
+*	net_readn() reads exactly nbytes bytes from a connected endpoint
+*	into the array buff.  It is called by net_recvmsg() to read the
+*	body of a message once its header has been read.  Whenever no data
+*	is available, it waits for the socket to become readable with
+*	net_wait() if deadline is given, or returns at once otherwise.
+*	The number of bytes read is returned in nreadp, also on failure.
+*
+* Return Values:
+*	On success, net_readn() returns the number of bytes read.  If a
+*	broken connection condition is detected, net_readn() will return
+*	NEOF.
+*
+*	On failure, it returns:
+*
+*	NWOULDBLOCK	when the I/O mode is NON_BLOCKING, deadline is
+*			NULL and not all bytes could be read immediately.
+*
+*	NTIMEDOUT	when the deadline expired first.
+*
+*	ERROR		on a system call error, with errno containing the
+*			error indication.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	None.
+* 
+*************************************************************************** */
+#endif
+
+static int net_readn (sockfd, buff, nbytes, deadline, nreadp)
+int sockfd;				/* endpoint socket descriptor */
+char *buff;				/* buffer area to read into */
+int nbytes;				/* number of bytes to read */
+struct timespec *deadline;		/* time limit, NULL if none */
+int *nreadp;				/* returned number of bytes read */
+{
+    int nread;				/* number of bytes read */
+    int nleft;				/* remaining bytes to read */
+    int status;				/* return status */
+
+    nleft   = nbytes;
+    *nreadp = 0;
+
+    while (nleft > 0) {
+
+	nread = net_recvts (sockfd, buff, nleft, NET_IOFLAGS (deadline));
+
+	if (nread == ERROR) {
+	    if (errno == EINTR) {
+		errno = 0;
+		continue;
+	    }
+	    else if (errno == EWOULDBLOCK) {
+		if (deadline == NULL)
+		    return NWOULDBLOCK;
+
+		status = net_wait (sockfd, POLLIN, deadline, (int *) NULL);
+		if (status < 0)
+		    return status;
+		continue;
+	    }
+	    else
+		return ERROR;
+	}
+	else if (nread == 0)
+	    return NEOF;
+
+	/* update amount read */
+
+	nleft   -= nread;
+	buff    += nread;
+	*nreadp += nread;
+    }
+    return (nbytes - nleft);
+}
+
+/* ***************************************************************************
+*
+* net_recvts() reads up to nbytes from a socket into buff as recv() does.
+* While receive timestamps are enabled on the socket (see net_settstamp()),
+* it reads with recvmsg() instead and keeps the kernel time of the data
+* read, preferring the hardware timestamp, for net_rxinfo().
+*
+*************************************************************************** */
+
+static int net_recvts (sockfd, buff, nbytes, flags)
+int sockfd;				/* endpoint socket descriptor */
+char *buff;				/* receive buffer */
+int nbytes;				/* maximum bytes to read */
+int flags;				/* recv() flags */
+{
+    struct msghdr msg;			/* data and timestamps */
+    struct iovec iov;			/* receive buffer */
+    struct cmsghdr *cm;			/* control message */
+    struct scm_timestamping *tss;	/* timestamps of the data */
+    char control[256];			/* control message buffer */
+    int nread;				/* number of bytes read */
+
+    if (!(net_sockfd[sockfd].tstamp & NET_TS_RX))
+	return recv (sockfd, buff, nbytes, flags);
+
+    iov.iov_base = buff;
+    iov.iov_len  = nbytes;
+
+    (void) memset (&msg, 0, sizeof (msg));
+    msg.msg_iov	       = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control;
+    msg.msg_controllen = sizeof (control);
+
+    if ((nread = recvmsg (sockfd, &msg, flags)) <= 0)
+	return (nread);
+
+    net_sockfd[sockfd].rx_kts.tv_sec  = 0;
+    net_sockfd[sockfd].rx_kts.tv_nsec = 0;
+
+    for (cm = CMSG_FIRSTHDR (&msg); cm != NULL; cm = CMSG_NXTHDR (&msg, cm))
+	if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMPING) {
+	    tss = (struct scm_timestamping *) CMSG_DATA (cm);
+	    net_sockfd[sockfd].rx_kts =
+		(tss->ts[2].tv_sec != 0 || tss->ts[2].tv_nsec != 0) ?
+							tss->ts[2] : tss->ts[0];
+	}
+
+    return (nread);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*       static int net_read_excess (sockfd, nexcess, deadline, nreadp)
+* 
+* Description:
+*	net_read_excess() reads and discards excess bytes from a connected
+*	endpoint.  It is called by net_recvmsg() to truncate a received
+*	message that is too long to fit in the user-supplied buffer.
+*	Whenever no data is available, it waits for the socket to become
+*	readable with net_wait() if deadline is given, or returns at once
+*	otherwise.  The number of bytes discarded is returned in nreadp,
+*	also on failure.
+*
+* Return Values:
+*	On success, net_read_excess() returns the number of bytes read and
+*	discarded.  If a broken connection condition is detected,
+*	net_read_excess() will return NEOF.
+*
+*	On failure, it returns:
+*
+*	NWOULDBLOCK	when the I/O mode is NON_BLOCKING, deadline is
+*			NULL and not all bytes could be read immediately.
+*
+*	NTIMEDOUT	when the deadline expired first.
+*
+*	ERROR		on a system call error, with errno containing the
+*			error indication.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	None.
+* 
+*************************************************************************** */
+#endif
+
+#define NET_BUFSIZE	4096		/* size of read buffer */
+
+static int net_read_excess (sockfd, nexcess, deadline, nreadp)
+int sockfd;				/* endpoint socket descriptor */
+int nexcess;				/* number of excess bytes to discard */
+struct timespec *deadline;		/* time limit, NULL if none */
+int *nreadp;				/* returned number of bytes read */
+{
+    int nread;				/* number of bytes read */
+    int nleft;				/* remaining bytes to read */
+    int status;				/* return status */
+    char buff[NET_BUFSIZE];		/* excess read buffer */
+
+    nleft   = nexcess;
+    *nreadp = 0;
+
+    while (nleft > 0) {
+
+	/* read excess bytes in NET_BUFSIZE increments */
+
+	nread = recv (sockfd, buff, (nleft > NET_BUFSIZE)? NET_BUFSIZE : nleft,
+						    NET_IOFLAGS (deadline));
+
+	if (nread == ERROR) {
+	    if (errno == EINTR) {
+		errno = 0;
+		continue;
+	    }
+	    else if (errno == EWOULDBLOCK) {
+		if (deadline == NULL)
+		    return NWOULDBLOCK;
+
+		status = net_wait (sockfd, POLLIN, deadline, (int *) NULL);
+		if (status < 0)
+		    return status;
+		continue;
+	    }
+	    else
+		return ERROR;
+	}
+	else if (nread == 0)
+	    return NEOF;
+
+	/* update amount read */
+
+	nleft   -= nread;
+	*nreadp += nread;
+    }
+    return (nexcess - nleft);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*       static int net_rxskip (sockfd, deadline)
+* 
+* Description:
+*	net_rxskip() discards the excess bytes of a truncated message that
+*	an earlier receive left unread (see net_recvmsg()), so that the
+*	next message can be read.
+*
+* Return Values:
+*	net_rxskip() returns a positive value once all excess bytes are
+*	discarded, and otherwise the same values as net_read_excess().
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	None.
+* 
+*************************************************************************** */
+#endif
+
+static int net_rxskip (sockfd, deadline)
+int sockfd;				/* endpoint socket descriptor */
+struct timespec *deadline;		/* time limit, NULL if none */
+{
+    int status;				/* return status */
+    int nread;				/* number of bytes discarded */
+
+    status = net_read_excess (sockfd, net_sockfd[sockfd].rxskip, deadline,
+								    &nread);
+    net_sockfd[sockfd].rxskip -= nread;
+
+    return (status);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*       static int net_rxstash (sockfd, hdr, nhdr, body, nbody)
+* 
+* Description:
+*	net_rxstash() keeps the part of a message that an unbuffered
+*	receive has read so far: the first nhdr bytes of its internal
+*	header hdr and, once the header is complete, the first nbody bytes
+*	of its body.  They are moved into a receive buffer attached to the
+*	socket and marked as a stash, so that the next receive call picks
+*	up the message where this one stopped.
+*
+*	A stash is sized to hold the whole message, reads no further than
+*	its end, and is detached once the message has been received, so
+*	the socket then reverts to unbuffered reads.
+*
+* Return Values:
+*	net_rxstash() returns SUCCESS on success.
+*
+*	On failure, it returns:
+*
+*	ERROR		when the buffer could not be allocated, with errno
+*			containing the error indication.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	None.
+* 
+*************************************************************************** */
+#endif
+
+static int net_rxstash (sockfd, hdr, nhdr, body, nbody)
+int sockfd;				/* endpoint socket descriptor */
+char *hdr;				/* internal message header */
+int nhdr;				/* number of header bytes read */
+char *body;				/* message body */
+int nbody;				/* number of body bytes read */
+{
+    net_rxbuf *rb;			/* socket's receive buffer */
+    int size;				/* stash size in bytes */
+    int hlen;				/* header length in bytes */
+    int len;				/* message body length */
+    int status;				/* return status */
+
+    size = NET_MIN_RXBUF_LEN;
+    if (nhdr >= (int) sizeof (struct msg_hdr_dcl)) {
+	hlen = NET_HDR_LEN (ntohl (((struct msg_hdr_dcl *) hdr)->hdr_id));
+	len  = ntohl (((struct msg_hdr_dcl *) hdr)->msg_len);
+	if (len <= NET_MAX_MSG_LEN && size < hlen + len)
+	    size = hlen + len;
+    }
+
+    if ((status = net_rxbuf_resize (sockfd, size)) < 0)
+	return status;
+
+    rb = net_sockfd[sockfd].rxbuf;
+    rb->stash = 1;
+
+    (void) memcpy (rb->base, hdr, nhdr);
+    (void) memcpy (rb->base + nhdr, body, nbody);
+    rb->tail = nhdr + nbody;
+
+    return (0);
+}
+
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_setrxbuf (sockfd, size)
+* 
+* Description:
+*	net_setrxbuf() attaches a receive buffer of size bytes to a
+*	connected socket, or detaches it when size is zero.  While a
+*	receive buffer is attached, net_recv() and net_recv_batch() read
+*	as many bytes as the kernel has available in a single read() and
+*	hand out complete messages from the buffer, so that a stream of
+*	small messages costs one system call per burst rather than two or
+*	more per message.  A size of NET_RXBUF_LEN is a good default.
+*
+*	Calling net_setrxbuf() on a socket that already has a buffer
+*	resizes it, keeping any bytes already buffered.  Any message view
+*	obtained from net_recv_view() is released first.
+*
+* Return Values:
+*	net_setrxbuf() returns SUCCESS on success.
+*
+*	On failure, it returns:
+*
+*	NBADFD		when sockfd is not a valid socket descriptor.
+*
+*	NBADLENGTH	when size is neither zero nor at least
+*			NET_MIN_RXBUF_LEN, or is too small to hold the
+*			bytes already buffered.
+*
+*	ERROR		when the buffer could not be allocated, with errno
+*			containing the error indication.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	Messages longer than the buffer are still received correctly; the
+*	part that does not fit is read directly into the caller's buffer.
+* 
+*************************************************************************** */
+#endif
+
+int net_setrxbuf (sockfd, size)
+int sockfd;				/* endpoint socket descriptor */
+int size;				/* buffer size in bytes, 0 to detach */
+{
+    int status;				/* return status */
+
+    /* validate socket descriptor */
+
+    if (sockfd < 0 || sockfd >= NET_MAX_FD ||
+				    NET_TYPE (sockfd) != TCP)
+	return NBADFD;
+
+    (void) pthread_mutex_lock (&net_sockfd[sockfd].rxlock);
+
+    status = net_rxbuf_resize (sockfd, size);
+
+    (void) pthread_mutex_unlock (&net_sockfd[sockfd].rxlock);
+
+    return (status);
+}
+
+/* ***************************************************************************
+*
+* net_rxbuf_resize() does the work of net_setrxbuf() with the receive lock
+* held.  It is also used by the receive functions to attach, enlarge and
+* detach the receive buffer.
+*
+*************************************************************************** */
+
+static int net_rxbuf_resize (sockfd, size)
+int sockfd;				/* endpoint socket descriptor */
+int size;				/* buffer size in bytes, 0 to detach */
+{
+    net_rxbuf *rb;			/* socket's receive buffer */
+    char *base;				/* new buffer area */
+    int nbuffered;			/* number of bytes buffered */
+
+    rb = net_sockfd[sockfd].rxbuf;
+    nbuffered = (rb != NULL) ? rb->tail - rb->head - rb->held : 0;
+
+    /* validate buffer size */
+
+    if ((size != 0 && size < NET_MIN_RXBUF_LEN) || size < nbuffered)
+	return NBADLENGTH;
+
+    if (size == 0) {
+	net_rxbuf_free (sockfd);
+	return (0);
+    }
+
+    /* release any message view, since the buffer area may move */
+
+    if (rb != NULL)
+	net_rxbuf_release (rb);
+
+    /* allocate new buffer area and move any buffered bytes into it */
+
+    if ((errno = posix_memalign ((void **) &base, NET_RXBUF_ALIGN,
+							    size)) != 0)
+	return ERROR;
+
+    if (rb == NULL) {
+	if ((rb = malloc (sizeof (net_rxbuf))) == NULL) {
+	    free (base);
+	    return ERROR;
+	}
+    }
+    else {
+	(void) memcpy (base, rb->base + rb->head, nbuffered);
+	free (rb->base);
+    }
+
+    rb->base  = base;
+    rb->size  = size;
+    rb->head  = 0;
+    rb->tail  = nbuffered;
+    rb->held  = 0;
+    rb->stash = 0;
+
+    net_sockfd[sockfd].rxbuf = rb;
+
+    return (0);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	static void net_rxbuf_free (sockfd)
+* 
+* Description:
+*	net_rxbuf_free() detaches and frees the receive buffer of a socket,
+*	discarding any bytes still buffered.
+*
+* Return Values:
+*	None.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	None.
+* 
+*************************************************************************** */
+#endif
+
+static void net_rxbuf_free (sockfd)
+int sockfd;				/* endpoint socket descriptor */
+{
+    net_rxbuf *rb = net_sockfd[sockfd].rxbuf;
+
+    if (rb != NULL) {
+	free (rb->base);
+	free (rb);
+	net_sockfd[sockfd].rxbuf = NULL;
+    }
+}
+
+/* ***************************************************************************
+*
+* net_txbuf_free() detaches and frees the transmit buffer of a socket,
+* discarding any bytes still pending.
+*
+*************************************************************************** */
+
+static void net_txbuf_free (sockfd)
+int sockfd;				/* endpoint socket descriptor */
+{
+    net_txbuf *tb = net_sockfd[sockfd].txbuf;
+
+    if (tb != NULL) {
+	free (tb->base);
+	free (tb);
+	net_sockfd[sockfd].txbuf = NULL;
+    }
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	void net_xfer_reset (sockfd)
+* 
+* Description:
+*	net_xfer_reset() discards all transfer state of a socket: its
+*	receive and transmit buffers, with any partial message they hold,
+*	its outbound queue, any excess bytes still to be skipped and its
+*	zero-copy send counts.  It is called by net_close() and whenever a
+*	socket descriptor is (re)assigned to a connection.
+*
+* Return Values:
+*	None.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	This is an internal function of the network services.
+* 
+*************************************************************************** */
+#endif
+
+void net_xfer_reset (sockfd)
+int sockfd;				/* endpoint socket descriptor */
+{
+    net_rxbuf_free (sockfd);
+    net_txbuf_free (sockfd);
+    net_txq_free (sockfd);
+    (void) memset (&net_sockfd[sockfd].txqinfo, 0, sizeof (net_txqinfo));
+    net_sockfd[sockfd].rxskip  = 0;
+    net_sockfd[sockfd].zcopy   = 0;
+    net_sockfd[sockfd].zc_sent = 0;
+    net_sockfd[sockfd].zc_done = 0;
+    net_sockfd[sockfd].hdrver  = NET_HDR_AUTO;
+    net_sockfd[sockfd].peer_v2 = 0;
+    net_sockfd[sockfd].tx_seq  = 0;
+    net_sockfd[sockfd].rx_seq  = 0;
+    (void) memset (&net_sockfd[sockfd].rxinfo, 0, sizeof (net_msginfo));
+    net_sockfd[sockfd].tstamp  = 0;
+    free (net_sockfd[sockfd].txring);
+    net_sockfd[sockfd].txring  = NULL;
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	void net_sockfd_open (sockfd, type, mode)
+* 
+* Description:
+*	net_sockfd_open() sets up the entry of a socket descriptor just
+*	opened, in I/O mode mode, then publishes it as of the given type.
+*	It holds the entry's locks meanwhile, so that a net_close() of the
+*	previous socket by that number, still under way in another thread,
+*	completes first.
+*
+* Return Values:
+*	None.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	This is an internal function of the network services.
+* 
+*************************************************************************** */
+#endif
+
+void net_sockfd_open (sockfd, type, mode)
+int sockfd;				/* endpoint socket descriptor */
+endpt_type type;			/* endpoint type */
+io_mode mode;				/* I/O mode */
+{
+    (void) pthread_mutex_lock (&net_sockfd[sockfd].txlock);
+    (void) pthread_mutex_lock (&net_sockfd[sockfd].rxlock);
+
+    net_sockfd[sockfd].mode = mode;
+    net_xfer_reset (sockfd);
+    NET_SET_TYPE (sockfd, type);
+
+    (void) pthread_mutex_unlock (&net_sockfd[sockfd].rxlock);
+    (void) pthread_mutex_unlock (&net_sockfd[sockfd].txlock);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_recv_batch (sockfd, msgv, vlen, mode)
+* 
+* Description:
+*	net_recv_batch() receives up to vlen messages from a connected
+*	endpoint in a single call.  Message i is placed into msgv[i].buf
+*	for up to msgv[i].maxlen bytes and its length is returned in
+*	msgv[i].len; messages that are too long are truncated as for
+*	net_recv().
+*
+*	If the socket has a receive buffer (see net_setrxbuf()), every
+*	complete message already buffered is returned, up to vlen.  If no
+*	complete message is buffered, net_recv_batch() first performs one
+*	read according to mode.  Without a receive buffer, it behaves like
+*	net_recv() into msgv[0].
+*
+* Return Values:
+*	On success, net_recv_batch() returns the number of messages
+*	received (at least one).  If a broken connection condition is
+*	detected, net_recv_batch() will return NEOF.
+*
+*	On failure, it returns the same error codes as net_recv().
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	None.
+* 
+*************************************************************************** */
+#endif
+
+int net_recv_batch (sockfd, msgv, vlen, mode)
+int sockfd;				/* endpoint socket descriptor */
+net_msgvec *msgv;			/* messages to receive into */
+int vlen;				/* number of entries in msgv */
+io_mode mode;				/* receive I/O mode */
+{
+    int buffered;			/* socket has a receive buffer */
+    int status;				/* return status */
+    int i;				/* loop index */
+
+    /* validate socket descriptor */
+
+    if (sockfd < 0 || sockfd >= NET_MAX_FD ||
+				    NET_TYPE (sockfd) != TCP)
+	return NBADFD;
+
+    /* validate message vector */
+
+    if (msgv == (net_msgvec *) NULL)
+	return NBADADDR;
+
+    if (vlen < 1)
+	return NBADLENGTH;
+
+    for (i = 0; i < vlen; i++) {
+	if (msgv[i].buf == (char *) NULL)
+	    return NBADADDR;
+	if (msgv[i].maxlen < NET_MIN_MSG_LEN)
+	    return NBADLENGTH;
+    }
+
+    /* validate socket I/O mode */
+
+    if (mode != BLOCKING && mode != NON_BLOCKING)
+	return NBADMODE;
+
+    (void) pthread_mutex_lock (&net_sockfd[sockfd].rxlock);
+
+    if ((buffered = (net_sockfd[sockfd].rxbuf != NULL)))
+	status = net_rxbatch (sockfd, msgv, vlen, NET_MODE_DEADLINE (mode));
+
+    (void) pthread_mutex_unlock (&net_sockfd[sockfd].rxlock);
+
+    /* without a receive buffer, receive a single message */
+
+    if (!buffered) {
+	if ((status = net_recv (sockfd, msgv[0].buf, msgv[0].maxlen,
+							mode)) <= 0)
+	    return status;
+	msgv[0].len = status;
+	return (1);
+    }
+
+    return (status);
+}
+
+/* ***************************************************************************
+*
+* net_rxbatch() does the work of net_recv_batch() for a socket with a
+* receive buffer, with the receive lock held.
+*
+*************************************************************************** */
+
+static int net_rxbatch (sockfd, msgv, vlen, deadline)
+int sockfd;				/* endpoint socket descriptor */
+net_msgvec *msgv;			/* messages to receive into */
+int vlen;				/* number of entries in msgv */
+struct timespec *deadline;		/* time limit, NULL if none */
+{
+    net_rxbuf *rb;			/* socket's receive buffer */
+    int status;				/* return status */
+    int nmsgs;				/* number of messages received */
+    char *msg;				/* next buffered message */
+    int len;				/* next buffered message length */
+    int hlen;				/* its header length */
+
+    rb = net_sockfd[sockfd].rxbuf;
+
+    /* hand out every complete message already buffered */
+
+    net_rxbuf_release (rb);
+    nmsgs = 0;
+
+    while (nmsgs < vlen) {
+
+	status = net_rxnext (rb, &msg, &len, &hlen);
+
+	if (status < 0)
+	    return (nmsgs > 0) ? nmsgs : status;
+
+	else if (status > 0) {
+	    msgv[nmsgs].len = (len < msgv[nmsgs].maxlen) ?
+						len : msgv[nmsgs].maxlen;
+	    (void) memcpy (msgv[nmsgs].buf, msg, msgv[nmsgs].len);
+	    net_rxinfo (sockfd, rb->base + rb->head);
+	    rb->head += hlen + len;
+	    nmsgs++;
+	}
+	else if (nmsgs > 0)
+	    break;
+
+	/* no complete message: message does not fit, or read more */
+
+	else if (rb->tail - rb->head >= (int) sizeof (struct msg_hdr_dcl) &&
+		 len > rb->size - hlen) {
+	    if ((status = net_rxrecv (sockfd, msgv[0].buf, msgv[0].maxlen,
+							    deadline)) <= 0)
+		return status;
+	    msgv[0].len = status;
+	    return (1);
+	}
+	else if ((status = net_rxfill (sockfd, rb, deadline)) <= 0)
+	    return status;
+    }
+
+    if (rb->stash && rb->head == rb->tail)
+	net_rxbuf_free (sockfd);
+
+    return (nmsgs);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	static int net_rxfill (sockfd, rb, deadline)
+* 
+* Description:
+*	net_rxfill() performs a single recv() of as many bytes as are
+*	available (up to the free space in the buffer) into the receive
+*	buffer rb, first moving any unread bytes to the start of the
+*	buffer if the free space at its end is exhausted.  If deadline is
+*	not NULL and no bytes are available, it first waits for the socket
+*	to become readable with net_wait(), until the deadline.
+*
+*	A stash (see net_rxstash()) is only filled up to the end of the
+*	message it holds, and any excess of an earlier message still to be
+*	discarded is skipped first.
+*
+* Return Values:
+*	On success, net_rxfill() returns the number of bytes read.  If a
+*	broken connection condition is detected, net_rxfill() will return
+*	NEOF.
+*
+*	On failure, it returns:
+*
+*	NWOULDBLOCK	when the I/O mode is NON_BLOCKING, deadline is
+*			NULL and no bytes are available.
+*
+*	NTIMEDOUT	when the deadline expired first.
+*
+*	ERROR		on a system call error, with errno containing the
+*			error indication.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	None.
+* 
+*************************************************************************** */
+#endif
+
+static int net_rxfill (sockfd, rb, deadline)
+int sockfd;				/* endpoint socket descriptor */
+net_rxbuf *rb;				/* socket's receive buffer */
+struct timespec *deadline;		/* time limit, NULL if none */
+{
+    int nread;				/* number of bytes read */
+    int nwant;				/* number of bytes to read */
+    int nbuffered;			/* number of bytes buffered */
+    int status;				/* return status */
+    struct msg_hdr_dcl msg_hdr;		/* internal message header */
+
+    /* finish discarding the excess of an earlier message */
+
+    if (net_sockfd[sockfd].rxskip > 0 &&
+			(status = net_rxskip (sockfd, deadline)) <= 0)
+	return status;
+
+    /* reclaim space from messages already handed out */
+
+    if (rb->head == rb->tail)
+	rb->head = rb->tail = 0;
+
+    else if (rb->head > 0 && rb->tail == rb->size) {
+	(void) memmove (rb->base, rb->base + rb->head, rb->tail - rb->head);
+	rb->tail -= rb->head;
+	rb->head  = 0;
+    }
+
+    nwant = rb->size - rb->tail;
+
+    /* a stash must not read past the end of its message */
+
+    if (rb->stash) {
+	nbuffered = rb->tail - rb->head;
+
+	if (nbuffered < (int) sizeof (msg_hdr))
+	    nwant = sizeof (msg_hdr) - nbuffered;
+	else {
+	    (void) memcpy (&msg_hdr, rb->base + rb->head, sizeof (msg_hdr));
+	    nwant = NET_HDR_LEN (ntohl (msg_hdr.hdr_id)) +
+				ntohl (msg_hdr.msg_len) - nbuffered;
+	}
+	if (nwant > rb->size - rb->tail)
+	    nwant = rb->size - rb->tail;
+    }
+
+    for (;;) {
+
+	nread = net_recvts (sockfd, rb->base + rb->tail, nwant,
+						    NET_IOFLAGS (deadline));
+
+	if (nread == ERROR) {
+	    if (errno == EINTR) {
+		errno = 0;
+		continue;
+	    }
+	    else if (errno == EWOULDBLOCK) {
+		if (deadline == NULL)
+		    return NWOULDBLOCK;
+
+		status = net_wait (sockfd, POLLIN, deadline, (int *) NULL);
+		if (status < 0)
+		    return status;
+		continue;
+	    }
+
+	    else
+		return ERROR;
+	}
+	else if (nread == 0)
+	    return NEOF;
+
+	rb->tail += nread;
+	return (nread);
+    }
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	static int net_rxnext (rb, msgp, lenp, hlenp)
+* 
+* Description:
+*	net_rxnext() checks whether the receive buffer rb holds a complete
+*	message.  If it does, a pointer to the message body is returned in
+*	msgp.  If at least the version 1 part of the message header is
+*	buffered, the length of the message body is returned in lenp and
+*	the length of the whole header in hlenp.  The message is not
+*	removed from the buffer.
+*
+* Return Values:
+*	net_rxnext() returns 1 when a complete message is buffered, and 0
+*	when more bytes must be read.
+*
+*	On failure, it returns:
+*
+*	NSYNCERR	when the incoming message boundaries are out of
+*			sync.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	None.
+* 
+*************************************************************************** */
+#endif
+
+static int net_rxnext (rb, msgp, lenp, hlenp)
+net_rxbuf *rb;				/* socket's receive buffer */
+char **msgp;				/* returned message body pointer */
+int *lenp;				/* returned message body length */
+int *hlenp;				/* returned header length */
+{
+    struct msg_hdr_dcl msg_hdr;		/* internal message header */
+    int nbuffered;			/* number of bytes buffered */
+
+    *lenp  = 0;
+    *hlenp = sizeof (msg_hdr);
+    nbuffered = rb->tail - rb->head;
+
+    if (nbuffered < (int) sizeof (msg_hdr))
+	return (0);
+
+    /* check message header id */
+
+    (void) memcpy (&msg_hdr, rb->base + rb->head, sizeof (msg_hdr));
+
+    if (ntohl (msg_hdr.hdr_id) != NET_HDR_ID &&
+			ntohl (msg_hdr.hdr_id) != NET_HDR_ID_V2)
+	return NSYNCERR;
+
+    *hlenp = NET_HDR_LEN (ntohl (msg_hdr.hdr_id));
+    *lenp  = ntohl (msg_hdr.msg_len);
+
+    if (*lenp < NET_MIN_MSG_LEN || *lenp > NET_MAX_MSG_LEN)
+	return NSYNCERR;
+
+    if (nbuffered < *hlenp + *lenp)
+	return (0);
+
+    *msgp = rb->base + rb->head + *hlenp;
+    return (1);
+}
+
+/* ***************************************************************************
+*
+* net_rxinfo() records the internal header hdr of a message just received
+* on a socket for net_getmsginfo(), with its kernel receive time if enabled,
+* and checks its sequence number.  Once
+* the peer has sent a version 2 header, a socket in NET_HDR_AUTO mode
+* answers with version 2 headers as well.
+*
+*************************************************************************** */
+
+static void net_rxinfo (sockfd, hdr)
+int sockfd;				/* endpoint socket descriptor */
+char *hdr;				/* internal message header */
+{
+    net_msginfo *mi = &net_sockfd[sockfd].rxinfo;
+    struct msg_hdr_v2 msg_hdr;		/* internal message header */
+    int nskipped;			/* sequence numbers skipped */
+
+    /* a kernel receive time is reported with the user's receive time */
+
+    if (net_sockfd[sockfd].tstamp & NET_TS_RX) {
+	mi->rxstamp = net_sockfd[sockfd].rx_kts;
+	(void) clock_gettime (CLOCK_REALTIME, &mi->recvd);
+    }
+
+    (void) memcpy (&msg_hdr, hdr, sizeof (struct msg_hdr_dcl));
+
+    if (ntohl (msg_hdr.hdr_id) != NET_HDR_ID_V2) {
+	mi->version = NET_HDR_V1;
+	return;
+    }
+
+    (void) memcpy (&msg_hdr, hdr, sizeof (msg_hdr));
+    if (!(net_sockfd[sockfd].tstamp & NET_TS_RX))
+	(void) clock_gettime (CLOCK_REALTIME, &mi->recvd);
+
+    mi->version      = NET_HDR_V2;
+    mi->seq_no       = ntohl (msg_hdr.seq_no);
+    mi->sent.tv_sec  = ntohl (msg_hdr.ts_sec);
+    mi->sent.tv_nsec = ntohl (msg_hdr.ts_nsec);
+    mi->latency_ns   = (mi->recvd.tv_sec - mi->sent.tv_sec) * 1000000000L +
+			(mi->recvd.tv_nsec - mi->sent.tv_nsec);
+
+    /* compare with the sequence number expected */
+
+    nskipped = (int) (mi->seq_no - net_sockfd[sockfd].rx_seq);
+
+    if (mi->nmsgs > 0 && nskipped < 0)
+	mi->nreordered++;
+    else {
+	if (mi->nmsgs > 0 && nskipped > 0) {
+	    mi->ngaps++;
+	    mi->nlost += nskipped;
+	}
+	net_sockfd[sockfd].rx_seq = mi->seq_no + 1;
+    }
+    mi->nmsgs++;
+
+    if (!net_sockfd[sockfd].peer_v2)
+	__atomic_store_n (&net_sockfd[sockfd].peer_v2, 1, __ATOMIC_RELAXED);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	static int net_rxrecv (sockfd, buff, maxlen, deadline)
+* 
+* Description:
+*	net_rxrecv() receives the next message from a connected endpoint
+*	through the socket's receive buffer.  It is called by net_recvmsg()
+*	when a receive buffer is attached.  The message is copied into the
+*	array buff for up to maxlen bytes, and any excess is discarded.
+*
+*	A message that is too long to fit in the receive buffer is moved
+*	to buff from the buffer as far as it has been read, and the rest
+*	is read directly from the socket.  If the socket is non-blocking,
+*	or the buffer is a stash, the buffer is enlarged instead so that a
+*	partial message always stays buffered.  A stash is detached once
+*	its message has been received.
+*
+* Return Values:
+*	Same as net_recvmsg().
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	When the I/O mode is NON_BLOCKING and a message is incomplete,
+*	NWOULDBLOCK is returned and the bytes already read stay in the
+*	buffer, so the stream remains in sync for the next call.
+* 
+*************************************************************************** */
+#endif
+
+static int net_rxrecv (sockfd, buff, maxlen, deadline)
+int sockfd;				/* endpoint socket descriptor */
+char *buff;				/* buffer area to receive msg into */
+int maxlen;				/* length in bytes of buffer area */
+struct timespec *deadline;		/* time limit, NULL if none */
+{
+    net_rxbuf *rb = net_sockfd[sockfd].rxbuf;
+    int status;				/* return status */
+    char *msg;				/* buffered message body */
+    int len;				/* message body length */
+    int hlen;				/* header length */
+    struct msg_hdr_v2 msg_hdr;		/* header of a bypassed message */
+    int nbody;				/* body bytes already buffered */
+    int nbytes;				/* number of bytes placed in buff */
+    int nuser;				/* body bytes destined for buff */
+    int nexcess;			/* number of excess bytes */
+    int nread;				/* number of bytes read */
+    int stash;				/* buffer is a stash */
+
+    net_rxbuf_release (rb);
+
+    for (;;) {
+
+	if ((status = net_rxnext (rb, &msg, &len, &hlen)) < 0)
+	    return status;
+
+	/* complete message buffered: copy it out */
+
+	if (status > 0) {
+	    nbytes = (len < maxlen) ? len : maxlen;
+	    (void) memcpy (buff, msg, nbytes);
+	    net_rxinfo (sockfd, rb->base + rb->head);
+	    rb->head += hlen + len;
+
+	    if (rb->stash && rb->head == rb->tail)
+		net_rxbuf_free (sockfd);
+	    return (nbytes);
+	}
+
+	/* message larger than the buffer: enlarge it, or bypass the rest */
+
+	if (len > rb->size - hlen) {
+	    if (NET_BLOCKS (deadline) && !rb->stash) {
+		if (rb->tail - rb->head >= hlen)
+		    break;
+	    }
+	    else {
+		stash = rb->stash;
+		if ((status = net_rxbuf_resize (sockfd, len + hlen)) < 0)
+		    return status;
+		rb = net_sockfd[sockfd].rxbuf;
+		rb->stash = stash;
+	    }
+	}
+
+	if ((status = net_rxfill (sockfd, rb, deadline)) <= 0)
+	    return status;
+    }
+
+    nbody = rb->tail - rb->head - hlen;
+    nuser = (len < maxlen) ? len : maxlen;
+    nbytes = (nbody < nuser) ? nbody : nuser;
+
+    (void) memcpy (&msg_hdr, rb->base + rb->head, hlen);
+    (void) memcpy (buff, rb->base + rb->head + hlen, nbytes);
+    rb->head = rb->tail = 0;
+
+    if (nbytes < nuser) {
+	if ((status = net_readn (sockfd, buff + nbytes, nuser - nbytes,
+						deadline, &nread)) <= 0)
+	    return status;
+	nbytes += status;
+    }
+
+    /* read and discard excess bytes */
+
+    nexcess = len - ((nbody > nuser) ? nbody : nuser);
+    if (nexcess > 0) {
+	status = net_read_excess (sockfd, nexcess, deadline, &nread);
+	if (status < 0)
+	    return (status);
+    }
+
+    net_rxinfo (sockfd, (char *) &msg_hdr);
+
+    return (nbytes);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_recv_view (sockfd, msgp, mode)
+* 
+* Description:
+*	net_recv_view() receives the next message from a connected
+*	endpoint without copying it.  On return, msgp points to the
+*	message inside the socket's receive buffer.  The message body
+*	starts on a NET_MSG_ALIGN byte boundary, so that its fields can be
+*	decoded in place.
+*
+*	The message stays valid, and is not overwritten by later input,
+*	until it is released by net_release(), by the next net_recv(),
+*	net_recv_batch(), or net_recv_view() call on the socket, or by
+*	net_close().
+*
+*	A receive buffer of NET_RXBUF_LEN bytes is attached to the socket
+*	if it has none (see net_setrxbuf()), and the buffer is enlarged
+*	if a message does not fit in it.
+*
+* Return Values:
+*	On success, net_recv_view() returns the length of the message in
+*	bytes.  If a broken connection condition is detected,
+*	net_recv_view() will return NEOF.
+*
+*	On failure, it returns:
+*
+*	NBADFD		when sockfd is not a valid socket descriptor.
+*
+*	NBADADDR	when msgp is not a valid pointer.
+*
+*	NBADMODE	when the mode is not a valid I/O mode.
+*
+*	NSYNCERR	when the incoming message boundaries are out of
+*			sync.
+*
+*	NWOULDBLOCK	when the I/O mode is NON_BLOCKING and no complete
+*			message is available.  Bytes of a partial message
+*			stay buffered for the next call.
+*
+*	ERROR		on a system call error, with errno containing the
+*			error indication.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	Neither the kernel-to-user copy into the receive buffer nor the
+*	read itself is avoided, but the copy into a caller's buffer (and
+*	any clearing of that buffer) is.
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	The message must be treated as read-only.
+* 
+*************************************************************************** */
+#endif
+
+int net_recv_view (sockfd, msgp, mode)
+int sockfd;				/* endpoint socket descriptor */
+char **msgp;				/* returned message pointer */
+io_mode mode;				/* receive I/O mode */
+{
+    int status;				/* return status */
+
+    /* validate socket descriptor */
+
+    if (sockfd < 0 || sockfd >= NET_MAX_FD ||
+				    NET_TYPE (sockfd) != TCP)
+	return NBADFD;
+
+    /* validate msg pointer */
+
+    if (msgp == (char **) NULL)
+	return NBADADDR;
+
+    /* validate socket I/O mode */
+
+    if (mode != BLOCKING && mode != NON_BLOCKING)
+	return NBADMODE;
+
+    (void) pthread_mutex_lock (&net_sockfd[sockfd].rxlock);
+
+    status = net_rxview (sockfd, msgp, NET_MODE_DEADLINE (mode));
+
+    (void) pthread_mutex_unlock (&net_sockfd[sockfd].rxlock);
+
+    return (status);
+}
+
+/* ***************************************************************************
+*
+* net_rxview() does the work of net_recv_view() with the receive lock
+* held.
+*
+*************************************************************************** */
+
+static int net_rxview (sockfd, msgp, deadline)
+int sockfd;				/* endpoint socket descriptor */
+char **msgp;				/* returned message pointer */
+struct timespec *deadline;		/* time limit, NULL if none */
+{
+    net_rxbuf *rb;			/* socket's receive buffer */
+    int status;				/* return status */
+    char *msg;				/* buffered message body */
+    int len;				/* message body length */
+    int hlen;				/* header length */
+    int nbuffered;			/* number of bytes buffered */
+
+    /* attach a receive buffer if necessary */
+
+    if (net_sockfd[sockfd].rxbuf == NULL &&
+		(status = net_rxbuf_resize (sockfd, NET_RXBUF_LEN)) < 0)
+	return status;
+
+    rb = net_sockfd[sockfd].rxbuf;
+    rb->stash = 0;
+    net_rxbuf_release (rb);
+
+    for (;;) {
+
+	if ((status = net_rxnext (rb, &msg, &len, &hlen)) < 0)
+	    return status;
+
+	if (status > 0)
+	    break;
+
+	/* enlarge the buffer for a message that does not fit */
+
+	if (len > rb->size - hlen &&
+		(status = net_rxbuf_resize (sockfd, len + hlen)) < 0)
+	    return status;
+
+	rb = net_sockfd[sockfd].rxbuf;
+
+	if ((status = net_rxfill (sockfd, rb, deadline)) <= 0)
+	    return status;
+    }
+
+    /* move the buffered bytes if the message body is misaligned */
+
+    if (((unsigned long) msg) % NET_MSG_ALIGN != 0) {
+	nbuffered = rb->tail - rb->head;
+	(void) memmove (rb->base, rb->base + rb->head, nbuffered);
+	rb->head = 0;
+	rb->tail = nbuffered;
+	msg = rb->base + hlen;
+    }
+
+    net_rxinfo (sockfd, rb->base + rb->head);
+
+    /* hold the message in the buffer until it is released */
+
+    rb->held = hlen + len;
+    *msgp = msg;
+
+    return (len);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_release (sockfd)
+* 
+* Description:
+*	net_release() releases the message last returned by
+*	net_recv_view() on a socket, allowing its space in the receive
+*	buffer to be reused.
+*
+* Return Values:
+*	net_release() returns SUCCESS on success, including when no
+*	message is held.
+*
+*	On failure, it returns:
+*
+*	NBADFD		when sockfd is not a valid socket descriptor.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	None.
+* 
+*************************************************************************** */
+#endif
+
+int net_release (sockfd)
+int sockfd;				/* endpoint socket descriptor */
+{
+    /* validate socket descriptor */
+
+    if (sockfd < 0 || sockfd >= NET_MAX_FD ||
+				    NET_TYPE (sockfd) == UNDEF)
+	return NBADFD;
+
+    (void) pthread_mutex_lock (&net_sockfd[sockfd].rxlock);
+
+    if (net_sockfd[sockfd].rxbuf != NULL)
+	net_rxbuf_release (net_sockfd[sockfd].rxbuf);
+
+    (void) pthread_mutex_unlock (&net_sockfd[sockfd].rxlock);
+
+    return (0);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	static void net_rxbuf_release (rb)
+* 
+* Description:
+*	net_rxbuf_release() removes the message held by net_recv_view(),
+*	if any, from the receive buffer rb.
+*
+* Return Values:
+*	None.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	None.
+* 
+*************************************************************************** */
+#endif
+
+static void net_rxbuf_release (rb)
+net_rxbuf *rb;				/* socket's receive buffer */
+{
+    rb->head += rb->held;
+    rb->held  = 0;
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_wait (sockfd, events, deadline, ndelayp)
+* 
+* Description:
+*	net_wait() waits for a non-blocking socket to become ready for the
+*	poll() events given (POLLIN or POLLOUT), after an I/O call on it
+*	returned EWOULDBLOCK.  It returns as soon as the socket is ready,
+*	an error or hangup is pending on it, or a signal is caught; the
+*	caller then retries its I/O call.
+*
+*	If deadline is not NULL, net_wait() does not wait past it (see
+*	net_deadline()).  Otherwise it waits for at most
+*	NET_MIN_USEC_DELAY microseconds, and counts the waits in *ndelayp
+*	so that the caller gives up after NET_MAX_NDELAY of them.
+*
+* Return Values:
+*	net_wait() returns SUCCESS when the caller should retry.
+*
+*	On failure, it returns:
+*
+*	NWOULDBLOCK	when deadline is NULL and NET_MAX_NDELAY waits
+*			have been made.
+*
+*	NTIMEDOUT	when the deadline has expired.
+*
+*	ERROR		on a system call error, with errno containing the
+*			error indication.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	Unlike a fixed sleep, the wait ends as soon as the socket can make
+*	progress.
+*
+* Portability:
+*	This function uses ppoll() and clock_gettime().
+*
+* Notes:
+*	None.
+* 
+*************************************************************************** */
+#endif
+
+int net_wait (sockfd, events, deadline, ndelayp)
+int sockfd;				/* endpoint socket descriptor */
+int events;				/* poll() events to wait for */
+struct timespec *deadline;		/* time limit, NULL if none */
+int *ndelayp;				/* number of waits made */
+{
+    struct pollfd pfd;			/* socket to be polled */
+    struct timespec now;		/* current time */
+    struct timespec left;		/* time left before quitting */
+    struct timespec *timeout;		/* ppoll() timeout, NULL if none */
+
+    timeout = &left;
+
+    if (deadline == NULL) {
+	if (++(*ndelayp) > NET_MAX_NDELAY)
+	    return NWOULDBLOCK;
+
+	left.tv_sec  = 0;
+	left.tv_nsec = NET_MIN_USEC_DELAY * 1000L;
+    }
+    else if (deadline->tv_sec < 0)
+	timeout = (struct timespec *) NULL;
+
+    else {
+	(void) clock_gettime (CLOCK_MONOTONIC, &now);
+
+	left.tv_sec  = deadline->tv_sec  - now.tv_sec;
+	left.tv_nsec = deadline->tv_nsec - now.tv_nsec;
+	if (left.tv_nsec < 0) {
+	    left.tv_sec--;
+	    left.tv_nsec += 1000000000L;
+	}
+	if (left.tv_sec < 0 || (left.tv_sec == 0 && left.tv_nsec == 0))
+	    return NTIMEDOUT;
+    }
+
+    pfd.fd      = sockfd;
+    pfd.events  = events;
+    pfd.revents = 0;
+
+    if (ppoll (&pfd, 1, timeout, NULL) == ERROR && errno != EINTR)
+	return ERROR;
+
+    return (0);
+}
+
+/* ***************************************************************************
+*
+* net_deadline() sets deadline to usec microseconds from now on the
+* monotonic clock, or to "no deadline" if usec is NET_WAIT_FOREVER.
+*
+*************************************************************************** */
+
+static void net_deadline (deadline, usec)
+struct timespec *deadline;		/* returned time limit */
+long usec;				/* time limit in microseconds */
+{
+    if (usec == NET_WAIT_FOREVER) {
+	deadline->tv_sec  = -1;
+	deadline->tv_nsec = 0;
+	return;
+    }
+
+    (void) clock_gettime (CLOCK_MONOTONIC, deadline);
+
+    deadline->tv_sec  += usec / 1000000L;
+    deadline->tv_nsec += (usec % 1000000L) * 1000L;
+    if (deadline->tv_nsec >= 1000000000L) {
+	deadline->tv_sec++;
+	deadline->tv_nsec -= 1000000000L;
+    }
+}
@@ -55,13 +55,22 @@
 #include <errno.h>
 #endif
 
+#include <poll.h>
 #include <stdio.h>
 #include "net_appl.h"
 #include "net.h"
 
 /* global variable definitions */
 
-sockfd_entry net_sockfd[NET_MAX_FD] = { {UNDEF, BLOCKING} };
+sockfd_entry net_sockfd[NET_MAX_FD] = {
+    [0 ... NET_MAX_FD - 1] = {
+	UNDEF, BLOCKING,
+	.txlock = PTHREAD_MUTEX_INITIALIZER,
+	.rxlock = PTHREAD_MUTEX_INITIALIZER
+    }
+};
+
+static int net_setcork ();
 
 #ifdef FUNCT_HDR
 /* ***************************************************************************
@@ -71,7 +80,9 @@ sockfd_entry net_sockfd[NET_MAX_FD] = { {UNDEF, BLOCKING} };
 * 
 * Description:
 *	net_getservport() returns the port number associated with a
-*	server's endpoint name.
+*	server's endpoint name, looked up in the endpoint registry (see
+*	net_loadendpts()).  The name of an endpoint of a range reads
+*	"base[i]".
 *
 * Return Values:
 *	net_getservport() returns the server's port number on success, and
@@ -96,14 +107,11 @@ int net_getservport (endpt, type)
 char *endpt;				/* server's endpoint name */
 endpt_type type;			/* server's endpoint type */
 {
-    int i;				/* loop index */
+    endpt_entry entry;			/* server's endpoint entry */
 
-    for (i = 0; i < NET_MAX_ENDPTS; i++) {
-	if ((net_endpt[i].type == type) &&
-				(strcmp (net_endpt[i].name, endpt) == 0))
-	    return net_endpt[i].port;
-    }
-    return ERROR;
+    if (net_getendpt (endpt, type, &entry) != SUCCESS)
+	return ERROR;
+    return entry.port;
 }
 
 #ifdef FUNCT_HDR
@@ -174,6 +182,12 @@ char *endpt;				/* server's endpoint name */
     if ((listenfd = socket (AF_INET, SOCK_STREAM, 0)) == ERROR)
 	return ERROR;
 
+    if (listenfd >= NET_MAX_FD) {
+	(void) close (listenfd);
+	errno = EMFILE;
+	return ERROR;
+    }
+
     if (bind (listenfd, (struct sockaddr *) &server,
 					    sizeof (server)) == ERROR) {
 	(void) close (listenfd);
@@ -181,10 +195,9 @@ char *endpt;				/* server's endpoint name */
     }
     /* listen for connection requests */
 
-    (void) listen (listenfd, 5);
+    (void) listen (listenfd, SOMAXCONN);
 
-    net_sockfd[listenfd].type = TCP;
-    net_sockfd[listenfd].mode = BLOCKING;
+    net_sockfd_open (listenfd, TCP, BLOCKING);
 
     return listenfd;
 }
@@ -248,7 +261,7 @@ io_mode mode;				/* listen socket I/O mode */
     /* validate socket descriptor and I/O mode */
 
     if (listenfd < 0 || listenfd >= NET_MAX_FD ||
-					net_sockfd[listenfd].type == UNDEF)
+					NET_TYPE (listenfd) == UNDEF)
 	return NBADFD;
 
     if (mode != BLOCKING && mode != NON_BLOCKING)
@@ -272,6 +285,12 @@ io_mode mode;				/* listen socket I/O mode */
 	    return ERROR;
     }
 
+    if (sockfd >= NET_MAX_FD) {
+	(void) close (sockfd);
+	errno = EMFILE;
+	return ERROR;
+    }
+
     /* set option to not linger */
 
     if (setsockopt (sockfd, SOL_SOCKET, SO_LINGER, (char *) &off,
@@ -288,8 +307,7 @@ io_mode mode;				/* listen socket I/O mode */
 	return ERROR;
     }
 
-    net_sockfd[sockfd].type = TCP;
-    net_sockfd[sockfd].mode = BLOCKING;
+    net_sockfd_open (sockfd, TCP, BLOCKING);
 
     /* ignore broken pipe signals */
 
@@ -359,7 +377,8 @@ io_mode mode;				/* I/O mode of connection attempt */
     int	port;				/* server's port number */
     struct hostent *hostp;		/* server's host entry pointer */
     int sockfd;				/* connecting socket descriptor */
-    int ndelay = 0;			/* number of delays before quitting */
+    int status;				/* return status */
+    int ndelay = 0;			/* number of waits before quitting */
     int on = 1;				/* option flag for setsockopt() */
 
     /* initialize server's address */
@@ -400,6 +419,12 @@ io_mode mode;				/* I/O mode of connection attempt */
     if ((sockfd = socket (AF_INET, SOCK_STREAM, 0)) == ERROR)
 	return ERROR;
 
+    if (sockfd >= NET_MAX_FD) {
+	(void) close (sockfd);
+	errno = EMFILE;
+	return ERROR;
+    }
+
     /* set option to reuse address */
 
     if (setsockopt (sockfd, SOL_SOCKET, SO_REUSEADDR, (char *) &on,
@@ -436,16 +461,11 @@ again:
 	if (errno == EINPROGRESS || errno == EALREADY) {
 	    /* try to complete connection for non-blocking socket only */
 
-	    struct timeval delay;
-
-	    delay.tv_sec  = 0;
-	    delay.tv_usec = NET_MIN_USEC_DELAY;
-
-	    if (++ndelay > NET_MAX_NDELAY) {
+	    if ((status = net_wait (sockfd, POLLOUT, (struct timespec *) NULL,
+							    &ndelay)) < 0) {
 		(void) close (sockfd);
-		return NWOULDBLOCK;
+		return status;
 	    }
-	    (void) select (0, (fd_set *)0, (fd_set *)0, (fd_set *)0, &delay);
 	    goto again;
 	}
 	else if (errno != EISCONN) {
@@ -454,8 +474,7 @@ again:
 	}
     }
 
-    net_sockfd[sockfd].type = TCP;
-    net_sockfd[sockfd].mode = mode;
+    net_sockfd_open (sockfd, TCP, mode);
 
     /* ignore broken pipe signals */
 
@@ -495,7 +514,12 @@ again:
 *	None.
 *
 * Notes:
-*	None.
+*	The rest of a partially sent message still pending (see
+*	net_pending()) is discarded; call net_flush() first to send it.
+*
+*	net_close() waits for sends and receives in progress on the
+*	socket in other threads to return.  A thread blocked receiving on
+*	it must be woken first, e.g. by a shutdown() of the socket.
 * 
 *************************************************************************** */
 #endif
@@ -503,19 +527,35 @@ again:
 int net_close (sockfd)
 int sockfd;				/* socket descriptor to be closed */
 {
+    int status;				/* return status */
+
     /* validate socket descriptor */
 
     if (sockfd < 0 || sockfd >= NET_MAX_FD ||
-				net_sockfd[sockfd].type == UNDEF)
+				NET_TYPE (sockfd) == UNDEF)
 	return NBADFD;
 
-    if (close (sockfd) == ERROR)
-	return ERROR;
+    /* wait for transfers in progress in other threads; the entry is
+       released before the descriptor, which another thread may be given
+       as soon as it is closed, and only once, should two threads close
+       the same one */
+
+    (void) pthread_mutex_lock (&net_sockfd[sockfd].txlock);
+    (void) pthread_mutex_lock (&net_sockfd[sockfd].rxlock);
+
+    if (NET_TYPE (sockfd) == UNDEF)
+	status = NBADFD;
+    else {
+	NET_SET_TYPE (sockfd, UNDEF);
+	net_sockfd[sockfd].mode = BLOCKING;
+	net_xfer_reset (sockfd);
+	status = (close (sockfd) == ERROR) ? ERROR : 0;
+    }
 
-    net_sockfd[sockfd].type = UNDEF;
-    net_sockfd[sockfd].mode = BLOCKING;
+    (void) pthread_mutex_unlock (&net_sockfd[sockfd].rxlock);
+    (void) pthread_mutex_unlock (&net_sockfd[sockfd].txlock);
 
-    return (0);
+    return (status);
 }
 
 #ifdef FUNCT_HDR
@@ -577,7 +617,7 @@ int namelen;				/* hostname length in bytes */
     /* validate socket descriptor */
 
     if (sockfd < 0 || sockfd >= NET_MAX_FD ||
-				net_sockfd[sockfd].type != TCP)
+				NET_TYPE (sockfd) != TCP)
 	return NBADFD;
 
     /* validate name pointers */
@@ -616,14 +656,9 @@ int namelen;				/* hostname length in bytes */
 	}
     }
     if (i >= MAXTASKS) {
-	for (i = 0; i < NET_MAX_ENDPTS; i++) {
-	    if (net_endpt[i].port == ntohs (peer.sin_port)) {
-		*pname = net_endpt[i].pname;
-		break;
-	    }
-	}
-	if (i >= NET_MAX_ENDPTS)
+	if ((i = net_getendptport (ntohs (peer.sin_port))) == NBADPROCESS)
 	    return NBADPROCESS;
+	*pname = i;
     }
 
     return (0);
@@ -639,6 +674,12 @@ int namelen;				/* hostname length in bytes */
 *	net_setiomode() sets the I/O mode of the supplied socket descriptor.
 *	Mode can be either BLOCKING or NON_BLOCKING.
 *
+*	The send and receive functions do not depend on the descriptor
+*	mode: they pass the I/O mode of each call to the kernel as a
+*	message flag.  net_setiomode() is used by net_accept() and when an
+*	endpoint is opened, and by applications that operate on the
+*	descriptor directly.
+*
 * Return Values:
 *	net_setiomode() returns SUCCESS on success.
 *
@@ -671,7 +712,7 @@ io_mode mode;				/* socket I/O mode */
     int on  = 1;			/* on/off flags for ioctl() */
     int off = 0;
 
-    if (net_sockfd[sockfd].type == UNDEF)
+    if (NET_TYPE (sockfd) == UNDEF)
 	return NBADFD;
 
     /* change socket I/O mode if different */
@@ -696,3 +737,82 @@ io_mode mode;				/* socket I/O mode */
     return (0);
 }
 
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*       int net_batch_begin (sockfd)
+*       int net_batch_flush (sockfd)
+* 
+* Description:
+*	net_batch_begin() corks a connected TCP socket (TCP_CORK), so that
+*	the messages sent on it by any number of calls are held by the
+*	kernel and packed into full segments.  net_batch_flush() removes
+*	the cork, which sends what is held at once.
+*
+*	Use them around the sends of a tick when its messages cannot be
+*	given to a single net_send_many() call, e.g. when they are sent
+*	from different places or with different functions.
+*
+* Return Values:
+*	net_batch_begin() and net_batch_flush() return SUCCESS on success.
+*
+*	On failure, they return:
+*
+*	NBADFD		when sockfd is not a valid TCP socket descriptor.
+*
+*	ERROR		on a setsockopt() call error, with errno containing
+*			the error indication.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	Each call is a setsockopt() system call; net_send_many() needs
+*	none.
+*
+* Portability:
+*	TCP_CORK is Linux specific.
+*
+* Notes:
+*	The cork applies to the socket, and so to the sends of all threads
+*	sharing it.  The kernel sends corked data anyway after 200 ms.
+* 
+*************************************************************************** */
+#endif
+
+int net_batch_begin (sockfd)
+int sockfd;				/* socket descriptor */
+{
+    return net_setcork (sockfd, 1);
+}
+
+int net_batch_flush (sockfd)
+int sockfd;				/* socket descriptor */
+{
+    return net_setcork (sockfd, 0);
+}
+
+/* ***************************************************************************
+*
+* net_setcork() sets (on = 1) or clears (on = 0) TCP_CORK on a socket.
+*
+*************************************************************************** */
+
+static int net_setcork (sockfd, on)
+int sockfd;				/* socket descriptor */
+int on;					/* new TCP_CORK value */
+{
+    /* validate socket descriptor */
+
+    if (sockfd < 0 || sockfd >= NET_MAX_FD ||
+				NET_TYPE (sockfd) != TCP)
+	return NBADFD;
+
+    if (setsockopt (sockfd, IPPROTO_TCP, TCP_CORK, (char *) &on,
+						    sizeof (on)) == ERROR)
+	return ERROR;
+
+    return (0);
+}
@@ -0,0 +1,922 @@
+/* net_udp.c -- UDP Endpoint Initialization, Send and Receive Functions */
+
+/*----------------------------------------------------------------------------
+ * Copyright (c) 1995-2010,2015, Jet Propulsion Laboratory
+ * Permission is granted to make and distribute copies of this software
+ * without fee, provided the above copyright notice and this permission notice
+ * are preserved on all copies.  All other rights reserved.  The software is
+ * provided "as is" without express or implied warranty, and no representation
+ * is made about its suitability for any purpose.
+ *
+ * Description:
+ *	This module contains functions for opening UDP endpoints and for
+ *	sending and receiving datagrams in a connectionless communication.
+ *	Each datagram carries exactly one message, so no internal message
+ *	header is added.  The multi-datagram functions use sendmmsg() and
+ *	recvmmsg() to move a whole burst of datagrams in one system call.
+ *	Multicast endpoints let a publisher deliver a datagram to any number
+ *	of subscribers with a single send.
+ *
+ *--------------------------------------------------------------------------*/
+
+#define _GNU_SOURCE		/* for sendmmsg() and recvmmsg() */
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <string.h>
+#include <errno.h>
+
+#include "net_appl.h"
+#include "net.h"
+
+#define NET_MAX_MMSG	(1024)	/* max datagrams per sendmmsg/recvmmsg */
+
+/* external variable declarations */
+
+extern sockfd_entry net_sockfd[];
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_udp_addr (endpt, hostname, addr)
+*
+* Description:
+*	net_udp_addr() fills in the socket address addr of the UDP
+*	endpoint named endpt on host hostname.  The address can be used in
+*	subsequent net_udp_sendto() or net_udp_sendmmsg() calls.  If
+*	hostname is NULL, the wildcard address is used.
+*
+* Return Values:
+*	net_udp_addr() returns SUCCESS on success.
+*
+*	On failure, it returns:
+*
+*	NBADADDR	when addr is not a valid pointer.
+*
+*	NBADENDPT	when the endpoint name is not a valid UDP endpoint.
+*
+*	NBADHOST	when the hostname is not a valid hostname.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	This function uses the Berkeley socket facility for network
+*	communications.
+*
+* Notes:
+*	None.
+*
+*************************************************************************** */
+#endif
+
+int net_udp_addr (endpt, hostname, addr)
+char *endpt;				/* UDP endpoint name */
+char *hostname;				/* endpoint's hostname */
+struct sockaddr_in *addr;		/* returned socket address */
+{
+    int port;				/* endpoint's port number */
+    struct hostent *hostp;		/* endpoint's host entry pointer */
+
+    if (addr == NULL)
+	return NBADADDR;
+
+    (void) memset ((char *) addr, 0, sizeof (*addr));
+    addr->sin_family = AF_INET;
+
+    /* get port number associated with endpoint name */
+
+    if (endpt == NULL || (port = net_getservport (endpt, UDP)) == ERROR)
+	return NBADENDPT;
+    else
+	addr->sin_port = htons (port);
+
+    /* get endpoint's host address */
+
+    if (hostname == NULL)
+	addr->sin_addr.s_addr = htonl (INADDR_ANY);
+
+    else if ((hostp = gethostbyname (hostname)) == NULL)
+	return NBADHOST;
+
+    else
+	(void) memcpy ((char *) &addr->sin_addr, hostp->h_addr,
+							hostp->h_length);
+    return (0);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_udp_open (endpt, hostname, mode)
+*
+* Description:
+*	net_udp_open() opens a UDP endpoint.
+*
+*	If hostname is NULL, the socket is bound to the port of the local
+*	UDP endpoint named endpt, so that it can receive datagrams sent to
+*	that endpoint; if endpt is also NULL, an unused port is chosen.
+*
+*	If hostname is not NULL, the socket is bound to an unused port and
+*	connected to the UDP endpoint named endpt on host hostname.
+*	net_send() and net_recv() can then be used on the socket to
+*	exchange datagrams with that endpoint only.
+*
+*	The mode parameter sets the initial I/O mode of the socket.
+*
+* Return Values:
+*	On success, net_udp_open() returns a socket descriptor to be used
+*	in subsequent UDP send and receive calls, and in net_close().
+*
+*	On failure, it returns:
+*
+*	NBADENDPT	when the endpoint name is not a valid UDP endpoint.
+*
+*	NBADHOST	when the hostname is not a valid hostname.
+*
+*	NBADMODE	when the mode is not a valid I/O mode.
+*
+*	ERROR		on a system call error, with errno containing the
+*			error indication.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	This function uses the Berkeley socket facility for network
+*	communications.
+*
+* Notes:
+*	None.
+*
+*************************************************************************** */
+#endif
+
+int net_udp_open (endpt, hostname, mode)
+char *endpt;				/* UDP endpoint name */
+char *hostname;				/* remote host, NULL to listen */
+io_mode mode;				/* socket I/O mode */
+{
+    struct sockaddr_in local;		/* local socket address */
+    struct sockaddr_in remote;		/* remote socket address */
+    int sockfd;				/* UDP socket descriptor */
+    int status;				/* return status */
+    int on = 1;				/* option flag for setsockopt() */
+
+    if (mode != BLOCKING && mode != NON_BLOCKING)
+	return NBADMODE;
+
+    /* initialize local and remote addresses */
+
+    (void) memset ((char *) &local, 0, sizeof (local));
+    local.sin_family      = AF_INET;
+    local.sin_addr.s_addr = htonl (INADDR_ANY);
+
+    if (hostname == NULL) {
+	if (endpt != NULL &&
+		(status = net_udp_addr (endpt, NULL, &local)) < 0)
+	    return status;
+    }
+    else if ((status = net_udp_addr (endpt, hostname, &remote)) < 0)
+	return status;
+
+    /* create socket and bind to local address */
+
+    if ((sockfd = socket (AF_INET, SOCK_DGRAM, 0)) == ERROR)
+	return ERROR;
+
+    if (sockfd >= NET_MAX_FD) {
+	(void) close (sockfd);
+	errno = EMFILE;
+	return ERROR;
+    }
+
+    if (setsockopt (sockfd, SOL_SOCKET, SO_REUSEADDR, (char *) &on,
+						      sizeof on) == ERROR ||
+	bind (sockfd, (struct sockaddr *) &local,
+					  sizeof (local)) == ERROR) {
+	(void) close (sockfd);
+	return ERROR;
+    }
+
+    /* set default destination */
+
+    if (hostname != NULL &&
+	connect (sockfd, (struct sockaddr *) &remote,
+					     sizeof (remote)) == ERROR) {
+	(void) close (sockfd);
+	return ERROR;
+    }
+
+    net_sockfd_open (sockfd, UDP, BLOCKING);
+
+    if ((status = net_setiomode (sockfd, mode)) < 0) {
+	(void) net_close (sockfd);
+	return status;
+    }
+
+    return sockfd;
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_udp_sendto (sockfd, msg, length, to, mode)
+*
+* Description:
+*	net_udp_sendto() sends a message as a single datagram from a UDP
+*	endpoint to the address to.  If to is NULL, the datagram is sent
+*	to the endpoint the socket was connected to by net_udp_open().
+*
+* Return Values:
+*	On success, net_udp_sendto() returns the number of bytes sent.
+*
+*	On failure, it returns:
+*
+*	NBADFD		when sockfd is not a valid UDP socket descriptor.
+*
+*	NBADADDR	when the message pointer is not a valid pointer.
+*
+*	NBADLENGTH	when the message length either exceeds
+*			NET_MAX_UDP_LEN or is less than the minimum
+*			required.
+*
+*	NBADMODE	when the mode is not a valid I/O mode.
+*
+*	NWOULDBLOCK	when the I/O mode is NON_BLOCKING and the
+*			datagram could not be sent immediately.
+*
+*	ERROR		on a system call error, with errno containing the
+*			error indication.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	None.
+*
+*************************************************************************** */
+#endif
+
+int net_udp_sendto (sockfd, msg, length, to, mode)
+int sockfd;				/* UDP socket descriptor */
+char *msg;				/* message to be sent */
+int length;				/* message length in bytes */
+struct sockaddr_in *to;			/* destination, NULL if connected */
+io_mode mode;				/* send I/O mode */
+{
+    int flags;				/* per-call message flags */
+    int nsent;				/* number of bytes sent */
+
+    /* validate socket descriptor */
+
+    if (sockfd < 0 || sockfd >= NET_MAX_FD ||
+				    NET_TYPE (sockfd) != UDP)
+	return NBADFD;
+
+    /* validate msg pointer and length */
+
+    if (msg == (char *) NULL)
+	return NBADADDR;
+
+    if (length < NET_MIN_MSG_LEN || length > NET_MAX_UDP_LEN)
+	return NBADLENGTH;
+
+    /* validate socket I/O mode */
+
+    if (mode != BLOCKING && mode != NON_BLOCKING)
+	return NBADMODE;
+
+    flags = NET_IOFLAGS (NET_MODE_DEADLINE (mode));
+
+    do
+	nsent = sendto (sockfd, msg, length, flags, (struct sockaddr *) to,
+					    (to != NULL) ? sizeof (*to) : 0);
+    while (nsent == ERROR && (errno == EINTR ||
+	    (errno == EWOULDBLOCK && mode == BLOCKING &&
+	     net_wait (sockfd, POLLOUT, &net_forever, (int *) NULL) == 0)));
+
+    if (nsent == ERROR)
+	return (errno == EWOULDBLOCK) ? NWOULDBLOCK : ERROR;
+
+    return (nsent);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_udp_recvfrom (sockfd, buff, maxlen, from, mode)
+*
+* Description:
+*	net_udp_recvfrom() receives a single datagram on a UDP endpoint.
+*	The datagram is placed into the array buff for up to maxlen bytes;
+*	if it is too long to fit, it is truncated and the excess bytes
+*	discarded.  If from is not NULL, the sender's address is returned
+*	in it.
+*
+* Return Values:
+*	On success, net_udp_recvfrom() returns the number of bytes placed
+*	in buff.
+*
+*	On failure, it returns:
+*
+*	NBADFD		when sockfd is not a valid UDP socket descriptor.
+*
+*	NBADADDR	when the buffer pointer is not a valid pointer.
+*
+*	NBADLENGTH	when maxlen is less than the minimum length
+*			required.
+*
+*	NBADMODE	when the mode is not a valid I/O mode.
+*
+*	NWOULDBLOCK	when the I/O mode is NON_BLOCKING and no
+*			datagrams were available to be received.
+*
+*	ERROR		on a system call error, with errno containing the
+*			error indication.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	None.
+*
+* Notes:
+*	None.
+*
+*************************************************************************** */
+#endif
+
+int net_udp_recvfrom (sockfd, buff, maxlen, from, mode)
+int sockfd;				/* UDP socket descriptor */
+char *buff;				/* buffer area to receive msg into */
+int maxlen;				/* length in bytes of buffer area */
+struct sockaddr_in *from;		/* returned sender's address */
+io_mode mode;				/* receive I/O mode */
+{
+    int flags;				/* per-call message flags */
+    int nread;				/* number of bytes received */
+    socklen_t from_len;			/* length of sender's address */
+
+    /* validate socket descriptor */
+
+    if (sockfd < 0 || sockfd >= NET_MAX_FD ||
+				    NET_TYPE (sockfd) != UDP)
+	return NBADFD;
+
+    /* validate buff pointer and length */
+
+    if (buff == (char *) NULL)
+	return NBADADDR;
+
+    if (maxlen < NET_MIN_MSG_LEN)
+	return NBADLENGTH;
+
+    /* validate socket I/O mode */
+
+    if (mode != BLOCKING && mode != NON_BLOCKING)
+	return NBADMODE;
+
+    flags = NET_IOFLAGS (NET_MODE_DEADLINE (mode));
+
+    do {
+	from_len = sizeof (*from);
+	nread = recvfrom (sockfd, buff, maxlen, flags,
+			  (struct sockaddr *) from,
+			  (from != NULL) ? &from_len : NULL);
+    } while (nread == ERROR && (errno == EINTR ||
+	    (errno == EWOULDBLOCK && mode == BLOCKING &&
+	     net_wait (sockfd, POLLIN, &net_forever, (int *) NULL) == 0)));
+
+    if (nread == ERROR)
+	return (errno == EWOULDBLOCK) ? NWOULDBLOCK : ERROR;
+
+    return (nread);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_udp_sendmmsg (sockfd, msgv, vlen, mode)
+*
+* Description:
+*	net_udp_sendmmsg() sends vlen datagrams from a UDP endpoint with
+*	as few sendmmsg() system calls as possible.  Datagram i consists
+*	of msgv[i].len bytes at msgv[i].buf and is sent to msgv[i].addr.
+*	This allows a server to send one datagram to each of its clients
+*	in a single system call per tick.
+*
+* Return Values:
+*	On success, net_udp_sendmmsg() returns the number of datagrams
+*	sent.  When the I/O mode is BLOCKING, this is always vlen.
+*
+*	On failure, it returns:
+*
+*	NBADFD		when sockfd is not a valid UDP socket descriptor.
+*
+*	NBADADDR	when msgv or a buffer pointer is not valid.
+*
+*	NBADLENGTH	when vlen is less than one, or a datagram length
+*			either exceeds NET_MAX_UDP_LEN or is less than
+*			the minimum required.
+*
+*	NBADMODE	when the mode is not a valid I/O mode.
+*
+*	NWOULDBLOCK	when the I/O mode is NON_BLOCKING and no
+*			datagrams could be sent immediately.
+*
+*	ERROR		on a system call error, with errno containing the
+*			error indication.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	sendmmsg() is Linux specific.
+*
+* Notes:
+*	None.
+*
+*************************************************************************** */
+#endif
+
+int net_udp_sendmmsg (sockfd, msgv, vlen, mode)
+int sockfd;				/* UDP socket descriptor */
+net_udpmsg *msgv;			/* datagrams to be sent */
+int vlen;				/* number of datagrams */
+io_mode mode;				/* send I/O mode */
+{
+    struct mmsghdr hdrs[NET_MAX_MMSG];	/* sendmmsg() headers */
+    struct iovec iovs[NET_MAX_MMSG];	/* datagram buffers */
+    int flags;				/* per-call message flags */
+    int status;				/* return status */
+    int nsent;				/* number of datagrams sent */
+    int nhdrs;				/* headers in current call */
+    int i;				/* loop index */
+
+    /* validate socket descriptor */
+
+    if (sockfd < 0 || sockfd >= NET_MAX_FD ||
+				    NET_TYPE (sockfd) != UDP)
+	return NBADFD;
+
+    /* validate datagram vector */
+
+    if (msgv == (net_udpmsg *) NULL)
+	return NBADADDR;
+
+    if (vlen < 1)
+	return NBADLENGTH;
+
+    for (i = 0; i < vlen; i++) {
+	if (msgv[i].buf == (char *) NULL)
+	    return NBADADDR;
+	if (msgv[i].len < NET_MIN_MSG_LEN || msgv[i].len > NET_MAX_UDP_LEN)
+	    return NBADLENGTH;
+    }
+
+    /* validate socket I/O mode */
+
+    if (mode != BLOCKING && mode != NON_BLOCKING)
+	return NBADMODE;
+
+    flags = NET_IOFLAGS (NET_MODE_DEADLINE (mode));
+
+    /* send in chunks of up to NET_MAX_MMSG datagrams */
+
+    nsent = 0;
+
+    while (nsent < vlen) {
+
+	nhdrs = (vlen - nsent < NET_MAX_MMSG) ? vlen - nsent : NET_MAX_MMSG;
+
+	(void) memset (hdrs, 0, nhdrs * sizeof (hdrs[0]));
+	for (i = 0; i < nhdrs; i++) {
+	    iovs[i].iov_base = msgv[nsent + i].buf;
+	    iovs[i].iov_len  = msgv[nsent + i].len;
+	    hdrs[i].msg_hdr.msg_name    = &msgv[nsent + i].addr;
+	    hdrs[i].msg_hdr.msg_namelen = sizeof (msgv[nsent + i].addr);
+	    hdrs[i].msg_hdr.msg_iov     = &iovs[i];
+	    hdrs[i].msg_hdr.msg_iovlen  = 1;
+	}
+
+	status = sendmmsg (sockfd, hdrs, nhdrs, flags);
+
+	if (status == ERROR) {
+	    if (errno == EINTR) {
+		errno = 0;
+		continue;
+	    }
+	    else if (errno == EWOULDBLOCK && mode == BLOCKING) {
+		if ((status = net_wait (sockfd, POLLOUT, &net_forever,
+						    (int *) NULL)) < 0)
+		    return (nsent > 0) ? nsent : status;
+		continue;
+	    }
+	    else if (errno == EWOULDBLOCK)
+		return (nsent > 0) ? nsent : NWOULDBLOCK;
+
+	    else
+		return (nsent > 0) ? nsent : ERROR;
+	}
+	nsent += status;
+
+	if (mode == NON_BLOCKING && status < nhdrs)
+	    break;
+    }
+
+    return (nsent);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_udp_recvmmsg (sockfd, msgv, vlen, mode)
+*
+* Description:
+*	net_udp_recvmmsg() receives up to vlen datagrams on a UDP endpoint
+*	with a single recvmmsg() system call.  Datagram i is placed into
+*	msgv[i].buf for up to msgv[i].maxlen bytes (excess bytes are
+*	discarded), its length is returned in msgv[i].len and the sender's
+*	address in msgv[i].addr.
+*
+*	If mode is BLOCKING, net_udp_recvmmsg() waits for the first
+*	datagram and then returns it together with every further datagram
+*	already queued, up to vlen.  If mode is NON_BLOCKING, it only
+*	returns datagrams already queued.
+*
+* Return Values:
+*	On success, net_udp_recvmmsg() returns the number of datagrams
+*	received (at least one).
+*
+*	On failure, it returns:
+*
+*	NBADFD		when sockfd is not a valid UDP socket descriptor.
+*
+*	NBADADDR	when msgv or a buffer pointer is not valid.
+*
+*	NBADLENGTH	when vlen is out of range, or a buffer length is
+*			less than the minimum required.
+*
+*	NBADMODE	when the mode is not a valid I/O mode.
+*
+*	NWOULDBLOCK	when the I/O mode is NON_BLOCKING and no
+*			datagrams were available to be received.
+*
+*	ERROR		on a system call error, with errno containing the
+*			error indication.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	recvmmsg() is Linux specific.
+*
+* Notes:
+*	vlen may not exceed 1024.
+*
+*************************************************************************** */
+#endif
+
+int net_udp_recvmmsg (sockfd, msgv, vlen, mode)
+int sockfd;				/* UDP socket descriptor */
+net_udpmsg *msgv;			/* datagrams to receive into */
+int vlen;				/* number of entries in msgv */
+io_mode mode;				/* receive I/O mode */
+{
+    struct mmsghdr hdrs[NET_MAX_MMSG];	/* recvmmsg() headers */
+    struct iovec iovs[NET_MAX_MMSG];	/* datagram buffers */
+    int flags;				/* per-call message flags */
+    int nrecv;				/* number of datagrams received */
+    int i;				/* loop index */
+
+    /* validate socket descriptor */
+
+    if (sockfd < 0 || sockfd >= NET_MAX_FD ||
+				    NET_TYPE (sockfd) != UDP)
+	return NBADFD;
+
+    /* validate datagram vector */
+
+    if (msgv == (net_udpmsg *) NULL)
+	return NBADADDR;
+
+    if (vlen < 1 || vlen > NET_MAX_MMSG)
+	return NBADLENGTH;
+
+    (void) memset (hdrs, 0, vlen * sizeof (hdrs[0]));
+    for (i = 0; i < vlen; i++) {
+	if (msgv[i].buf == (char *) NULL)
+	    return NBADADDR;
+	if (msgv[i].maxlen < NET_MIN_MSG_LEN)
+	    return NBADLENGTH;
+
+	iovs[i].iov_base = msgv[i].buf;
+	iovs[i].iov_len  = msgv[i].maxlen;
+	hdrs[i].msg_hdr.msg_name    = &msgv[i].addr;
+	hdrs[i].msg_hdr.msg_namelen = sizeof (msgv[i].addr);
+	hdrs[i].msg_hdr.msg_iov     = &iovs[i];
+	hdrs[i].msg_hdr.msg_iovlen  = 1;
+    }
+
+    /* validate socket I/O mode */
+
+    if (mode != BLOCKING && mode != NON_BLOCKING)
+	return NBADMODE;
+
+    flags = NET_IOFLAGS (NET_MODE_DEADLINE (mode));
+
+    /* wait for the first datagram only, then drain the queue */
+
+    do
+	nrecv = recvmmsg (sockfd, hdrs, vlen, MSG_WAITFORONE | flags, NULL);
+    while (nrecv == ERROR && (errno == EINTR ||
+	    (errno == EWOULDBLOCK && mode == BLOCKING &&
+	     net_wait (sockfd, POLLIN, &net_forever, (int *) NULL) == 0)));
+
+    if (nrecv == ERROR)
+	return (errno == EWOULDBLOCK) ? NWOULDBLOCK : ERROR;
+
+    for (i = 0; i < nrecv; i++)
+	msgv[i].len = hdrs[i].msg_len;
+
+    return (nrecv);
+}
+
+/* ***************************************************************************
+*
+* net_mcast_addr() fills in the group address and port of the multicast
+* endpoint named endpt, and the address of the local interface ifname to
+* be used for it.  It returns SUCCESS, NBADENDPT or NBADHOST.
+*
+*************************************************************************** */
+
+static int net_mcast_addr (endpt, ifname, group, ifaddr)
+char *endpt;				/* multicast endpoint name */
+char *ifname;				/* local interface hostname */
+struct sockaddr_in *group;		/* returned group address */
+struct in_addr *ifaddr;			/* returned interface address */
+{
+    struct hostent *hostp;		/* interface's host entry pointer */
+    endpt_entry entry;			/* multicast endpoint entry */
+
+    (void) memset ((char *) group, 0, sizeof (*group));
+    group->sin_family = AF_INET;
+
+    if (endpt == NULL)
+	return NBADENDPT;
+
+    if (net_getendpt (endpt, MCAST, &entry) != SUCCESS ||
+	    entry.group == NULL ||
+	    inet_pton (AF_INET, entry.group, &group->sin_addr) != 1 ||
+	    !IN_MULTICAST (ntohl (group->sin_addr.s_addr)))
+	return NBADENDPT;
+
+    group->sin_port = htons (entry.port);
+
+    /* get local interface address, or let the routing table choose */
+
+    if (ifname == NULL)
+	ifaddr->s_addr = htonl (INADDR_ANY);
+
+    else if ((hostp = gethostbyname (ifname)) == NULL)
+	return NBADHOST;
+
+    else
+	(void) memcpy ((char *) ifaddr, hostp->h_addr, sizeof (*ifaddr));
+
+    return (0);
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_mcast_open (endpt, ifname, mode)
+*
+* Description:
+*	net_mcast_open() opens a publisher socket on the multicast endpoint
+*	named endpt.  The socket is connected to the endpoint's group, so
+*	that each net_send() or net_udp_sendto() with a NULL destination
+*	delivers one datagram to every member of the group with a single
+*	system call, regardless of the number of subscribers.
+*
+*	If ifname is not NULL, datagrams are sent on the local interface
+*	with that hostname (e.g., "localhost" for loopback tests);
+*	otherwise the interface is chosen by the routing table.  Multicast
+*	loopback is enabled so that subscribers on the publisher's host
+*	receive the datagrams too, and the TTL is limited to the local
+*	network.
+*
+* Return Values:
+*	On success, net_mcast_open() returns a socket descriptor to be used
+*	in subsequent send calls, and in net_close().
+*
+*	On failure, it returns:
+*
+*	NBADENDPT	when the endpoint name is not a valid multicast
+*			endpoint.
+*
+*	NBADHOST	when ifname is not a valid hostname.
+*
+*	NBADMODE	when the mode is not a valid I/O mode.
+*
+*	ERROR		on a system call error, with errno containing the
+*			error indication.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	The cost of a send is independent of the number of subscribers.
+*
+* Portability:
+*	This function uses the IP multicast socket options.
+*
+* Notes:
+*	Multicast delivery is unreliable, as for any UDP endpoint.
+*
+*************************************************************************** */
+#endif
+
+int net_mcast_open (endpt, ifname, mode)
+char *endpt;				/* multicast endpoint name */
+char *ifname;				/* local interface, NULL for default */
+io_mode mode;				/* socket I/O mode */
+{
+    struct sockaddr_in group;		/* multicast group address */
+    struct in_addr ifaddr;		/* local interface address */
+    int sockfd;				/* UDP socket descriptor */
+    int status;				/* return status */
+    unsigned char loop = 1;		/* deliver to local members */
+    unsigned char ttl  = 1;		/* do not leave the local network */
+
+    if (mode != BLOCKING && mode != NON_BLOCKING)
+	return NBADMODE;
+
+    if ((status = net_mcast_addr (endpt, ifname, &group, &ifaddr)) < 0)
+	return status;
+
+    if ((sockfd = socket (AF_INET, SOCK_DGRAM, 0)) == ERROR)
+	return ERROR;
+
+    if (sockfd >= NET_MAX_FD) {
+	(void) close (sockfd);
+	errno = EMFILE;
+	return ERROR;
+    }
+
+    if (setsockopt (sockfd, IPPROTO_IP, IP_MULTICAST_LOOP, (char *) &loop,
+						      sizeof loop) == ERROR ||
+	setsockopt (sockfd, IPPROTO_IP, IP_MULTICAST_TTL, (char *) &ttl,
+						      sizeof ttl) == ERROR ||
+	(ifname != NULL &&
+	 setsockopt (sockfd, IPPROTO_IP, IP_MULTICAST_IF, (char *) &ifaddr,
+						   sizeof ifaddr) == ERROR) ||
+	connect (sockfd, (struct sockaddr *) &group,
+					     sizeof (group)) == ERROR) {
+	(void) close (sockfd);
+	return ERROR;
+    }
+
+    net_sockfd_open (sockfd, UDP, BLOCKING);
+
+    if ((status = net_setiomode (sockfd, mode)) < 0) {
+	(void) net_close (sockfd);
+	return status;
+    }
+
+    return sockfd;
+}
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_mcast_join (endpt, ifname, mode)
+*
+* Description:
+*	net_mcast_join() opens a subscriber socket on the multicast endpoint
+*	named endpt: the socket is bound to the endpoint's port and joins
+*	its group on the local interface with hostname ifname, or on the
+*	default interface if ifname is NULL.  Datagrams published to the
+*	group can then be received with net_recv(), net_udp_recvfrom() or
+*	net_udp_recvmmsg().  Several subscribers on the same host may join
+*	the same endpoint.  The group is left when the socket is closed.
+*
+* Return Values:
+*	On success, net_mcast_join() returns a socket descriptor to be used
+*	in subsequent receive calls, and in net_close().
+*
+*	On failure, it returns:
+*
+*	NBADENDPT	when the endpoint name is not a valid multicast
+*			endpoint.
+*
+*	NBADHOST	when ifname is not a valid hostname.
+*
+*	NBADMODE	when the mode is not a valid I/O mode.
+*
+*	ERROR		on a system call error, with errno containing the
+*			error indication.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	N/A
+*
+* Portability:
+*	This function uses the IP multicast socket options.
+*
+* Notes:
+*	None.
+*
+*************************************************************************** */
+#endif
+
+int net_mcast_join (endpt, ifname, mode)
+char *endpt;				/* multicast endpoint name */
+char *ifname;				/* local interface, NULL for default */
+io_mode mode;				/* socket I/O mode */
+{
+    struct sockaddr_in group;		/* multicast group address */
+    struct sockaddr_in local;		/* local socket address */
+    struct ip_mreq mreq;		/* group membership request */
+    int sockfd;				/* UDP socket descriptor */
+    int status;				/* return status */
+    int on = 1;				/* option flag for setsockopt() */
+
+    if (mode != BLOCKING && mode != NON_BLOCKING)
+	return NBADMODE;
+
+    if ((status = net_mcast_addr (endpt, ifname, &group,
+					  &mreq.imr_interface)) < 0)
+	return status;
+
+    mreq.imr_multiaddr = group.sin_addr;
+
+    /* bind to the group's port so that only its datagrams are received */
+
+    local = group;
+
+    if ((sockfd = socket (AF_INET, SOCK_DGRAM, 0)) == ERROR)
+	return ERROR;
+
+    if (sockfd >= NET_MAX_FD) {
+	(void) close (sockfd);
+	errno = EMFILE;
+	return ERROR;
+    }
+
+    if (setsockopt (sockfd, SOL_SOCKET, SO_REUSEADDR, (char *) &on,
+						      sizeof on) == ERROR ||
+	bind (sockfd, (struct sockaddr *) &local,
+					  sizeof (local)) == ERROR ||
+	setsockopt (sockfd, IPPROTO_IP, IP_ADD_MEMBERSHIP, (char *) &mreq,
+						      sizeof mreq) == ERROR) {
+	(void) close (sockfd);
+	return ERROR;
+    }
+
+    net_sockfd_open (sockfd, UDP, BLOCKING);
+
+    if ((status = net_setiomode (sockfd, mode)) < 0) {
+	(void) net_close (sockfd);
+	return status;
+    }
+
+    return sockfd;
+}
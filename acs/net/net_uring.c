@@ -0,0 +1,470 @@
+/* net_uring.c -- io_uring Fan-out Send Functions */
+
+/*----------------------------------------------------------------------------
+ * Copyright (c) 1995-2010,2015, Jet Propulsion Laboratory
+ * Permission is granted to make and distribute copies of this software
+ * without fee, provided the above copyright notice and this permission notice
+ * are preserved on all copies.  All other rights reserved.  The software is
+ * provided "as is" without express or implied warranty, and no representation
+ * is made about its suitability for any purpose.
+ *
+ * Description:
+ *	This module contains net_send_fanout(), which sends one message to
+ *	many connected endpoints with a single io_uring_enter() system call
+ *	instead of one send per endpoint.  The ring is set up on first use
+ *	directly with the io_uring system calls, so no extra library is
+ *	needed.  Where io_uring is not available, each endpoint is sent to
+ *	with net_send().
+ *
+ *--------------------------------------------------------------------------*/
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <linux/io_uring.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "net_appl.h"
+#include "net.h"
+
+#define NET_URING_ENTRIES	(512)	/* max sends per io_uring_enter() */
+
+/* external variable declarations */
+
+extern sockfd_entry net_sockfd[];
+
+/* submission and completion rings shared with the kernel */
+
+static struct {
+    int state;				/* 0 not set up, 1 ready, ERROR
+					   if io_uring is unavailable */
+    int fd;				/* ring file descriptor */
+    unsigned *sq_tail;			/* submission queue tail */
+    unsigned *sq_mask;			/* submission queue index mask */
+    unsigned *sq_array;			/* submission queue entry indexes */
+    struct io_uring_sqe *sqes;		/* submission queue entries */
+    unsigned *cq_head;			/* completion queue head */
+    unsigned *cq_tail;			/* completion queue tail */
+    unsigned *cq_mask;			/* completion queue index mask */
+    struct io_uring_cqe *cqes;		/* completion queue entries */
+} net_ring;
+
+/* per-send state of a batch, indexed by submission queue entry */
+
+static struct msghdr fan_msg[NET_URING_ENTRIES];
+static struct iovec fan_iov[NET_URING_ENTRIES][2];
+static struct msg_hdr_v2 fan_hdr[NET_URING_ENTRIES];
+static int fan_idx[NET_URING_ENTRIES];	/* index into fdv */
+static int fan_fd[NET_URING_ENTRIES];	/* socket descriptor */
+static int fan_res[NET_URING_ENTRIES];	/* completion result */
+
+/* serializes use of the ring and of the batch state */
+
+static pthread_mutex_t net_ring_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int net_uring_setup ();
+static int net_uring_run ();
+static int net_uring_status ();
+
+#ifdef FUNCT_HDR
+/* ***************************************************************************
+*
+* Synopsis:
+*	int net_send_fanout (fdv, nfd, msg, length, mode, statusv)
+*
+* Description:
+*	net_send_fanout() sends the same message to each of the nfd
+*	connected endpoints in the array fdv, as if net_send() were called
+*	for each of them in turn, and stores the result of each send in
+*	the corresponding element of statusv.
+*
+*	All sends are queued on an io_uring submission ring and handed to
+*	the kernel together, so that a whole fan-out costs one system call
+*	instead of nfd.  With mode BLOCKING, net_send_fanout() returns
+*	once every message is sent; a slow endpoint does not hold up the
+*	sends to the others.  With mode NON_BLOCKING, it never waits, and
+*	the rest of a partially sent message is kept with its socket as
+*	described for net_send().
+*
+* Return Values:
+*	On success, net_send_fanout() returns the number of endpoints the
+*	message was sent to.  statusv[i] holds the value net_send() would
+*	have returned for fdv[i]: length, NEOF, NBADFD, NWOULDBLOCK or
+*	ERROR.
+*
+*	On failure, it returns:
+*
+*	NBADADDR	when msg, fdv or statusv is not a valid pointer.
+*
+*	NBADLENGTH	when the requested message length either exceeds
+*			the maximum length allowed or is less than the
+*			minimum required.
+*
+*	NBADMODE	when the mode is not a valid I/O mode.
+*
+*	ERROR		on a system call error of the ring itself, with
+*			errno containing the error indication.  The
+*			elements of statusv are then undefined.
+*
+* Environment Access:
+*	None.
+*
+* Performance:
+*	Up to NET_URING_ENTRIES sends are submitted and completed with a
+*	single io_uring_enter().  A socket that has the rest of an earlier
+*	message pending, a socket another thread is sending on, and a UDP
+*	socket, is sent to with net_send() once the batch is complete.
+*
+* Portability:
+*	io_uring requires Linux 5.4 or later.  Where it is not available,
+*	or has been disabled by the administrator, every endpoint is sent
+*	to with net_send().
+*
+* Notes:
+*	The ring is shared by all callers in the process and is kept
+*	until the process exits.  Threads calling net_send_fanout() at
+*	the same time take turns using it.
+*
+*************************************************************************** */
+#endif
+
+int net_send_fanout (fdv, nfd, msg, length, mode, statusv)
+int *fdv;				/* endpoint socket descriptors */
+int nfd;				/* number of endpoints */
+char *msg;				/* message to be sent */
+int length;				/* message length in bytes */
+io_mode mode;				/* send I/O mode */
+int *statusv;				/* returned status per endpoint */
+{
+    int defer[NET_URING_ENTRIES];	/* endpoints sent to with net_send() */
+    int flush[NET_URING_ENTRIES];	/* endpoints with a pending rest */
+    int ndefer;				/* number of deferred endpoints */
+    int nflush;				/* number of endpoints to flush */
+    int sockfd;				/* endpoint socket descriptor */
+    int nsent;				/* number of endpoints sent to */
+    int n;				/* number of sends in batch */
+    int i, j, k;			/* loop indexes */
+    int status;				/* return status */
+
+    /* validate pointers and msg length */
+
+    if (msg == (char *) NULL || fdv == (int *) NULL ||
+						statusv == (int *) NULL)
+	return NBADADDR;
+
+    if (length < NET_MIN_MSG_LEN || length > NET_MAX_MSG_LEN)
+	return NBADLENGTH;
+
+    if (mode != BLOCKING && mode != NON_BLOCKING)
+	return NBADMODE;
+
+    nsent = 0;
+    i = 0;
+
+    while (i < nfd) {
+
+	/* queue up to a ring's worth of sends; the send lock of each
+	   socket is held until its send is complete.  Each endpoint taken
+	   is either deferred now or queued, and a queued send is deferred
+	   or flushed at most once after the batch: keeping the sends and
+	   deferrals within NET_URING_ENTRIES keeps defer[] and flush[]
+	   within theirs */
+
+	(void) pthread_mutex_lock (&net_ring_lock);
+
+	ndefer = nflush = 0;
+
+	for (n = 0; i < nfd && n + ndefer < NET_URING_ENTRIES; i++) {
+
+	    sockfd = fdv[i];
+
+	    if (sockfd < 0 || sockfd >= NET_MAX_FD ||
+				    NET_TYPE (sockfd) == UNDEF) {
+		statusv[i] = NBADFD;
+		continue;
+	    }
+
+	    /* a socket busy in another thread, or listed twice, and a
+	       socket with the rest of a message pending is left to
+	       net_send() */
+
+	    if (net_uring_setup () != SUCCESS ||
+			NET_TYPE (sockfd) != TCP ||
+			pthread_mutex_trylock (&net_sockfd[sockfd].txlock) != 0) {
+		defer[ndefer++] = i;
+		continue;
+	    }
+	    if (net_sockfd[sockfd].txbuf != NULL) {
+		(void) pthread_mutex_unlock (&net_sockfd[sockfd].txlock);
+		defer[ndefer++] = i;
+		continue;
+	    }
+
+	    fan_iov[n][0].iov_base = (char *) &fan_hdr[n];
+	    fan_iov[n][0].iov_len  = net_hdr_make (sockfd, length,
+								&fan_hdr[n]);
+	    fan_iov[n][1].iov_base = msg;
+	    fan_iov[n][1].iov_len  = length;
+
+	    (void) memset (&fan_msg[n], 0, sizeof (struct msghdr));
+	    fan_msg[n].msg_iov    = fan_iov[n];
+	    fan_msg[n].msg_iovlen = 2;
+
+	    fan_fd[n]    = sockfd;
+	    fan_idx[n++] = i;
+	}
+
+	/* submit the batch and collect its completions */
+
+	status = (n > 0) ? net_uring_run (n, mode) : SUCCESS;
+
+	for (k = 0; k < n; k++) {
+	    if (status == SUCCESS) {
+		statusv[fan_idx[k]] = net_uring_status (k, length);
+		if (statusv[fan_idx[k]] > 0)
+		    net_txdone (fan_fd[k], (int) fan_iov[k][0].iov_len + length);
+
+		/* a BLOCKING send waits for the socket outside the batch */
+
+		if (mode == BLOCKING && statusv[fan_idx[k]] == NWOULDBLOCK)
+		    defer[ndefer++] = fan_idx[k];
+		else if (mode == BLOCKING &&
+				    net_sockfd[fan_fd[k]].txbuf != NULL)
+		    flush[nflush++] = fan_idx[k];
+		else if (statusv[fan_idx[k]] > 0)
+		    nsent++;
+	    }
+	    (void) pthread_mutex_unlock (&net_sockfd[fan_fd[k]].txlock);
+	}
+
+	(void) pthread_mutex_unlock (&net_ring_lock);
+
+	if (status < 0)
+	    return ERROR;
+
+	for (j = 0; j < ndefer; j++)
+	    if ((statusv[defer[j]] = net_send (fdv[defer[j]], msg, length,
+							    mode)) > 0)
+		nsent++;
+
+	for (j = 0; j < nflush; j++) {
+	    if ((status = net_flush (fdv[flush[j]], BLOCKING)) < 0)
+		statusv[flush[j]] = (status == ERROR && errno == EPIPE) ?
+								NEOF : status;
+	    else
+		nsent++;
+	}
+    }
+
+    return (nsent);
+}
+
+/* ***************************************************************************
+*
+* net_uring_run() queues the n prepared sends on the submission ring,
+* enters the kernel until all of them are complete, and stores the result
+* of each send in fan_res[].  Returns SUCCESS, or ERROR on a system call
+* error.
+*
+*************************************************************************** */
+
+static int net_uring_run (n, mode)
+int n;					/* number of sends */
+io_mode mode;				/* send I/O mode */
+{
+    struct io_uring_sqe *sqe;		/* submission queue entry */
+    struct io_uring_cqe *cqe;		/* completion queue entry */
+    unsigned tail;			/* submission queue tail */
+    unsigned head;			/* completion queue head */
+    int nsubmit;			/* sends not yet submitted */
+    int ndone;				/* sends completed */
+    int status;				/* return status */
+    int k;				/* loop index */
+
+    tail = *net_ring.sq_tail;
+
+    for (k = 0; k < n; k++) {
+	sqe = &net_ring.sqes[k];
+	(void) memset (sqe, 0, sizeof (struct io_uring_sqe));
+	sqe->opcode    = IORING_OP_SENDMSG;
+	sqe->fd        = fan_fd[k];
+	sqe->addr      = (unsigned long) &fan_msg[k];
+	sqe->len       = 1;
+	sqe->msg_flags = (mode == NON_BLOCKING) ? MSG_DONTWAIT : 0;
+	sqe->user_data = k;
+
+	net_ring.sq_array[(tail + k) & *net_ring.sq_mask] = k;
+    }
+
+    /* make the entries visible to the kernel before the new tail */
+
+    __atomic_store_n (net_ring.sq_tail, tail + n, __ATOMIC_RELEASE);
+
+    nsubmit = n;
+    ndone = 0;
+
+    while (ndone < n) {
+
+	status = syscall (__NR_io_uring_enter, net_ring.fd, nsubmit,
+					    1, IORING_ENTER_GETEVENTS, NULL, 0);
+	if (status == ERROR) {
+	    if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+		errno = 0;
+		continue;
+	    }
+
+	    /* completions may still be pending: stop using the ring */
+
+	    net_ring.state = ERROR;
+	    return ERROR;
+	}
+	nsubmit -= status;
+
+	head = *net_ring.cq_head;
+
+	while (head != __atomic_load_n (net_ring.cq_tail, __ATOMIC_ACQUIRE)) {
+	    cqe = &net_ring.cqes[head & *net_ring.cq_mask];
+	    fan_res[cqe->user_data] = cqe->res;
+	    head++;
+	    ndone++;
+	}
+
+	__atomic_store_n (net_ring.cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    return SUCCESS;
+}
+
+/* ***************************************************************************
+*
+* net_uring_status() turns the completion result of send k of a batch into
+* the status a NON_BLOCKING net_send() would have returned.  The rest of a
+* partially sent message is kept with the socket.
+*
+*************************************************************************** */
+
+static int net_uring_status (k, length)
+int k;					/* send index in batch */
+int length;				/* message length in bytes */
+{
+    struct iovec *iov = fan_iov[k];	/* header and message */
+    int nwritten = fan_res[k];		/* number of bytes written */
+
+    if (nwritten < 0) {
+	errno = -nwritten;
+
+	if (errno == EWOULDBLOCK)
+	    return NWOULDBLOCK;
+
+	/* if broken pipe, return NEOF */
+	else if (errno == EPIPE)
+	    return NEOF;
+
+	return ERROR;
+    }
+    else if (nwritten == 0)
+	return NEOF;
+
+    if (nwritten == (int) (iov[0].iov_len + iov[1].iov_len))
+	return (length);
+
+    /* keep the rest of a partially sent message for later */
+
+    if (nwritten < (int) iov[0].iov_len) {
+	iov[0].iov_base = (char *) iov[0].iov_base + nwritten;
+	iov[0].iov_len -= nwritten;
+    }
+    else {
+	nwritten -= iov[0].iov_len;
+	iov[1].iov_base = (char *) iov[1].iov_base + nwritten;
+	iov[1].iov_len -= nwritten;
+	iov++;
+    }
+
+    if (net_txsave (fan_fd[k], iov, (iov == fan_iov[k]) ? 2 : 1) < 0)
+	return ERROR;
+
+    return (length);
+}
+
+/* ***************************************************************************
+*
+* net_uring_setup() creates the process's io_uring and maps its rings the
+* first time it is called.  Returns SUCCESS if the ring can be used, or
+* ERROR if io_uring is not available.
+*
+*************************************************************************** */
+
+static int net_uring_setup ()
+{
+    struct io_uring_params p;		/* ring parameters */
+    size_t sqlen;			/* submission ring mapping length */
+    size_t cqlen;			/* completion ring mapping length */
+    char *sq;				/* submission ring mapping */
+    char *cq;				/* completion ring mapping */
+    void *sqes;				/* submission entries mapping */
+    int fd;				/* ring file descriptor */
+
+    if (net_ring.state != 0)
+	return (net_ring.state == 1) ? SUCCESS : ERROR;
+
+    net_ring.state = ERROR;
+
+    (void) memset (&p, 0, sizeof (p));
+
+    if ((fd = syscall (__NR_io_uring_setup, NET_URING_ENTRIES, &p)) == ERROR)
+	return ERROR;
+
+    sqlen = p.sq_off.array + p.sq_entries * sizeof (unsigned);
+    cqlen = p.cq_off.cqes + p.cq_entries * sizeof (struct io_uring_cqe);
+
+    /* both rings share one mapping on kernels with IORING_FEAT_SINGLE_MMAP */
+
+    if ((p.features & IORING_FEAT_SINGLE_MMAP) && cqlen > sqlen)
+	sqlen = cqlen;
+
+    sq = mmap (NULL, sqlen, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) {
+	(void) close (fd);
+	return ERROR;
+    }
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+	cq = sq;
+    else if ((cq = mmap (NULL, cqlen, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING)) == MAP_FAILED) {
+	(void) munmap (sq, sqlen);
+	(void) close (fd);
+	return ERROR;
+    }
+
+    sqes = mmap (NULL, p.sq_entries * sizeof (struct io_uring_sqe),
+		    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+		    IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+	if (cq != sq)
+	    (void) munmap (cq, cqlen);
+	(void) munmap (sq, sqlen);
+	(void) close (fd);
+	return ERROR;
+    }
+
+    net_ring.fd       = fd;
+    net_ring.sq_tail  = (unsigned *) (sq + p.sq_off.tail);
+    net_ring.sq_mask  = (unsigned *) (sq + p.sq_off.ring_mask);
+    net_ring.sq_array = (unsigned *) (sq + p.sq_off.array);
+    net_ring.sqes     = (struct io_uring_sqe *) sqes;
+    net_ring.cq_head  = (unsigned *) (cq + p.cq_off.head);
+    net_ring.cq_tail  = (unsigned *) (cq + p.cq_off.tail);
+    net_ring.cq_mask  = (unsigned *) (cq + p.cq_off.ring_mask);
+    net_ring.cqes     = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+    net_ring.state    = 1;
+
+    return SUCCESS;
+}
@@ -109,15 +109,16 @@ int process_rsp (int sockfd)
 int process_tlm (int sockfd)
 {
     int  len;
-    char buff[1024];
+    char *msg;
     bool more = true;
     struct timeval tm, lat;
     static int pkt = 0;
 
     while (more) {
-	(void) memset (buff, 0, sizeof buff);
 
-	len = net_recv (sockfd, buff, sizeof buff, BLOCKING);
+	/* decode the message in place in the receive buffer */
+
+	len = net_recv_view (sockfd, &msg, BLOCKING);
 
 	gettimeofday (&tm, NULL);
 
@@ -135,13 +136,13 @@ int process_tlm (int sockfd)
 	    	NET_TIMESTAMP ("%3d tstcli: Received %d bytes.\n", (pkt++%50)+1, len);
 	    }
 	    else {
-		timersub (&tm, &(((DataHdr *)buff)->time), &lat);
+		timersub (&tm, &(((DataHdr *)msg)->time), &lat);
 		(void)fprintf (stderr, " %02ld.%06ld %3d\n",
 					lat.tv_sec, lat.tv_usec, (pkt++%50)+1);
 	    }
+	    (void) net_release (sockfd);
     	}
     }
 
     return 0;
 }
-
@@ -0,0 +1 @@
+../net/net_evloop.c
\ No newline at end of file
@@ -0,0 +1 @@
+../net/net_udp.c
\ No newline at end of file
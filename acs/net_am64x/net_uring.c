@@ -0,0 +1 @@
+../net/net_uring.c
\ No newline at end of file
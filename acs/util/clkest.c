@@ -0,0 +1,133 @@
+/**
+ *****************************************************************************
+ *
+ * @file clkest.c
+ *   Remote clock offset and drift, from the min-RTT probe of each burst
+ *   of ping-pong exchanges.  See clkest.h.
+ *
+ * @par Project
+ *	TMT Primary Mirror Control System (M1CS) \n
+ *	Jet Propulsion Laboratory, Pasadena, CA
+ *
+ * Copyright (c) 2022-2025, California Institute of Technology
+ *
+ *****************************************************************************
+ */
+
+#include <string.h>
+
+#include "clkest.h"
+
+
+/* a time in ns since the epoch */
+static long clkest_ns (const struct timespec *t)
+{
+   return t->tv_sec * 1000000000L + t->tv_nsec;
+}
+
+/**
+ * @fn void clkest_reset (clkest *c)
+ * @par   forget every probe; a zeroed estimator is reset too
+ * @param[in/out]  *c : estimator
+ *
+ */
+void clkest_reset (clkest *c)
+{
+   (void) memset (c, 0, sizeof *c);
+}
+
+/**
+ * @fn void clkest_probe (clkest *c, const struct timespec *t1, const struct timespec *t2, const struct timespec *t3, const struct timespec *t4)
+ * @par   add one exchange to the current burst
+ * @param[in/out]  *c : estimator
+ * @param[in]  *t1    : probe sent, local clock
+ * @param[in]  *t2    : probe received, remote clock
+ * @param[in]  *t3    : reply sent, remote clock
+ * @param[in]  *t4    : reply received, local clock
+ *
+ */
+void clkest_probe (clkest *c, const struct timespec *t1,
+		   const struct timespec *t2, const struct timespec *t3,
+		   const struct timespec *t4)
+{
+   clkest_sample s;
+
+   s.t      = clkest_ns (t4);
+   s.rtt    = (clkest_ns (t4) - clkest_ns (t1)) - (clkest_ns (t3) - clkest_ns (t2));
+   s.offset = ((clkest_ns (t2) - clkest_ns (t1)) + (clkest_ns (t3) - clkest_ns (t4))) / 2;
+
+   if (c->nburst == 0 || s.rtt < c->best.rtt)
+      c->best = s;
+   c->nburst++;
+   c->nprobes++;
+}
+
+/**
+ * @fn int clkest_burst_end (clkest *c)
+ * @par   end the current burst: keep its shortest round trip, and fit the
+ *        drift to the last bursts' by least squares
+ * @param[in/out]  *c : estimator
+ * @return: the bursts kept, or 0 if the burst had no probe
+ *
+ */
+int clkest_burst_end (clkest *c)
+{
+   double x, y, sx = 0, sy = 0, sxx = 0, sxy = 0;
+   int i, n;
+
+   if (c->nburst == 0)
+      return c->nhist;
+   c->nburst = 0;
+
+   if (c->nhist == CLKEST_HIST)
+      (void) memmove (&c->hist[0], &c->hist[1], (CLKEST_HIST - 1) * sizeof c->hist[0]);
+   else
+      c->nhist++;
+   c->hist[c->nhist - 1] = c->best;
+
+   /* offsets against time, from the latest burst's, in s and ns */
+
+   n = c->nhist;
+   for (i = 0; i < n; i++) {
+      x = (c->hist[i].t - c->best.t) / 1e9;
+      y = (double) (c->hist[i].offset - c->best.offset);
+      sx += x;
+      sy += y;
+      sxx += x * x;
+      sxy += x * y;
+   }
+   c->drift = (n > 1 && n * sxx - sx * sx > 0) ? (n * sxy - sx * sy) / (n * sxx - sx * sx) : 0;
+
+   return n;
+}
+
+/**
+ * @fn long clkest_offset (const clkest *c, const struct timespec *t)
+ * @par   offset of the remote clock at local time t: that of the last
+ *        burst, carried forward by the drift; adding it to a latency
+ *        measured from a remote time tag to a local time corrects it
+ * @param[in]  *c : estimator
+ * @param[in]  *t : local time
+ * @return: remote minus local clock, in ns; 0 before the first burst
+ *
+ */
+long clkest_offset (const clkest *c, const struct timespec *t)
+{
+   if (c->nhist == 0)
+      return 0;
+   return c->hist[c->nhist - 1].offset +
+	  (long) (c->drift * (clkest_ns (t) - c->hist[c->nhist - 1].t) / 1e9);
+}
+
+/**
+ * @fn long clkest_uncert (const clkest *c)
+ * @par   uncertainty of the offset: half the last burst's shortest round
+ *        trip, as the probe and its reply may have taken any share of it
+ * @param[in]  *c : estimator
+ * @return: the uncertainty in ns, or -1 before the first burst
+ *
+ */
+long clkest_uncert (const clkest *c)
+{
+   return (c->nhist == 0) ? -1 : c->hist[c->nhist - 1].rtt / 2;
+}
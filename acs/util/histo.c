@@ -0,0 +1,209 @@
+/**
+ *****************************************************************************
+ *
+ * @file histo.c
+ *   Log-bucketed histograms - record latencies or counts, then report
+ *   their percentiles.  See histo.h for the bucket layout.
+ *
+ * @par Project
+ *	TMT Primary Mirror Control System (M1CS) \n
+ *	Jet Propulsion Laboratory, Pasadena, CA
+ *
+ * Copyright (c) 2022-2025, California Institute of Technology
+ *
+ *****************************************************************************
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "histo.h"
+
+
+/*
+ * bucket of value v >= HISTO_SUB, whose highest bit is bit e: the bucket's
+ * power of two, and the HISTO_SUB_BITS bits below the highest one
+ */
+static int histo_index (long v)
+{
+   int e;
+
+   if (v < HISTO_SUB)
+      return (v < 0) ? 0 : (int) v;
+
+   e = 63 - __builtin_clzl ((unsigned long) v);
+   return (e - HISTO_SUB_BITS + 1) * HISTO_SUB +
+	  (int) ((v >> (e - HISTO_SUB_BITS)) & (HISTO_SUB - 1));
+}
+
+/* highest value of bucket i */
+static long histo_top (int i)
+{
+   int e;
+
+   if (i < HISTO_SUB)
+      return i;
+
+   e = i / HISTO_SUB + HISTO_SUB_BITS - 1;
+   return (long) (((unsigned long) (HISTO_SUB + i % HISTO_SUB + 1)
+		   << (e - HISTO_SUB_BITS)) - 1);
+}
+
+/**
+ * @fn void histo_reset (histo *h)
+ * @par   empty a histogram; a zeroed histogram is empty too
+ * @param[in/out]  *h : histogram
+ *
+ */
+void histo_reset (histo *h)
+{
+   (void) memset (h, 0, sizeof *h);
+}
+
+/**
+ * @fn void histo_add (histo *h, long value)
+ * @par   record one value; a negative value is counted in the 0 bucket,
+ *        but kept as the minimum
+ * @param[in/out]  *h : histogram
+ * @param[in]  value  : value, in the caller's units (ns, counts...)
+ *
+ */
+void histo_add (histo *h, long value)
+{
+   if (h->count == 0 || value < h->min)
+      h->min = value;
+   if (h->count == 0 || value > h->max)
+      h->max = value;
+
+   h->count++;
+   h->sum += value;
+   h->bucket[histo_index (value)]++;
+}
+
+/**
+ * @fn void histo_merge (histo *to, const histo *from)
+ * @par   add the values recorded in one histogram to another, e.g. the
+ *        histogram of the last report period to that of the whole run
+ * @param[in/out]  *to : histogram added to
+ * @param[in]  *from   : histogram added
+ *
+ */
+void histo_merge (histo *to, const histo *from)
+{
+   int i;
+
+   if (from->count == 0)
+      return;
+
+   if (to->count == 0 || from->min < to->min)
+      to->min = from->min;
+   if (to->count == 0 || from->max > to->max)
+      to->max = from->max;
+
+   to->count += from->count;
+   to->sum += from->sum;
+   for (i = 0; i < HISTO_NBUCKETS; i++)
+      to->bucket[i] += from->bucket[i];
+}
+
+/**
+ * @fn long histo_pct (const histo *h, double pct)
+ * @par   percentile of the values recorded
+ * @param[in]  *h  : histogram
+ * @param[in]  pct : percentile, 0 to 100
+ * @return: the highest value of the bucket holding the percentile, within
+ *          the minimum and maximum recorded; 0 if the histogram is empty
+ *
+ */
+long histo_pct (const histo *h, double pct)
+{
+   unsigned long rank, n = 0;
+   long v;
+   int i;
+
+   if (h->count == 0)
+      return 0;
+
+   /* the value with rank ceil(pct% of count), counting from 1 */
+
+   rank = (unsigned long) (pct / 100.0 * h->count + 0.999999);
+   if (rank < 1)
+      rank = 1;
+
+   for (i = 0; i < HISTO_NBUCKETS - 1; i++)
+      if ((n += h->bucket[i]) >= rank)
+	 break;
+
+   v = histo_top (i);
+   if (v > h->max)
+      v = h->max;
+   if (v < h->min)
+      v = h->min;
+   return v;
+}
+
+/**
+ * @fn long histo_mean (const histo *h)
+ * @par   mean of the values recorded
+ * @param[in]  *h : histogram
+ * @return: the mean, or 0 if the histogram is empty
+ *
+ */
+long histo_mean (const histo *h)
+{
+   return (h->count == 0) ? 0 : (long) (h->sum / h->count);
+}
+
+/**
+ * @fn void histo_print (FILE *fp, const char *name, const histo *h, long unit, const char *units)
+ * @par   print one line summarizing a histogram:
+ *        "name: n min/avg/p50/p90/p99/p99.9/max a/b/c/d/e/f/g units"
+ * @param[in]  *fp    : stream printed to
+ * @param[in]  *name  : what the values are
+ * @param[in]  *h     : histogram
+ * @param[in]  unit   : values per unit printed, e.g. 1000 for ns printed in us
+ * @param[in]  *units : name of the unit printed
+ *
+ */
+void histo_print (FILE *fp, const char *name, const histo *h, long unit,
+		  const char *units)
+{
+   (void) fprintf (fp, "%s: %lu min/avg/p50/p90/p99/p99.9/max "
+		       "%ld/%ld/%ld/%ld/%ld/%ld/%ld %s\n", name, h->count,
+		   h->min / unit, histo_mean (h) / unit,
+		   histo_pct (h, 50) / unit, histo_pct (h, 90) / unit,
+		   histo_pct (h, 99) / unit, histo_pct (h, 99.9) / unit,
+		   h->max / unit, units);
+}
+
+/**
+ * @fn void histo_dump (FILE *fp, const char *name, const histo *h, long unit, const char *units)
+ * @par   print the whole distribution, for plotting: a "# name" header,
+ *        then one line "low high count cumulative%" per bucket holding
+ *        values, low and high being the range of the bucket
+ * @param[in]  *fp    : stream printed to
+ * @param[in]  *name  : what the values are
+ * @param[in]  *h     : histogram
+ * @param[in]  unit   : values per unit printed, e.g. 1000 for ns printed in us
+ * @param[in]  *units : name of the unit printed
+ *
+ */
+void histo_dump (FILE *fp, const char *name, const histo *h, long unit,
+		 const char *units)
+{
+   unsigned long n = 0;
+   int i;
+
+   (void) fprintf (fp, "# %s: %lu values, %s\n# low high count cum%%\n",
+		   name, h->count, units);
+
+   for (i = 0; i < HISTO_NBUCKETS; i++) {
+      if (h->bucket[i] == 0)
+	 continue;
+      n += h->bucket[i];
+      (void) fprintf (fp, "%.3f %.3f %lu %.4f\n",
+		      (double) (i > 0 ? histo_top (i - 1) + 1 : 0) / unit,
+		      (double) histo_top (i) / unit, h->bucket[i],
+		      100.0 * n / h->count);
+   }
+}
@@ -0,0 +1,163 @@
+/**
+ *****************************************************************************
+ *
+ * @file rtprof.c
+ *   Real-time execution profile - SCHED_FIFO priority, CPU affinity,
+ *   locked memory and a prefaulted stack, applied as far as the process
+ *   is allowed to.
+ *
+ * @par Project
+ *	TMT Primary Mirror Control System (M1CS) \n
+ *	Jet Propulsion Laboratory, Pasadena, CA
+ *
+ * Copyright (c) 2022-2025, California Institute of Technology
+ *
+ *****************************************************************************
+ */
+
+#define _GNU_SOURCE		// for cpu_set_t, sched_setaffinity()
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "rtprof.h"
+
+
+/*
+ * touch RT_STACK_PREFAULT bytes below the caller's frame, so that the
+ * stack does not grow, and fault, while the program is measuring
+ */
+static void rt_prefault_stack (void)
+{
+   volatile char stack[RT_STACK_PREFAULT];
+   long page = sysconf (_SC_PAGESIZE);
+   size_t i;
+
+   for (i = 0; i < sizeof stack; i += page)
+      stack[i] = 0;
+}
+
+/**
+ * @fn void rt_prefault (void *buf, size_t len)
+ * @par   write every page of a buffer, without changing it, so that it is
+ *        mapped before use; needed when rt_profile() could not lock memory,
+ *        or for memory allocated before it was called
+ * @param[in/out]  *buf : buffer
+ * @param[in]  len      : its length in bytes
+ *
+ */
+void rt_prefault (void *buf, size_t len)
+{
+   volatile char *p = (volatile char *) buf;
+   long page = sysconf (_SC_PAGESIZE);
+   size_t i;
+
+   /* reading a page would only map the shared zero page */
+
+   for (i = 0; i < len; i += page)
+      p[i] = p[i];
+   if (len > 0)
+      p[len - 1] = p[len - 1];
+}
+
+/**
+ * @fn int rt_profile (const char *spec, char *desc, int len)
+ * @par   apply the real-time profile "prio[@cpus]" to the calling thread,
+ *        and to the threads it creates afterwards: SCHED_FIFO priority
+ *        prio, affinity to the cpus listed ("2", "2,3" or "2-5"), all
+ *        memory locked (mlockall), and the stack prefaulted.  A step the
+ *        process is not allowed (no CAP_SYS_NICE, RLIMIT_MEMLOCK...) is
+ *        skipped with a warning, and the rest still applied.
+ * @param[in]  *spec : profile, or NULL to only describe the default one
+ * @param[out] *desc : the profile applied, to be recorded with the results
+ * @param[in]  len   : size of desc, at least RT_DESC_LEN
+ * @return  Number of steps skipped
+ * @retval  0 : profile fully applied
+ * @retval  -1 (ERROR) : spec is not "prio[@cpus]"; nothing applied
+ *
+ */
+int rt_profile (const char *spec, char *desc, int len)
+{
+   struct sched_param param;
+   cpu_set_t set;
+   const char *cpus = NULL;
+   char *p, *q;
+   int prio, lo, hi, n = 0, skipped = 0;
+
+   if (spec == NULL) {
+      (void) snprintf (desc, len, "default (SCHED_OTHER, any cpu, memory not locked)");
+      return 0;
+   }
+
+   /* parse it all before applying any of it */
+
+   prio = (int) strtol (spec, &p, 10);
+   if (p == spec || prio < sched_get_priority_min (SCHED_FIFO) ||
+		    prio > sched_get_priority_max (SCHED_FIFO))
+      return -1;
+
+   CPU_ZERO (&set);
+   if (*p == '@') {
+      cpus = ++p;
+      while (*p != '\0') {
+	 q = p;
+	 lo = hi = (int) strtol (q, &p, 10);
+	 if (*p == '-')
+	    hi = (int) strtol (q = p + 1, &p, 10);
+	 if (p == q || lo < 0 || hi < lo || hi >= CPU_SETSIZE || (*p != ',' && *p != '\0'))
+	    return -1;
+	 for (; lo <= hi; lo++)
+	    CPU_SET (lo, &set);
+	 if (*p == ',')
+	    p++;
+      }
+      if (CPU_COUNT (&set) == 0)
+	 return -1;
+   }
+   else if (*p != '\0')
+      return -1;
+
+   /* the priority */
+
+   param.sched_priority = prio;
+   if (sched_setscheduler (0, SCHED_FIFO, &param) == 0)
+      n += snprintf (desc + n, len - n, "SCHED_FIFO %d", prio);
+   else {
+      (void) fprintf (stderr, "rt_profile: SCHED_FIFO %d: %s\n", prio, strerror (errno));
+      n += snprintf (desc + n, len - n, "SCHED_OTHER (FIFO %d denied)", prio);
+      skipped++;
+   }
+
+   /* the cpus */
+
+   if (cpus == NULL)
+      n += snprintf (desc + n, len - n, ", any cpu");
+   else if (sched_setaffinity (0, sizeof set, &set) == 0)
+      n += snprintf (desc + n, len - n, ", cpus %.32s", cpus);
+   else {
+      (void) fprintf (stderr, "rt_profile: cpus %s: %s\n", cpus, strerror (errno));
+      n += snprintf (desc + n, len - n, ", any cpu (%.32s denied)", cpus);
+      skipped++;
+   }
+
+   /* the memory: what is mapped now, and what will be */
+
+   if (mlockall (MCL_CURRENT | MCL_FUTURE) == 0)
+      n += snprintf (desc + n, len - n, ", memory locked");
+   else {
+      (void) fprintf (stderr, "rt_profile: mlockall: %s\n", strerror (errno));
+      n += snprintf (desc + n, len - n, ", memory not locked");
+      skipped++;
+   }
+
+   rt_prefault_stack ();
+   (void) snprintf (desc + n, len - n, ", %d KB stack prefaulted",
+		    RT_STACK_PREFAULT / 1024);
+
+   return skipped;
+}
@@ -0,0 +1,180 @@
+/**
+ *****************************************************************************
+ *
+ * @file segsim.c
+ *   Synthetic segment real-time data - sensor heights and gaps from their
+ *   waveform parameters, and actuators under a PI servo, for the test
+ *   server to send instead of zeroes.  See segsim.h.
+ *
+ * @par Project
+ *	TMT Primary Mirror Control System (M1CS) \n
+ *	Jet Propulsion Laboratory, Pasadena, CA
+ *
+ * Copyright (c) 2022-2025, California Institute of Technology
+ *
+ *****************************************************************************
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "segsim.h"
+
+#define TAB_BITS	12			// 4096-entry sine table
+#define TAB_SHIFT	(32 - TAB_BITS)
+#define TURN		4294967296.0		// 2^32, a full turn of phase
+
+#define DT		(1.0f / SEGSIM_RATE)	// servo period, s
+#define KP		60.0f			// servo gains: ~10 Hz bandwidth
+#define KI		300.0f
+#define KO		0.05f			// offload of the integrator
+#define NOISE		0.002f			// encoder noise, um
+#define ACT_MODE	2			// closed loop
+#define ACT_FREQ	0.1			// target sine, Hz
+#define ACT_AMPL	0.5f			// and amplitude, um
+
+static float32  sintab[1 << TAB_BITS];
+static uint32_t act_inc;
+
+
+/* deterministic per-segment parameters: a value from lo to hi */
+static float32 segsim_rand (uint32_t *seed, float32 lo, float32 hi)
+{
+   *seed = *seed * 1664525u + 1013904223u;
+   return lo + (hi - lo) * (float32) (*seed >> 8) / (float32) (1 << 24);
+}
+
+/* phase step per frame of a sine of freq Hz */
+static uint32_t segsim_inc (float32 freq)
+{
+   return (uint32_t) (freq / SEGSIM_RATE * TURN);
+}
+
+/**
+ * @fn void segsim_init (segsim *sim, int segno)
+ * @par   set up the model of segment segno: its identity, its sensors'
+ *        waveforms, and its actuators at rest on their targets
+ * @param[out] *sim : segment model
+ * @param[in]  segno : segment number, 1..492; the same number gives the
+ *                     same data
+ *
+ */
+void segsim_init (segsim *sim, int segno)
+{
+   SensWvfmParams *w;
+   int i, j;
+
+   if (act_inc == 0) {
+      for (i = 0; i < (1 << TAB_BITS); i++)
+	 sintab[i] = (float32) sin (2.0 * M_PI * i / (1 << TAB_BITS));
+      act_inc = segsim_inc (ACT_FREQ);
+   }
+
+   (void) memset (sim, 0, sizeof *sim);
+   sim->segno    = segno;
+   sim->segId    = 0x2d00000000000000ULL | (ElecId) segno;
+   sim->segLocId = 0x2e00000000000000ULL | (ElecId) segno;
+   sim->seed     = 2654435761u * (uint32_t) segno;
+   sim->gap0     = 2000000 + 100 * segno;
+
+   /* height: a slow swing and a vibration; gap: a slower drift and hum */
+
+   for (j = 0; j < USEB_PER_SEG; j++) {
+      w = &sim->wvfm[j][0];
+      w->ampl1  = segsim_rand (&sim->seed, 800, 1200);
+      w->freq1  = segsim_rand (&sim->seed, 0.5, 2);
+      w->phase1 = segsim_rand (&sim->seed, 0, 2 * M_PI);
+      w->ampl2  = segsim_rand (&sim->seed, 50, 150);
+      w->freq2  = segsim_rand (&sim->seed, 20, 40);
+      w->phase2 = segsim_rand (&sim->seed, 0, 2 * M_PI);
+
+      w = &sim->wvfm[j][1];
+      w->ampl1  = segsim_rand (&sim->seed, 200, 400);
+      w->freq1  = segsim_rand (&sim->seed, 0.1, 0.3);
+      w->phase1 = segsim_rand (&sim->seed, 0, 2 * M_PI);
+      w->ampl2  = segsim_rand (&sim->seed, 10, 30);
+      w->freq2  = segsim_rand (&sim->seed, 5, 10);
+      w->phase2 = segsim_rand (&sim->seed, 0, 2 * M_PI);
+
+      for (i = 0; i < 2; i++) {
+	 w = &sim->wvfm[j][i];
+	 sim->ph0[j][2*i]   = (uint32_t) (uint64_t) (w->phase1 / (2 * M_PI) * TURN);
+	 sim->inc[j][2*i]   = segsim_inc (w->freq1);
+	 sim->ph0[j][2*i+1] = (uint32_t) (uint64_t) (w->phase2 / (2 * M_PI) * TURN);
+	 sim->inc[j][2*i+1] = segsim_inc (w->freq2);
+      }
+   }
+
+   for (j = 0; j < ACT_PER_SEG; j++) {
+      sim->act[j].base    = segsim_rand (&sim->seed, -20, 20);
+      sim->act[j].ph0     = sim->seed;
+      sim->act[j].encoder = sim->act[j].base;
+   }
+}
+
+/**
+ * @fn void segsim_fill (segsim *sim, SegRtData *data, int nsmpl, unsigned long frame)
+ * @par   generate nsmpl samples of the segment, from frame number frame of
+ *        the run on: the sensors' values depend on the frame number only,
+ *        so every segment is sampled at the same instants, while the
+ *        actuators' servo steps once per sample
+ * @param[in/out]  *sim : segment model
+ * @param[out] *data    : the samples, e.g. the SMPL_PER_MSG of a SegRtDataMsg
+ * @param[in]  nsmpl    : number of samples
+ * @param[in]  frame    : frame number of the first sample
+ *
+ */
+void segsim_fill (segsim *sim, SegRtData *data, int nsmpl, unsigned long frame)
+{
+   SensRtData *s;
+   ActRtData  *a;
+   segsim_act *m;
+   uint32_t   f;
+   float32    meas, err, coil;
+   int	      n, j;
+
+   for (n = 0; n < nsmpl; n++, frame++) {
+
+      /* the frame count, and chopping between two waveforms each 1/2 s */
+
+      f = (uint32_t) frame;
+      for (j = 0; j < USEB_PER_SEG; j++) {
+	 s = &data[n].sensor[j];
+	 s->sensRtDataHdr = 0;
+	 s->bitFields.frameCount      = frame % SEGSIM_FRAMES;
+	 s->bitFields.chopWaveform    = (frame / (SEGSIM_FRAMES / 2)) & 1;
+	 s->bitFields.zenithChopState = s->bitFields.chopWaveform;
+	 s->bitFields.nadirChopState  = !s->bitFields.chopWaveform;
+
+	 s->height = (int32_t)
+	    (sim->wvfm[j][0].ampl1 * sintab[(sim->ph0[j][0] + f * sim->inc[j][0]) >> TAB_SHIFT] +
+	     sim->wvfm[j][0].ampl2 * sintab[(sim->ph0[j][1] + f * sim->inc[j][1]) >> TAB_SHIFT]);
+	 s->gap = sim->gap0 + (int32_t)
+	    (sim->wvfm[j][1].ampl1 * sintab[(sim->ph0[j][2] + f * sim->inc[j][2]) >> TAB_SHIFT] +
+	     sim->wvfm[j][1].ampl2 * sintab[(sim->ph0[j][3] + f * sim->inc[j][3]) >> TAB_SHIFT]);
+      }
+
+      /* a PI servo on each actuator, its coil driving its velocity */
+
+      for (j = 0; j < ACT_PER_SEG; j++) {
+	 m = &sim->act[j];
+	 a = &data[n].actuator[j];
+
+	 m->target = m->base + ACT_AMPL * sintab[(m->ph0 + f * act_inc) >> TAB_SHIFT];
+	 meas = m->encoder + segsim_rand (&sim->seed, -NOISE, NOISE);
+	 err  = m->target - meas;
+	 m->integ += err * DT;
+	 coil = KP * err + KI * m->integ;
+	 m->encoder += coil * DT;
+
+	 a->loopCount    = ++m->loopCount;
+	 a->actuatorMode = ACT_MODE;
+	 a->encoder      = meas;
+	 a->voiceCoil    = coil;
+	 a->error        = err;
+	 a->offloadVel   = -KO * m->integ;
+	 a->snubberVel   = 0;
+	 a->targetOffset = m->target - m->base;
+      }
+   }
+}
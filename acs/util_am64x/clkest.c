@@ -0,0 +1 @@
+../util/clkest.c
\ No newline at end of file
@@ -0,0 +1 @@
+../util/histo.c
\ No newline at end of file
@@ -0,0 +1 @@
+../util/rtprof.c
\ No newline at end of file
@@ -32,6 +32,7 @@
 #define RSP_TYPE             (2 << 16)
 #define LOG_TYPE             (3 << 16)
 #define DATA_TYPE            (4 << 16)
+#define CLK_TYPE             (5 << 16)
 
 #define OS_PACK __attribute__((packed, aligned(2))) // Force alignment for data structures
 
@@ -88,6 +89,15 @@ typedef struct DataHdr {
     TimeTag time;
 } OS_PACK DataHdr;
 
+/// Clock probe, echoed by the server with its receive and send times so
+/// that the client can estimate the offset of the server's clock.
+typedef struct ClkMsg {
+    MsgHdr hdr;
+    struct timespec t1; //!< probe sent, client's clock
+    struct timespec t2; //!< probe received, server's clock
+    struct timespec t3; //!< reply sent, server's clock
+} OS_PACK ClkMsg;
+
 /// Log severity levels
 typedef enum LogLevel {
     LOG_FATAL,    //!< For errors that cause the system to halt
@@ -0,0 +1,53 @@
+/**
+ *****************************************************************************
+ *
+ * @file clkest.h
+ *	Estimation Of A Remote Clock's Offset And Drift.
+ *
+ * @par Project
+ *	TMT Primary Mirror Control System (M1CS) \n
+ *	Jet Propulsion Laboratory, Pasadena, CA
+ *
+ * NTP-style: a probe leaves at t1 on the local clock, reaches the remote
+ * host at t2 and leaves it at t3 on the remote clock, and is back at t4.
+ * The remote clock is then ahead by ((t2 - t1) + (t3 - t4)) / 2, to within
+ * half the round trip (t4 - t1) - (t3 - t2).  Of each burst of probes only
+ * the one with the shortest round trip is kept, the others having waited
+ * in a queue on the way; the drift is fitted to the offsets of the last
+ * CLKEST_HIST bursts.
+ *
+ * Copyright (c) 2022-2025, California Institute of Technology
+ *
+ ****************************************************************************/
+
+#ifndef CLKEST_H
+#define CLKEST_H
+
+#include <time.h>
+
+#define CLKEST_HIST	8			// bursts the drift is fitted to
+
+typedef struct clkest_sample {
+   long t;					// local time, ns since the epoch
+   long offset;					// remote minus local clock, ns
+   long rtt;					// round trip, ns
+} clkest_sample;
+
+typedef struct clkest {
+   unsigned long nprobes;			// probes of all bursts
+   int           nburst;			// probes of the current burst
+   clkest_sample best;				// its shortest round trip
+   clkest_sample hist[CLKEST_HIST];		// that of the last bursts
+   int           nhist;
+   double        drift;				// remote clock's drift, ns/s
+} clkest;
+
+void clkest_reset (clkest *c);
+void clkest_probe (clkest *c, const struct timespec *t1,
+		   const struct timespec *t2, const struct timespec *t3,
+		   const struct timespec *t4);
+int  clkest_burst_end (clkest *c);
+long clkest_offset (const clkest *c, const struct timespec *t);
+long clkest_uncert (const clkest *c);
+
+#endif /* CLKEST_H */
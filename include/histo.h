@@ -0,0 +1,45 @@
+/**
+ *****************************************************************************
+ *
+ * @file histo.h
+ *	Log-Bucketed Histograms Of Latencies And Counts.
+ *
+ * @par Project
+ *	TMT Primary Mirror Control System (M1CS) \n
+ *	Jet Propulsion Laboratory, Pasadena, CA
+ *
+ * Values 0..15 have a bucket each; every power of two above is split into
+ * 16 buckets, so a bucket is at most 1/16 (6.25%) of its values wide, and
+ * any long value is recorded, in a fixed 7.5 KB, with no allocation.
+ *
+ * Copyright (c) 2022-2025, California Institute of Technology
+ *
+ ****************************************************************************/
+
+#ifndef HISTO_H
+#define HISTO_H
+
+#include <stdio.h>
+
+#define HISTO_SUB_BITS	4			// 16 buckets per power of two
+#define HISTO_SUB	(1 << HISTO_SUB_BITS)
+#define HISTO_NBUCKETS	((64 - HISTO_SUB_BITS) * HISTO_SUB)
+
+typedef struct histo {
+   unsigned long count;				// values recorded
+   long          min, max;
+   double        sum;
+   unsigned long bucket[HISTO_NBUCKETS];
+} histo;
+
+void histo_reset (histo *h);
+void histo_add (histo *h, long value);
+void histo_merge (histo *to, const histo *from);
+long histo_pct (const histo *h, double pct);
+long histo_mean (const histo *h);
+void histo_print (FILE *fp, const char *name, const histo *h, long unit,
+		  const char *units);
+void histo_dump (FILE *fp, const char *name, const histo *h, long unit,
+		 const char *units);
+
+#endif /* HISTO_H */
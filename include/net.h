@@ -27,26 +27,67 @@
 #ifndef NET_H
 #define NET_H
 
+#include <time.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+
 #include "acs.h"
+#include "net_appl.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-#define NET_MAX_ENDPTS       (23) //!< max number of remote endpoints
-#define NET_MAX_FD         (1024) //!< max number of open socket desc
+#define NET_MAX_FD        (16384) //!< max number of open socket desc
 
 #define NET_MIN_MSG_LEN  (sizeof (char)) //!< minimum message length
 #define NET_MAX_MSG_LEN      (4097*1024) //!< maximum message length (> 4Mb)
 
 #define NET_MAX_UDP_LEN     (4096) //!< maximum UDP packet length
 
+#define NET_MAX_IOV           (64) //!< max number of buffers per message
+
+#define NET_RXBUF_LEN    (64*1024) //!< default receive buffer length
+#define NET_MIN_RXBUF_LEN    (256) //!< minimum receive buffer length
+#define NET_RXBUF_ALIGN       (64) //!< receive buffer area alignment
+#define NET_MSG_ALIGN          (8) //!< alignment of a message view
+
+#define NET_TS_RING          (256) //!< messages awaiting a transmit stamp
+#define NET_EV_BATCH          (64) //!< events taken per epoll_wait()
+
 #define NET_MIN_USEC_DELAY (20000) //!< minimum delay in microseconds
 #define NET_MAX_NDELAY        (10) //!< max number of delays before
                                    //!< returning NWOULDBLOCK
 
+#define NET_HDR_ID    (0x3c54543e) //!< ascii representation for "<TT>"
+#define NET_HDR_ID_V2 (0x3c54323e) //!< ascii representation for "<T2>"
+
+/// TCP internal message header (version 1)
+
+struct msg_hdr_dcl {
+    int hdr_id;                     //!< message header id
+    int msg_len;                    //!< length of user's message in bytes
+};
+
+/// TCP internal message header version 2, which starts like version 1
+
+struct msg_hdr_v2 {
+    int      hdr_id;                //!< NET_HDR_ID_V2
+    int      msg_len;               //!< length of user's message in bytes
+    unsigned seq_no;                //!< per-connection sequence number
+    unsigned ts_sec;                //!< send time (CLOCK_REALTIME), seconds
+    unsigned ts_nsec;               //!< and nanoseconds
+    unsigned spare;                 //!< zero; keeps the message aligned
+};
+
+/// length of the internal header with the given (host order) header id
+
+#define NET_HDR_LEN(id) ((int) (((id) == NET_HDR_ID_V2) ? \
+		sizeof (struct msg_hdr_v2) : sizeof (struct msg_hdr_dcl)))
+
 typedef enum {
-    UNDEF, TCP, UDP, BRDCST
+    UNDEF, TCP, UDP, BRDCST, MCAST
 } endpt_type;
 
 /// listener's endpoint entry
@@ -56,19 +97,132 @@ typedef struct endpt_entry {
     endpt_type type;        //!< endpoint protocol
     int        pname;       //!< server's name
     int        port;        //!< endpoint port number
+    char       *group;      //!< multicast group address, MCAST only
+    int        first;       //!< range "name[first..]" of count endpoints
+    int        count;       //!< on consecutive ports, or 0 for one
 } endpt_entry;
 
-/// open socket descriptor entry
+/// per-connection receive buffer
+
+typedef struct net_rxbuf {
+    char       *base;       //!< buffer area
+    int        size;        //!< buffer area length in bytes
+    int        head;        //!< offset of first unread byte
+    int        tail;        //!< offset past last byte read
+    int        held;        //!< length of message held by a view
+    int        stash;       //!< nonzero if attached only to hold the
+                            //!< rest of a partially received message
+} net_rxbuf;
+
+/// per-connection transmit buffer
+
+typedef struct net_txbuf {
+    char       *base;       //!< unsent rest of a partially sent message
+    int        head;        //!< offset of first unsent byte
+    int        tail;        //!< offset past last unsent byte
+    struct net_txbuf *next; //!< next message queued (see net_setqueue())
+} net_txbuf;
+
+/// per-connection ring of messages awaiting their transmit timestamp;
+/// entries from head to ready are stamped, from ready to tail are not
+
+typedef struct net_txring {
+    unsigned   head;        //!< oldest entry not yet returned
+    unsigned   ready;       //!< oldest entry not yet stamped
+    unsigned   tail;        //!< next entry to fill
+    unsigned   end[NET_TS_RING]; //!< stream offset past each message
+    net_txstamp ts[NET_TS_RING]; //!< and its timestamps
+} net_txring;
+
+/// descriptor registered with an event loop
+
+typedef struct net_evfd {
+    net_evfunc func;        //!< callback, NULL if not registered
+    void       *arg;        //!< argument passed to func
+    unsigned   gen;         //!< registration number, to tell a reused
+                            //!< descriptor from the one an event was for
+} net_evfd;
+
+/// event loop state (see net_evloop_create())
+
+struct net_evloop {
+    int        epfd;        //!< epoll instance
+    volatile int stop;      //!< set by net_evloop_stop()
+    unsigned   gen;         //!< last registration number given
+    int        nfd;         //!< number of entries of fdv
+    net_evfd   *fdv;        //!< registrations, indexed by descriptor
+};
+
+/// open socket descriptor entry; the transfer state of a connection is
+/// guarded by its txlock (send side) and rxlock (receive side)
 
 typedef struct sockfd_entry {
-    endpt_type type;        //!< socket type
-    io_mode    mode;        //!< socket I/O mode
+    endpt_type type;        //!< socket type, accessed with NET_TYPE()
+    io_mode    mode;        //!< descriptor I/O mode (O_NONBLOCK)
+    net_rxbuf  *rxbuf;      //!< receive buffer, NULL if unbuffered
+    net_txbuf  *txbuf;      //!< transmit buffer, NULL if nothing pending
+    int        rxskip;      //!< excess bytes of a truncated message
+                            //!< still to be discarded
+    int        zcopy;       //!< SO_ZEROCOPY state: 0 not yet tried,
+                            //!< 1 enabled, ERROR not supported
+    unsigned   zc_sent;     //!< zero-copy sends issued
+    unsigned   zc_done;     //!< zero-copy sends completed by the kernel
+    int        hdrver;      //!< header version to send (NET_HDR_AUTO...)
+    int        peer_v2;     //!< peer has sent a version 2 header
+    unsigned   tx_seq;      //!< sequence number of next message sent
+    unsigned   rx_seq;      //!< sequence number expected next
+    net_msginfo rxinfo;     //!< last message received and counters
+    int        tstamp;      //!< kernel timestamps enabled (NET_TS_RX...)
+    struct timespec rx_kts; //!< kernel time of the last data received
+    struct timespec tx_time; //!< time the message being sent was given
+    unsigned   tx_off;      //!< stream offset past the last message sent,
+                            //!< counted from when NET_TS_TX was enabled
+    net_txring *txring;     //!< messages awaiting a transmit timestamp
+    net_txbuf  *txq;        //!< whole messages queued behind txbuf, oldest
+                            //!< first, framed only once they reach txbuf
+    net_txbuf  *txq_last;   //!< newest message queued
+    net_txqinfo txqinfo;    //!< queue depth, policy and counters
+    pthread_mutex_t txlock; //!< held for a whole framed send
+    pthread_mutex_t rxlock; //!< held for a whole message receive
 } sockfd_entry;
- 
-extern endpt_entry net_endpt[];  //!< list of endpoint entries
+
+/// socket type of an entry, read and published atomically so that other
+/// threads see an entry only once it is fully set up
+
+#define NET_TYPE(fd)  __atomic_load_n (&net_sockfd[fd].type, __ATOMIC_ACQUIRE)
+#define NET_SET_TYPE(fd, t) \
+		__atomic_store_n (&net_sockfd[fd].type, (t), __ATOMIC_RELEASE)
+
+/// deadline of a transfer in the given I/O mode: a BLOCKING transfer has
+/// no time limit, a NON_BLOCKING one never waits
+
+#define NET_MODE_DEADLINE(mode) \
+		(((mode) == BLOCKING) ? &net_forever : (struct timespec *) NULL)
+
+/// send()/recv() flags of a transfer bounded by deadline: only a transfer
+/// without time limit blocks in the kernel, whatever the descriptor mode
+
+#define NET_BLOCKS(deadline)  ((deadline) != NULL && (deadline)->tv_sec < 0)
+#define NET_IOFLAGS(deadline) (NET_BLOCKS (deadline) ? 0 : MSG_DONTWAIT)
+
+extern sockfd_entry net_sockfd[]; //!< open socket descriptor entries
+extern struct timespec net_forever; //!< deadline of a BLOCKING transfer
+extern endpt_entry net_endpt[];  //!< list of built-in endpoint entries
 extern int           net_port[]; //!< list of port numbers bound to
                                  //!< by a client
 
+int  net_getservport (char *endpt, endpt_type type);
+int  net_getendpt (char *endpt, endpt_type type, endpt_entry *entry);
+int  net_getendptport (int port);
+void net_xfer_reset (int sockfd);
+void net_sockfd_open (int sockfd, endpt_type type, io_mode mode);
+int  net_txsave (int sockfd, struct iovec *iov, int iovcnt);
+int  net_txflush (int sockfd, struct timespec *deadline);
+int  net_hdr_make (int sockfd, int length, struct msg_hdr_v2 *hdr);
+void net_txdone (int sockfd, int nbytes);
+int  net_wait (int sockfd, int events, struct timespec *deadline,
+               int *ndelayp);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
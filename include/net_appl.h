@@ -28,6 +28,9 @@
 #define NET_APPL_H
 
 #include <unistd.h>
+#include <time.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
 
 #include "acs.h"
 
@@ -91,6 +94,14 @@ extern "C" {
 #define APP_SRV19    ("app_srv19")
 #define APP_SRV20    ("app_srv20")
 
+#define APP_UDP1      ("app_udp1")        //!< generic UDP endpoints
+#define APP_UDP2      ("app_udp2")
+
+#define APP_MCAST1    ("app_mcast1")      //!< generic multicast endpoints
+
+#define APP_SRVS      ("app_srvs")        //!< generic servers "app_srvs[0]"
+#define APP_SRVS_MAX  (492)               //!< to "app_srvs[491]"
+
 #define ANT_BRDCST   ("ant_brdcst")     //!< broadcast endpoint
 #define ANT_NETWRK   ("ei0")            //!< broadcast network
 
@@ -109,16 +120,148 @@ extern "C" {
 #define SRV19_TASK    (119)
 #define SRV20_TASK    (120)
 
+/// message descriptor for multi-message calls
+
+typedef struct net_msgvec {
+    char *buf;                      //!< message buffer
+    int  maxlen;                    //!< length in bytes of buffer area
+    int  len;                       //!< message length in bytes
+} net_msgvec;
+
+/// datagram descriptor for multi-datagram UDP calls
+
+typedef struct net_udpmsg {
+    char *buf;                      //!< datagram buffer
+    int  maxlen;                    //!< length in bytes of buffer area
+    int  len;                       //!< datagram length in bytes
+    struct sockaddr_in addr;        //!< destination or source address
+} net_udpmsg;
+
+/// time limit of net_send_timed() and net_recv_timed() for no deadline
+
+#define NET_WAIT_FOREVER    (-1L)
+
+/// smallest message that net_send_zc() sends without copying
+
+#define NET_ZC_MIN_LEN      (16384)
+
+/// internal header versions for net_sethdrver()
+
+#define NET_HDR_AUTO        (0)   //!< version 1 until the peer sends 2
+#define NET_HDR_V1          (1)   //!< message id and length only
+#define NET_HDR_V2          (2)   //!< adds sequence number and send time
+
+/// header information of the last message received, and counters of the
+/// connection, returned by net_getmsginfo()
+
+typedef struct net_msginfo {
+    int      version;               //!< header version, 0 if none yet
+    unsigned seq_no;                //!< sequence number (version 2)
+    struct timespec sent;           //!< send time, CLOCK_REALTIME (v2)
+    struct timespec recvd;          //!< receive time, CLOCK_REALTIME (v2)
+    long     latency_ns;            //!< recvd - sent in nanoseconds (v2)
+    unsigned nmsgs;                 //!< version 2 messages received
+    unsigned ngaps;                 //!< sequence gaps detected
+    unsigned nlost;                 //!< messages missing in those gaps
+    unsigned nreordered;            //!< late or repeated sequence numbers
+    struct timespec rxstamp;        //!< kernel receive time (NET_TS_RX)
+} net_msginfo;
+
+/// kernel timestamps for net_settstamp()
+
+#define NET_TS_RX           (1)   //!< receive, see net_getmsginfo()
+#define NET_TS_TX           (2)   //!< transmit, see net_gettxstamps()
+#define NET_TS_HW           (4)   //!< from the network interface
+
+/// transmit timestamps of a message, returned by net_gettxstamps()
+
+typedef struct net_txstamp {
+    unsigned seq_no;                //!< sequence number of the message
+    struct timespec sent;           //!< time given to the send call
+    struct timespec kernel;         //!< time handed to the device
+} net_txstamp;
+
+/// overflow policies of an outbound queue, for net_setqueue()
+
+#define NET_Q_DROP_OLDEST   (1)   //!< discard the oldest queued message
+#define NET_Q_DROP_NEWEST   (2)   //!< refuse the message being sent
+#define NET_Q_DISCONNECT    (3)   //!< shut the connection down
+
+/// outbound queue of a connection and its counters, returned by
+/// net_getqueue()
+
+typedef struct net_txqinfo {
+    int      depth;                 //!< most messages queued, 0 if no queue
+    int      policy;                //!< overflow policy (NET_Q_DROP_OLDEST...)
+    int      queued;                //!< messages queued now
+    int      hiwat;                 //!< most messages ever queued
+    unsigned ndropped;              //!< messages discarded on overflow
+} net_txqinfo;
+
+/// event loop of net_evloop_create(), and the callback it calls with the
+/// events (NET_EV_IN...) of a registered descriptor that became ready
+
+typedef struct net_evloop net_evloop;
+typedef void (*net_evfunc) (net_evloop *ev, int fd, int events, void *arg);
+
+#define NET_EV_IN           (1)   //!< readable
+#define NET_EV_OUT          (2)   //!< writable
+#define NET_EV_ERR          (4)   //!< error or hang-up, always reported
+
 /// function prototypes
 
 int net_init (char *endpt);
 int net_accept (int listenfd, io_mode mode);
 int net_connect (char *endpt, char *hostname, int pname, io_mode mode);
 int net_send (int sockfd, char *msg, int length, io_mode mode);
+int net_sendv (int sockfd, const struct iovec *iov, int iovcnt, io_mode mode);
+int net_send_many (int sockfd, net_msgvec *msgv, int vlen, io_mode mode);
 int net_recv (int sockfd, char *buf, int maxlen, io_mode mode);
+int net_send_timed (int sockfd, char *msg, int length, long usec);
+int net_recv_timed (int sockfd, char *buf, int maxlen, long usec);
+int net_flush (int sockfd, io_mode mode);
+int net_pending (int sockfd);
+int net_send_zc (int sockfd, char *msg, int length, io_mode mode);
+int net_zc_wait (int sockfd, io_mode mode, int *ncopied);
+int net_sendfile (int sockfd, int filefd, off_t offset, int length,
+                  io_mode mode);
+int net_send_fanout (int *fdv, int nfd, char *msg, int length, io_mode mode,
+                     int *statusv);
+int net_recv_batch (int sockfd, net_msgvec *msgv, int vlen, io_mode mode);
+int net_recv_view (int sockfd, char **msgp, io_mode mode);
+int net_release (int sockfd);
+int net_setrxbuf (int sockfd, int size);
 int net_getpeername (int sockfd, int *pname, char *hostname, int namelen);
 int net_setiomode (int sockfd, io_mode mode);
+int net_batch_begin (int sockfd);
+int net_batch_flush (int sockfd);
+int net_sethdrver (int sockfd, int version);
+int net_getmsginfo (int sockfd, net_msginfo *info);
+int net_settstamp (int sockfd, int flags);
+int net_gettxstamps (int sockfd, net_txstamp *tsv, int vlen, io_mode mode);
+int net_setqueue (int sockfd, int depth, int policy);
+int net_getqueue (int sockfd, net_txqinfo *info);
 int net_close (int sockfd);
+int net_loadendpts (char *path);
+
+net_evloop *net_evloop_create (void);
+int  net_evloop_add (net_evloop *ev, int fd, int events, net_evfunc func,
+                     void *arg);
+int  net_evloop_del (net_evloop *ev, int fd);
+int  net_evloop_run (net_evloop *ev);
+void net_evloop_stop (net_evloop *ev);
+void net_evloop_destroy (net_evloop *ev);
+
+int net_udp_open (char *endpt, char *hostname, io_mode mode);
+int net_udp_addr (char *endpt, char *hostname, struct sockaddr_in *addr);
+int net_udp_sendto (int sockfd, char *msg, int length,
+                    struct sockaddr_in *to, io_mode mode);
+int net_udp_recvfrom (int sockfd, char *buf, int maxlen,
+                      struct sockaddr_in *from, io_mode mode);
+int net_udp_sendmmsg (int sockfd, net_udpmsg *msgv, int vlen, io_mode mode);
+int net_udp_recvmmsg (int sockfd, net_udpmsg *msgv, int vlen, io_mode mode);
+int net_mcast_open (char *endpt, char *ifname, io_mode mode);
+int net_mcast_join (char *endpt, char *ifname, io_mode mode);
 
 /// function return values
 
@@ -132,6 +275,7 @@ int net_close (int sockfd);
 #define NBADPROCESS (-8)
 #define NSYNCERR    (-9)
 #define NWOULDBLOCK (-10)
+#define NTIMEDOUT   (-11)
  
 /// macro for formatting net services error string
 
@@ -147,8 +291,9 @@ int net_close (int sockfd);
     ((errcode == NBADPROCESS) ? "Invalid process name" : \
     ((errcode == NSYNCERR) ? "Out of sync message" : \
     ((errcode == NWOULDBLOCK) ? "Operation would block" : \
+    ((errcode == NTIMEDOUT) ? "Operation timed out" : \
     ((errcode == ERROR) ? "System call error" : \
-    "<illegal value>")))))))))))
+    "<illegal value>"))))))))))))
 #endif
 
 #ifdef __cplusplus
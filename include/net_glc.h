@@ -47,6 +47,12 @@ extern "C" {
 #define LSCS_50HZ_DATA_SRV    (APP_SRV19)	//!< LSCS 50Hz Data Server
 #define LSCS_50HZ_DATA_TASK   (SRV19_TASK)
 
+#define LSCS_50HZ_UDP_SRV     (APP_UDP1)	//!< LSCS 50Hz Data Server (UDP)
+#define LSCS_50HZ_MCAST_GRP   (APP_MCAST1)	//!< LSCS 50Hz Data multicast group
+
+#define LSCS_SEG_DATA_SRV     (APP_SRVS)	//!< LSCS Segment Data Servers,
+						//!< one per segment: [segno-1]
+
 #define LSCS_CMD_SRV          (APP_SRV20)	//!< LSCS Command Server
 #define LSCS_CMD_TASK         (SRV20_TASK)
 
@@ -0,0 +1,31 @@
+/**
+ *****************************************************************************
+ *
+ * @file rtprof.h
+ *	Real-Time Execution Profile Of The Benchmark Programs.
+ *
+ * @par Project
+ *	TMT Primary Mirror Control System (M1CS) \n
+ *	Jet Propulsion Laboratory, Pasadena, CA
+ *
+ * "-rt prio[@cpus]" runs a program under SCHED_FIFO priority prio, pinned
+ * to cpus ("2", "2,3" or "2-5"), with its memory locked and its stack
+ * prefaulted, so that page faults and migrations do not show up in the
+ * latencies it measures.
+ *
+ * Copyright (c) 2022-2025, California Institute of Technology
+ *
+ ****************************************************************************/
+
+#ifndef RTPROF_H
+#define RTPROF_H
+
+#include <stddef.h>
+
+#define RT_STACK_PREFAULT	(256 * 1024)	// stack touched by rt_profile()
+#define RT_DESC_LEN		160		// room for the profile applied
+
+int  rt_profile (const char *spec, char *desc, int len);
+void rt_prefault (void *buf, size_t len);
+
+#endif /* RTPROF_H */
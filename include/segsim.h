@@ -0,0 +1,55 @@
+/**
+ *****************************************************************************
+ *
+ * @file segsim.h
+ *	Synthetic Segment Real-Time Data.
+ *
+ * @par Project
+ *	TMT Primary Mirror Control System (M1CS) \n
+ *	Jet Propulsion Laboratory, Pasadena, CA
+ *
+ * A segsim models one segment's LSEB: its sensors' height and gap follow
+ * the primary and secondary sines of their SensWvfmParams, sampled at
+ * SEGSIM_RATE frames per second, and its actuators track a slow target
+ * with a PI servo.  Segments are told apart by their number: each gets
+ * its own waveforms, identity and servo target.
+ *
+ * Copyright (c) 2022-2025, California Institute of Technology
+ *
+ ****************************************************************************/
+
+#ifndef SEGSIM_H
+#define SEGSIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "GlcLscsIf.h"
+
+#define SEGSIM_RATE	400		// sensor frames per second
+#define SEGSIM_FRAMES	400		// the frame count wraps at 400
+
+typedef struct segsim_act {
+    float32  base;			// mean target, um
+    uint32_t ph0;			// phase of the target's slow sine
+    float32  target;			// servo target, um
+    float32  encoder;			// position, um
+    float32  integ;			// integral of the error, um s
+    uint16_t loopCount;
+} segsim_act;
+
+typedef struct segsim {
+    int		   segno;		// 1..492
+    ElecId	   segId, segLocId;
+    SensWvfmParams wvfm[USEB_PER_SEG][2];	// height, then gap
+    uint32_t	   ph0[USEB_PER_SEG][4];	// their phases and steps per
+    uint32_t	   inc[USEB_PER_SEG][4];	// frame, in 1/2^32 of a turn
+    int32_t	   gap0;		// nominal raw gap
+    segsim_act	   act[ACT_PER_SEG];
+    uint32_t	   seed;		// encoder noise
+} segsim;
+
+void segsim_init (segsim *sim, int segno);
+void segsim_fill (segsim *sim, SegRtData *data, int nsmpl, unsigned long frame);
+
+#endif /* SEGSIM_H */